@@ -6,8 +6,37 @@
  */
 #include <stdlib.h>
 #include <stdint.h>
+#include <string.h>
 #include "Bitmap.h"
 #include "venkatlib.h"
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+// Vectors are only worth setting up when there are at least this many words left to scan
+#define BITMAP_SIMD_MIN_WORDS 16
+
+// Smaller maps are scanned directly, which only touches a few cache lines anyway
+#define BITMAP_SUMMARY_MIN_WORDS 64
+
+#define BITMAP_FULL_WORD 0xFFFFFFFF
+
+// Private helpers
+uint32_t 	_BitMap_LoadWord(BitMap* map, uint32_t WordNum);
+uint32_t 	_BitMap_RunMask(uint32_t BitNum, uint32_t EndBit);						// Bits of BitNum's word that fall below EndBit
+int32_t 	_BitMap_FindZeroRunFrom(BitMap* map, uint32_t StartBit, uint32_t RunLength, uint32_t BitLimit);	// Wraps around to StartBit once
+int32_t 	_BitMap_FindNext(BitMap* map, uint32_t StartBit, uint32_t BitLimit, uint32_t SkipWord);
+uint32_t 	_BitMap_SkipWords(BitMap* map, uint32_t WordNum, uint32_t WordLimit, uint32_t SkipWord);
+uint32_t 	_BitMap_CountTrailingZeros(uint64_t Chunk);
+
+// Summary helpers. Level 0 is the map itself, level n > 0 is summary[n - 1].
+bool 		_BitMap_InitSummary(BitMap* map);
+uint32_t* 	_BitMap_Level(BitMap* map, uint32_t Level);
+void 		_BitMap_Updated(BitMap* map, uint32_t WordNum, uint32_t Old, uint32_t New);	// Word WordNum of the map went from Old to New
+void 		_BitMap_WordFilled(BitMap* map, uint32_t Level, uint32_t WordNum);		// Every bit of the word is set now
+void 		_BitMap_WordOpened(BitMap* map, uint32_t Level, uint32_t WordNum);		// The word has a clear bit again
+void 		_BitMap_Summarize(BitMap* map, uint32_t FirstWord, uint32_t EndWord);		// Recompute the summary over words of the map, unsynchronized
+int32_t 	_BitMap_FindClear(BitMap* map, uint32_t Level, uint32_t StartBit, uint32_t BitLimit);
 
 BitMap* BitMap_Init(uint32_t SizeInWords)
 {
@@ -19,7 +48,7 @@ BitMap* BitMap_Init(uint32_t SizeInWords)
 		return 0;
 	}
 
-	NewBitMap->dataarray = (uint32_t*) malloc(sizeof(uint32_t) * SizeInWords);
+	NewBitMap->dataarray = (uint32_t*) calloc(SizeInWords, sizeof(uint32_t));		// Every bit starts out clear
 
 	// if memory allocation failed, clean up the created allocation and return
 	if (NewBitMap->dataarray == 0)
@@ -30,30 +59,446 @@ BitMap* BitMap_Init(uint32_t SizeInWords)
 
 	NewBitMap->bitsize 	= SizeInWords * WORD_SIZE;
 	NewBitMap->wordsize 	= SizeInWords;
+	NewBitMap->nexthint 	= 0;
+	NewBitMap->levels 	= 0;
+
+	memset(NewBitMap->summary, 0, sizeof(NewBitMap->summary));
+
+	if (SizeInWords >= BITMAP_SUMMARY_MIN_WORDS && _BitMap_InitSummary(NewBitMap) == FALSE)
+	{
+		BitMap_DeInit(NewBitMap);
+		return 0;
+	}
 
 	return NewBitMap;
 }
 
 void BitMap_SetBit(BitMap* map,  uint32_t BitNum)
 {
-    map->dataarray[BitNum/WORD_SIZE] |= 1 << (BitNum%WORD_SIZE);  // Set the bit at the k-th position in A[i]
+	uint32_t Bit = 1u << (BitNum%WORD_SIZE);
+	uint32_t Old = __atomic_fetch_or(&map->dataarray[BitNum/WORD_SIZE], Bit, __ATOMIC_ACQ_REL);  // Set the bit at the k-th position in A[i]
+
+	_BitMap_Updated(map, BitNum/WORD_SIZE, Old, Old | Bit);
 }
 
 void BitMap_ClearBit(BitMap* map, uint32_t BitNum)
 {
-   map->dataarray[BitNum/WORD_SIZE] &= ~(1 << (BitNum%WORD_SIZE));
+	uint32_t Bit = 1u << (BitNum%WORD_SIZE);
+	uint32_t Old = __atomic_fetch_and(&map->dataarray[BitNum/WORD_SIZE], ~Bit, __ATOMIC_ACQ_REL);
+
+	_BitMap_Updated(map, BitNum/WORD_SIZE, Old, Old & ~Bit);
 }
 
 bool BitMap_TestBit(BitMap* map, uint32_t BitNum)
 {
-   return (bool) ((map->dataarray[BitNum/WORD_SIZE] & (1 << (BitNum%WORD_SIZE) )) != 0 ) ;
+   return (bool) ((_BitMap_LoadWord(map, BitNum/WORD_SIZE) & (1u << (BitNum%WORD_SIZE) )) != 0 ) ;
 }
 
 void BitMap_DeInit(BitMap* map)
 {
+	uint32_t Level = 0;
+
+	for (Level = 0; Level < BITMAP_MAX_LEVELS; Level++) free(map->summary[Level]);
+
 	free(map->dataarray);
 	free(map);
 
 	map = 0;
 }
 
+int32_t BitMap_FindFirstZero(BitMap* map, uint32_t BitLimit)
+{
+	uint32_t Hint = __atomic_load_n(&map->nexthint, __ATOMIC_RELAXED);
+	if (Hint >= BitLimit) Hint = 0;
+
+	int32_t Found = BitMap_FindNextZero(map, Hint, BitLimit);
+
+	// Nothing free past the hint, so wrap around to what was skipped over
+	if (Found < 0 && Hint > 0) Found = BitMap_FindNextZero(map, 0, Hint);
+
+	if (Found >= 0) __atomic_store_n(&map->nexthint, (uint32_t) Found + 1, __ATOMIC_RELAXED);
+
+	return Found;
+}
+
+int32_t BitMap_FindNextZero(BitMap* map, uint32_t StartBit, uint32_t BitLimit)
+{
+	if (map->levels == 0) return _BitMap_FindNext(map, StartBit, BitLimit, 0xFFFFFFFF);	// Completely full words have nothing to offer
+
+	if (BitLimit > map->bitsize) BitLimit = map->bitsize;
+
+	return _BitMap_FindClear(map, 0, StartBit, BitLimit);
+}
+
+int32_t BitMap_FindFirstSet(BitMap* map, uint32_t BitLimit)
+{
+	return _BitMap_FindNext(map, 0, BitLimit, 0);
+}
+
+int32_t BitMap_FindNextSet(BitMap* map, uint32_t StartBit, uint32_t BitLimit)
+{
+	return _BitMap_FindNext(map, StartBit, BitLimit, 0);						// Completely empty words have nothing to offer
+}
+
+int32_t BitMap_FindZeroRun(BitMap* map, uint32_t RunLength, uint32_t BitLimit)
+{
+	uint32_t Hint = __atomic_load_n(&map->nexthint, __ATOMIC_RELAXED);
+	if (Hint >= BitLimit) Hint = 0;
+
+	int32_t Found = _BitMap_FindZeroRunFrom(map, Hint, RunLength, BitLimit);
+
+	if (Found >= 0) __atomic_store_n(&map->nexthint, (uint32_t) Found + RunLength, __ATOMIC_RELAXED);
+
+	return Found;
+}
+
+int32_t BitMap_FindZeroRunNear(BitMap* map, uint32_t GoalBit, uint32_t RunLength, uint32_t BitLimit)
+{
+	return _BitMap_FindZeroRunFrom(map, (GoalBit < BitLimit) ? GoalBit : 0, RunLength, BitLimit);
+}
+
+uint32_t BitMap_CountZeroRun(BitMap* map, uint32_t StartBit, uint32_t MaxLength, uint32_t BitLimit)
+{
+	if (BitLimit > map->bitsize) BitLimit = map->bitsize;
+	if (StartBit >= BitLimit) return 0;
+
+	uint32_t RunLimit = (BitLimit - StartBit > MaxLength) ? StartBit + MaxLength : BitLimit;
+	int32_t  RunEnd = BitMap_FindNextSet(map, StartBit, RunLimit);
+
+	return ((RunEnd < 0) ? RunLimit : (uint32_t) RunEnd) - StartBit;
+}
+
+void BitMap_SetRun(BitMap* map, uint32_t StartBit, uint32_t RunLength)
+{
+	uint32_t BitNum = StartBit;
+	uint32_t EndBit = StartBit + RunLength;
+
+	// A word at a time, masking off the bits of the first and last word that are outside the run
+	while (BitNum < EndBit)
+	{
+		uint32_t Mask = _BitMap_RunMask(BitNum, EndBit);
+		uint32_t Old  = __atomic_fetch_or(&map->dataarray[BitNum / WORD_SIZE], Mask, __ATOMIC_ACQ_REL);
+
+		_BitMap_Updated(map, BitNum / WORD_SIZE, Old, Old | Mask);
+		BitNum = ((BitNum / WORD_SIZE) + 1) * WORD_SIZE;
+	}
+}
+
+void BitMap_ClearRun(BitMap* map, uint32_t StartBit, uint32_t RunLength)
+{
+	uint32_t BitNum = StartBit;
+	uint32_t EndBit = StartBit + RunLength;
+
+	while (BitNum < EndBit)
+	{
+		uint32_t Mask = _BitMap_RunMask(BitNum, EndBit);
+		uint32_t Old  = __atomic_fetch_and(&map->dataarray[BitNum / WORD_SIZE], ~Mask, __ATOMIC_ACQ_REL);
+
+		_BitMap_Updated(map, BitNum / WORD_SIZE, Old, Old & ~Mask);
+		BitNum = ((BitNum / WORD_SIZE) + 1) * WORD_SIZE;
+	}
+}
+
+bool BitMap_ClaimBit(BitMap* map, uint32_t BitNum)
+{
+	uint32_t Bit = 1u << (BitNum % WORD_SIZE);
+	uint32_t Old = __atomic_fetch_or(&map->dataarray[BitNum / WORD_SIZE], Bit, __ATOMIC_ACQ_REL);
+
+	_BitMap_Updated(map, BitNum / WORD_SIZE, Old, Old | Bit);
+
+	return (bool) ((Old & Bit) == 0);
+}
+
+// Each word of the run is claimed with one compare-and-swap. If a bit turns out to be taken part way through,
+// the words already claimed are given back.
+bool BitMap_ClaimRun(BitMap* map, uint32_t StartBit, uint32_t RunLength)
+{
+	uint32_t BitNum = StartBit;
+	uint32_t EndBit = StartBit + RunLength;
+
+	while (BitNum < EndBit)
+	{
+		uint32_t* Word 	= &map->dataarray[BitNum / WORD_SIZE];
+		uint32_t  Mask 	= _BitMap_RunMask(BitNum, EndBit);
+		uint32_t  Old 	= __atomic_load_n(Word, __ATOMIC_RELAXED);
+
+		do
+		{
+			if ((Old & Mask) != 0)
+			{
+				BitMap_ClearRun(map, StartBit, BitNum - StartBit);
+				return FALSE;
+			}
+		} while (__atomic_compare_exchange_n(Word, &Old, Old | Mask, TRUE, __ATOMIC_ACQ_REL, __ATOMIC_RELAXED) == FALSE);
+
+		_BitMap_Updated(map, BitNum / WORD_SIZE, Old, Old | Mask);
+		BitNum = ((BitNum / WORD_SIZE) + 1) * WORD_SIZE;
+	}
+
+	return TRUE;
+}
+
+bool BitMap_LoadWords(BitMap* map, uint32_t FirstWord, const uint32_t* Words, uint32_t NumWords)
+{
+	if (FirstWord > map->wordsize || NumWords > map->wordsize - FirstWord) return FALSE;
+
+	memcpy(&map->dataarray[FirstWord], Words, NumWords * sizeof(uint32_t));
+	_BitMap_Summarize(map, FirstWord, FirstWord + NumWords);
+
+	return TRUE;
+}
+
+void BitMap_StoreWords(BitMap* map, uint32_t FirstWord, uint32_t* Words, uint32_t NumWords)
+{
+	uint32_t WordIterator = 0;
+
+	for (WordIterator = 0; WordIterator < NumWords; WordIterator++)
+	{
+		Words[WordIterator] = _BitMap_LoadWord(map, FirstWord + WordIterator);
+	}
+}
+
+//***************************************** Private Functions ************************************//
+
+int32_t _BitMap_FindZeroRunFrom(BitMap* map, uint32_t StartBit, uint32_t RunLength, uint32_t BitLimit)
+{
+	if (RunLength == 0) return -1;
+
+	uint32_t FirstBit 	= StartBit;
+	bool	 Wrapped 	= FALSE;
+
+	while (TRUE)
+	{
+		// Before wrapping, runs may reach the end of the map. After wrapping, they are only looked for below FirstBit.
+		uint32_t SearchLimit = (Wrapped) ? FirstBit : BitLimit;
+		int32_t RunStart = BitMap_FindNextZero(map, StartBit, SearchLimit);
+
+		if (RunStart >= 0)
+		{
+			uint32_t RunFound = BitMap_CountZeroRun(map, (uint32_t) RunStart, RunLength, BitLimit);
+
+			if (RunFound == RunLength) return RunStart;
+
+			StartBit = (uint32_t) RunStart + RunFound;							// Too short; carry on from the set bit that ended it
+			continue;
+		}
+
+		if (Wrapped || FirstBit == 0) return -1;
+
+		Wrapped 	= TRUE;
+		StartBit 	= 0;
+	}
+}
+
+uint32_t _BitMap_LoadWord(BitMap* map, uint32_t WordNum)
+{
+	return __atomic_load_n(&map->dataarray[WordNum], __ATOMIC_RELAXED);
+}
+
+uint32_t _BitMap_RunMask(uint32_t BitNum, uint32_t EndBit)
+{
+	uint32_t WordEnd 	= ((BitNum / WORD_SIZE) + 1) * WORD_SIZE;
+	uint32_t Mask 		= 0xFFFFFFFF << (BitNum % WORD_SIZE);
+
+	if (EndBit < WordEnd) Mask &= 0xFFFFFFFF >> (WordEnd - EndBit);
+
+	return Mask;
+}
+
+// Finds the first bit at or after StartBit that differs from SkipWord's bits (SkipWord is all zeroes or all ones).
+// Words are handled two at a time as one 64-bit chunk, with the search flipped into a find-first-set on the chunk.
+int32_t _BitMap_FindNext(BitMap* map, uint32_t StartBit, uint32_t BitLimit, uint32_t SkipWord)
+{
+	if (BitLimit > map->bitsize) BitLimit = map->bitsize;
+	if (StartBit >= BitLimit) return -1;
+
+	uint32_t WordLimit 	= ((BitLimit - 1) / WORD_SIZE) + 1;
+	uint32_t WordNum 	= StartBit / WORD_SIZE;
+	uint64_t Invert 	= ((uint64_t) SkipWord << 32) | SkipWord;
+
+	// The first chunk may start part way through, so mask off the bits below StartBit
+	uint64_t Mask = ~0ULL << (StartBit % WORD_SIZE);
+
+	while (WordNum < WordLimit)
+	{
+		uint64_t Chunk = _BitMap_LoadWord(map, WordNum);
+		if (WordNum + 1 < WordLimit) Chunk |= (uint64_t) _BitMap_LoadWord(map, WordNum + 1) << 32;
+		else Chunk |= ((uint64_t) SkipWord) << 32;								// Nothing to find past the last word
+
+		Chunk = (Chunk ^ Invert) & Mask;
+
+		if (Chunk != 0)
+		{
+			uint32_t Found = (WordNum * WORD_SIZE) + _BitMap_CountTrailingZeros(Chunk);
+			return (Found < BitLimit) ? (int32_t) Found : -1;
+		}
+
+		WordNum += 2;
+		Mask = ~0ULL;
+
+		if (WordLimit - WordNum >= BITMAP_SIMD_MIN_WORDS) WordNum = _BitMap_SkipWords(map, WordNum, WordLimit, SkipWord);
+	}
+
+	return -1;
+}
+
+// Returns the first word at or after WordNum that might not equal SkipWord, checking four words per step.
+// The vector loads are not atomic; a word changed under them only moves where the atomic rescan starts, but
+// ThreadSanitizer cannot tell, so it gets the word-at-a-time loop.
+uint32_t _BitMap_SkipWords(BitMap* map, uint32_t WordNum, uint32_t WordLimit, uint32_t SkipWord)
+{
+#if defined(__SSE2__) && !defined(__SANITIZE_THREAD__)
+	__m128i Skip = _mm_set1_epi32((int) SkipWord);
+
+	while (WordNum + 4 <= WordLimit)
+	{
+		__m128i Words = _mm_loadu_si128((const __m128i*) &map->dataarray[WordNum]);
+
+		if (_mm_movemask_epi8(_mm_cmpeq_epi32(Words, Skip)) != 0xFFFF) break;
+
+		WordNum += 4;
+	}
+#else
+	while (WordNum < WordLimit && _BitMap_LoadWord(map, WordNum) == SkipWord) WordNum++;
+#endif
+
+	return WordNum;
+}
+
+uint32_t _BitMap_CountTrailingZeros(uint64_t Chunk)
+{
+#if defined(__GNUC__)
+	return (uint32_t) __builtin_ctzll(Chunk);
+#else
+	uint32_t Count = 0;
+	while ((Chunk & 1) == 0)
+	{
+		Chunk >>= 1;
+		Count++;
+	}
+	return Count;
+#endif
+}
+
+// One level per WORD_SIZE-fold reduction, until a single word covers everything
+bool _BitMap_InitSummary(BitMap* map)
+{
+	uint32_t Words = map->wordsize;
+
+	while (Words > 1 && map->levels < BITMAP_MAX_LEVELS)
+	{
+		Words = (Words + WORD_SIZE - 1) / WORD_SIZE;
+
+		map->summary[map->levels] = (uint32_t*) calloc(Words, sizeof(uint32_t));
+		if (map->summary[map->levels] == 0) return FALSE;
+
+		map->levels++;
+	}
+
+	return TRUE;
+}
+
+uint32_t* _BitMap_Level(BitMap* map, uint32_t Level)
+{
+	return (Level == 0) ? map->dataarray : map->summary[Level - 1];
+}
+
+void _BitMap_Updated(BitMap* map, uint32_t WordNum, uint32_t Old, uint32_t New)
+{
+	if (map->levels == 0) return;
+
+	if (New == BITMAP_FULL_WORD && Old != BITMAP_FULL_WORD) _BitMap_WordFilled(map, 0, WordNum);
+	else if (Old == BITMAP_FULL_WORD && New != BITMAP_FULL_WORD) _BitMap_WordOpened(map, 0, WordNum);
+}
+
+// A summary bit may only stay set while its word is full, or free bits would be lost to searches. The word is looked at
+// again once the bit is set: if a bit of it was cleared in the meantime, whoever cleared it may have found the summary
+// bit still clear and left, so the bit is taken back here.
+void _BitMap_WordFilled(BitMap* map, uint32_t Level, uint32_t WordNum)
+{
+	while (Level < map->levels)
+	{
+		uint32_t Bit = 1u << (WordNum % WORD_SIZE);
+		uint32_t Old = __atomic_fetch_or(&map->summary[Level][WordNum / WORD_SIZE], Bit, __ATOMIC_ACQ_REL);
+
+		if (__atomic_load_n(&_BitMap_Level(map, Level)[WordNum], __ATOMIC_RELAXED) != BITMAP_FULL_WORD)
+		{
+			_BitMap_WordOpened(map, Level, WordNum);
+			return;
+		}
+
+		if (Old == BITMAP_FULL_WORD || (Old | Bit) != BITMAP_FULL_WORD) return;	// The summary word did not just fill up
+
+		Level++;
+		WordNum /= WORD_SIZE;
+	}
+}
+
+void _BitMap_WordOpened(BitMap* map, uint32_t Level, uint32_t WordNum)
+{
+	while (Level < map->levels)
+	{
+		uint32_t Bit = 1u << (WordNum % WORD_SIZE);
+		uint32_t Old = __atomic_fetch_and(&map->summary[Level][WordNum / WORD_SIZE], ~Bit, __ATOMIC_ACQ_REL);
+
+		if (Old != BITMAP_FULL_WORD) return;									// Nothing above counted the summary word as full
+
+		Level++;
+		WordNum /= WORD_SIZE;
+	}
+}
+
+void _BitMap_Summarize(BitMap* map, uint32_t FirstWord, uint32_t EndWord)
+{
+	uint32_t Level = 0;
+
+	for (Level = 0; Level < map->levels && FirstWord < EndWord; Level++)
+	{
+		uint32_t* Words 	= _BitMap_Level(map, Level);
+		uint32_t  WordNum 	= 0;
+
+		for (WordNum = FirstWord; WordNum < EndWord; WordNum++)
+		{
+			uint32_t Bit = 1u << (WordNum % WORD_SIZE);
+
+			if (Words[WordNum] == BITMAP_FULL_WORD) map->summary[Level][WordNum / WORD_SIZE] |= Bit;
+			else map->summary[Level][WordNum / WORD_SIZE] &= ~Bit;
+		}
+
+		FirstWord 	= FirstWord / WORD_SIZE;
+		EndWord 	= ((EndWord - 1) / WORD_SIZE) + 1;
+	}
+}
+
+// First clear bit of the level at or after StartBit and below BitLimit. Once a word turns out to be full, the level
+// above is asked for the next word that is not, so runs of full words cost a few words per level rather than a scan.
+int32_t _BitMap_FindClear(BitMap* map, uint32_t Level, uint32_t StartBit, uint32_t BitLimit)
+{
+	uint32_t* Words = _BitMap_Level(map, Level);
+
+	while (StartBit < BitLimit)
+	{
+		uint32_t WordNum 	= StartBit / WORD_SIZE;
+		uint32_t Clear 		= ~__atomic_load_n(&Words[WordNum], __ATOMIC_RELAXED) & (BITMAP_FULL_WORD << (StartBit % WORD_SIZE));
+
+		if (Clear != 0)
+		{
+			uint32_t Found = (WordNum * WORD_SIZE) + _BitMap_CountTrailingZeros(Clear);
+			return (Found < BitLimit) ? (int32_t) Found : -1;
+		}
+
+		if (Level == map->levels)
+		{
+			StartBit = (WordNum + 1) * WORD_SIZE;								// The top level is a single word
+			continue;
+		}
+
+		int32_t NextWord = _BitMap_FindClear(map, Level + 1, WordNum + 1, ((BitLimit - 1) / WORD_SIZE) + 1);
+
+		if (NextWord < 0) return -1;
+
+		StartBit = (uint32_t) NextWord * WORD_SIZE;
+	}
+
+	return -1;
+}
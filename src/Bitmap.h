@@ -11,6 +11,7 @@
 #include "venkatlib.h"
 #endif
 #define WORD_SIZE 32
+#define BITMAP_MAX_LEVELS 6			// Summary levels needed by a map of 2^32 bits
 
 typedef struct NNODE_BitMap
 {
@@ -18,11 +19,46 @@ typedef struct NNODE_BitMap
 	uint32_t  wordsize;
 
 	uint32_t* dataarray;
+
+	uint32_t  nexthint;		// Where BitMap_FindFirstZero resumes (next-fit). Volatile only, never stored.
+
+	// Summary of the map, rebuilt whenever the map is loaded and never stored. Bit n of summary[0] is set while word n
+	// of dataarray is full, bit n of summary[1] while word n of summary[0] is, and so on up to a single word.
+	// Large maps only (see BITMAP_SUMMARY_MIN_WORDS); levels is 0 for the rest.
+	uint32_t  levels;
+	uint32_t* summary[BITMAP_MAX_LEVELS];
 } BitMap;
 
+// Every update is an atomic read-modify-write of the words involved, so threads can share a map without a lock.
+// Searches may see a map that is changing under them; only the claims below decide who gets a bit.
+// The summary of a large map is kept up to date by the same updates.
 BitMap* BitMap_Init(uint32_t SizeInWords);
 void 	BitMap_SetBit(BitMap* map,  uint32_t BitNum);
 void 	BitMap_ClearBit(BitMap* map, uint32_t BitNum);
 bool 	BitMap_TestBit(BitMap* map, uint32_t BitNum);
 void 	BitMap_DeInit(BitMap* map);
+
+// Searches only consider bits below BitLimit and return -1 if no bit qualifies.
+// They skip whole 64-bit words at a time (and 128-bit vectors on large maps where SSE2 is available). Searches for clear
+// bits in a summarized map instead climb the summary past the full words, a few words per level.
+int32_t BitMap_FindFirstZero(BitMap* map, uint32_t BitLimit);						// Next-fit: starts at the hint, wraps around once
+int32_t BitMap_FindNextZero(BitMap* map, uint32_t StartBit, uint32_t BitLimit);
+int32_t BitMap_FindFirstSet(BitMap* map, uint32_t BitLimit);
+int32_t BitMap_FindNextSet(BitMap* map, uint32_t StartBit, uint32_t BitLimit);
+
+// Contiguous runs of bits
+int32_t 	BitMap_FindZeroRun(BitMap* map, uint32_t RunLength, uint32_t BitLimit);				// Next-fit: start of the first run of RunLength clear bits
+int32_t 	BitMap_FindZeroRunNear(BitMap* map, uint32_t GoalBit, uint32_t RunLength, uint32_t BitLimit);	// Same, but starting at GoalBit (the hint is left alone)
+uint32_t 	BitMap_CountZeroRun(BitMap* map, uint32_t StartBit, uint32_t MaxLength, uint32_t BitLimit);	// Clear bits in a row from StartBit (at most MaxLength)
+void 		BitMap_SetRun(BitMap* map, uint32_t StartBit, uint32_t RunLength);
+void 		BitMap_ClearRun(BitMap* map, uint32_t StartBit, uint32_t RunLength);
+
+// Claims: compare-and-swap clear bits to set. FALSE (with the map left as it was) if any of them was already set.
+bool 		BitMap_ClaimBit(BitMap* map, uint32_t BitNum);
+bool 		BitMap_ClaimRun(BitMap* map, uint32_t StartBit, uint32_t RunLength);
+
+// Persistence, in as many pieces (e.g. sectors) as the map needs. Loading rebuilds the summary over the loaded words,
+// and must not race with other users of the map.
+bool 		BitMap_LoadWords(BitMap* map, uint32_t FirstWord, const uint32_t* Words, uint32_t NumWords);	// FALSE if the words do not fit
+void 		BitMap_StoreWords(BitMap* map, uint32_t FirstWord, uint32_t* Words, uint32_t NumWords);
 #endif /* OS_FILESYS_BITMAP_BITMAP_H_ */
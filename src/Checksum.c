@@ -0,0 +1,187 @@
+/*
+ * Checksum.c
+ *
+ *  Created on: Oct 18, 2026
+ */
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <pthread.h>
+#include "Checksum.h"
+#include "venkatlib.h"
+#if defined(__x86_64__)
+#include <nmmintrin.h>
+#endif
+
+pthread_once_t 	ChecksumInit 		= PTHREAD_ONCE_INIT;
+bool 			ChecksumAccelerated = FALSE;
+uint32_t 		ChecksumTable[8][256];											// ChecksumTable[n][b]: byte b followed by n zero bytes
+uint32_t 		ChecksumStrideTable[4][256];									// ChecksumStrideTable[n][b]: byte n of a checksum followed by CHECKSUM_STRIDE zero bytes
+
+// Private helpers
+void 		_Checksum_Init(void);													// Run once: pick the version and build the table
+uint32_t 	_Checksum_Software(uint32_t Crc, const BYTE* Data, size_t NumBytes);
+uint32_t 	_Checksum_Stride(uint32_t Crc);										// The checksum carried over CHECKSUM_STRIDE zero bytes
+#if defined(__x86_64__)
+__attribute__((target("sse4.2"))) uint32_t _Checksum_Hardware(uint32_t Crc, const BYTE* Data, size_t NumBytes);
+#endif
+
+uint32_t Checksum_CRC32C(const BYTE* Data, size_t NumBytes)
+{
+	pthread_once(&ChecksumInit, _Checksum_Init);
+
+#if defined(__x86_64__)
+	if (ChecksumAccelerated) return ~_Checksum_Hardware(~0u, Data, NumBytes);
+#endif
+
+	return ~_Checksum_Software(~0u, Data, NumBytes);
+}
+
+bool Checksum_IsAccelerated(void)
+{
+	pthread_once(&ChecksumInit, _Checksum_Init);
+
+	return ChecksumAccelerated;
+}
+
+//***************************************** Private Functions ************************************//
+
+void _Checksum_Init(void)
+{
+	uint32_t ByteIterator = 0;
+	uint32_t SliceIterator = 0;
+
+	for (ByteIterator = 0; ByteIterator < 256; ByteIterator++)
+	{
+		uint32_t Crc = ByteIterator;
+		uint32_t BitIterator = 0;
+
+		for (BitIterator = 0; BitIterator < 8; BitIterator++) Crc = (Crc >> 1) ^ ((Crc & 1) ? CHECKSUM_POLYNOMIAL : 0);
+
+		ChecksumTable[0][ByteIterator] = Crc;
+	}
+
+	for (SliceIterator = 1; SliceIterator < 8; SliceIterator++)
+	{
+		for (ByteIterator = 0; ByteIterator < 256; ByteIterator++)
+		{
+			uint32_t Previous = ChecksumTable[SliceIterator - 1][ByteIterator];
+
+			ChecksumTable[SliceIterator][ByteIterator] = (Previous >> 8) ^ ChecksumTable[0][Previous & 0xFF];
+		}
+	}
+
+	// Zero bytes only ever shift the checksum, so byte n of it can be shifted on its own
+	for (SliceIterator = 0; SliceIterator < 4; SliceIterator++)
+	{
+		for (ByteIterator = 0; ByteIterator < 256; ByteIterator++)
+		{
+			uint32_t Crc = ByteIterator << (8 * SliceIterator);
+			uint32_t ZeroIterator = 0;
+
+			for (ZeroIterator = 0; ZeroIterator < CHECKSUM_STRIDE; ZeroIterator++) Crc = (Crc >> 8) ^ ChecksumTable[0][Crc & 0xFF];
+
+			ChecksumStrideTable[SliceIterator][ByteIterator] = Crc;
+		}
+	}
+
+#if defined(__x86_64__)
+	ChecksumAccelerated = (bool) (__builtin_cpu_supports("sse4.2") != 0);
+#endif
+}
+
+uint32_t _Checksum_Stride(uint32_t Crc)
+{
+	return ChecksumStrideTable[0][Crc & 0xFF] ^ ChecksumStrideTable[1][(Crc >> 8) & 0xFF] ^ ChecksumStrideTable[2][(Crc >> 16) & 0xFF] ^ ChecksumStrideTable[3][Crc >> 24];
+}
+
+// Eight bytes per round, each looked up in its own table (little endian byte order assumed, as everywhere in Silk)
+uint32_t _Checksum_Software(uint32_t Crc, const BYTE* Data, size_t NumBytes)
+{
+	while (NumBytes >= 8)
+	{
+		uint32_t Low 	= 0;
+		uint32_t High 	= 0;
+
+		memcpy(&Low, Data, sizeof(Low));
+		memcpy(&High, &Data[4], sizeof(High));
+
+		Low ^= Crc;
+
+		Crc = ChecksumTable[7][Low & 0xFF] ^ ChecksumTable[6][(Low >> 8) & 0xFF] ^ ChecksumTable[5][(Low >> 16) & 0xFF] ^ ChecksumTable[4][Low >> 24] ^
+			  ChecksumTable[3][High & 0xFF] ^ ChecksumTable[2][(High >> 8) & 0xFF] ^ ChecksumTable[1][(High >> 16) & 0xFF] ^ ChecksumTable[0][High >> 24];
+
+		Data 	 += 8;
+		NumBytes -= 8;
+	}
+
+	while (NumBytes > 0)
+	{
+		Crc = (Crc >> 8) ^ ChecksumTable[0][(Crc ^ *Data) & 0xFF];
+
+		Data++;
+		NumBytes--;
+	}
+
+	return Crc;
+}
+
+#if defined(__x86_64__)
+// The crc32 instruction takes three cycles, but a new one can start every cycle. Three strides of the data are
+// therefore checksummed side by side, the second and third from zero, and the three results joined afterwards.
+__attribute__((target("sse4.2"))) uint32_t _Checksum_Hardware(uint32_t Crc, const BYTE* Data, size_t NumBytes)
+{
+	uint64_t Wide = Crc;
+
+	while (NumBytes >= 3 * CHECKSUM_STRIDE)
+	{
+		uint64_t 	Second 	= 0;
+		uint64_t 	Third 	= 0;
+		const BYTE* End 	= Data + CHECKSUM_STRIDE;
+
+		while (Data < End)
+		{
+			uint64_t Words[3];
+
+			memcpy(&Words[0], Data, sizeof(uint64_t));
+			memcpy(&Words[1], &Data[CHECKSUM_STRIDE], sizeof(uint64_t));
+			memcpy(&Words[2], &Data[2 * CHECKSUM_STRIDE], sizeof(uint64_t));
+
+			Wide 	= _mm_crc32_u64(Wide, Words[0]);
+			Second 	= _mm_crc32_u64(Second, Words[1]);
+			Third 	= _mm_crc32_u64(Third, Words[2]);
+
+			Data += 8;
+		}
+
+		Wide = _Checksum_Stride((uint32_t) Wide) ^ Second;
+		Wide = _Checksum_Stride((uint32_t) Wide) ^ Third;
+
+		Data 	 += 2 * CHECKSUM_STRIDE;
+		NumBytes -= 3 * CHECKSUM_STRIDE;
+	}
+
+	while (NumBytes >= 8)
+	{
+		uint64_t Word = 0;
+
+		memcpy(&Word, Data, sizeof(Word));
+		Wide = _mm_crc32_u64(Wide, Word);
+
+		Data 	 += 8;
+		NumBytes -= 8;
+	}
+
+	Crc = (uint32_t) Wide;
+
+	while (NumBytes > 0)
+	{
+		Crc = _mm_crc32_u8(Crc, *Data);
+
+		Data++;
+		NumBytes--;
+	}
+
+	return Crc;
+}
+#endif
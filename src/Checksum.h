@@ -0,0 +1,23 @@
+/*
+ * Checksum.h
+ *
+ *  Created on: Oct 18, 2026
+ */
+
+#ifndef OS_FILESYS_CHECKSUM_CHECKSUM_H_
+#define OS_FILESYS_CHECKSUM_CHECKSUM_H_
+#ifndef LAB3_VRTOS_EXTERNAL_LIBRARIES_VENKATWARE_VENKATLIB_H_
+#include "venkatlib.h"
+#endif
+#include <stddef.h>
+
+// CRC32C (the Castagnoli polynomial, as used by EXT4, btrfs and iSCSI). Where the CPU has SSE4.2 its crc32 instruction
+// does the work 8 bytes at a time; everywhere else a table-driven version (slicing by 8) does. Both give the same
+// result, so a store can be checked on any machine whatever wrote it. Which one is used is decided on the first call.
+
+#define CHECKSUM_POLYNOMIAL 	0x82F63B78										// Reflected
+#define CHECKSUM_STRIDE 		168												// Bytes per lane of the crc32 version: three of them fill a 512 byte block but for a word
+
+uint32_t	Checksum_CRC32C(const BYTE* Data, size_t NumBytes);
+bool		Checksum_IsAccelerated(void);											// The crc32 instruction is used
+#endif /* OS_FILESYS_CHECKSUM_CHECKSUM_H_ */
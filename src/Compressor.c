@@ -0,0 +1,182 @@
+/*
+ * Compressor.c
+ *
+ *  Created on: Oct 18, 2026
+ */
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include "Compressor.h"
+#include "venkatlib.h"
+
+// Private helpers
+uint32_t 	_Compressor_Read32(const BYTE* Input);
+uint32_t 	_Compressor_Hash(uint32_t Sequence);
+uint32_t 	_Compressor_ExtraBytes(uint32_t Length);								// Extra bytes a length of 15 or more needs
+void 		_Compressor_PutLength(BYTE* Output, uint32_t* OutputAt, uint32_t Length);	// The extra bytes of a nibble of 15
+bool 		_Compressor_GetLength(const BYTE* Input, uint32_t InputBytes, uint32_t* InputAt, uint32_t* Length);	// Adds the extra bytes to Length (FALSE if the input ends first)
+bool 		_Compressor_Emit(BYTE* Output, uint32_t MaxOutput, uint32_t* OutputAt, const BYTE* Literals, uint32_t NumLiterals, uint32_t Offset, uint32_t MatchLength);	// MatchLength 0 for the last sequence
+
+// Candidates come from a table of the last position every hash was seen at. Runs of input without a match are
+// skipped through faster the longer they get, so data that does not compress costs little time.
+uint32_t Compressor_Compress(const BYTE* Input, uint32_t InputBytes, BYTE* Output, uint32_t MaxOutput)
+{
+	uint32_t Table[1 << COMPRESSOR_HASH_BITS];
+	uint32_t Position 	= 0;
+	uint32_t Anchor 	= 0;														// First byte not yet written out
+	uint32_t OutputAt 	= 0;
+
+	memset(Table, 0, sizeof(Table));
+
+	while (InputBytes >= COMPRESSOR_MIN_MATCH && Position <= InputBytes - COMPRESSOR_MIN_MATCH)
+	{
+		uint32_t Sequence 	= _Compressor_Read32(&Input[Position]);
+		uint32_t Hash 		= _Compressor_Hash(Sequence);
+		uint32_t Candidate 	= Table[Hash];
+
+		Table[Hash] = Position;
+
+		if (Candidate >= Position || Position - Candidate > COMPRESSOR_MAX_OFFSET || _Compressor_Read32(&Input[Candidate]) != Sequence)
+		{
+			Position += 1 + ((Position - Anchor) >> 5);
+			continue;
+		}
+
+		uint32_t MatchLength = COMPRESSOR_MIN_MATCH;
+
+		while (Position + MatchLength < InputBytes && Input[Candidate + MatchLength] == Input[Position + MatchLength]) MatchLength++;
+
+		if (_Compressor_Emit(Output, MaxOutput, &OutputAt, &Input[Anchor], Position - Anchor, Position - Candidate, MatchLength) == FALSE) return 0;
+
+		Position += MatchLength;
+		Anchor 	  = Position;
+	}
+
+	if (_Compressor_Emit(Output, MaxOutput, &OutputAt, &Input[Anchor], InputBytes - Anchor, 0, 0) == FALSE) return 0;
+
+	return OutputAt;
+}
+
+// Every length and offset is checked against both buffers, so a damaged input fails instead of running off either
+bool Compressor_Decompress(const BYTE* Input, uint32_t InputBytes, BYTE* Output, uint32_t OutputBytes)
+{
+	uint32_t InputAt 	= 0;
+	uint32_t OutputAt 	= 0;
+
+	while (InputAt < InputBytes)
+	{
+		uint32_t Token 			= Input[InputAt++];
+		uint32_t NumLiterals 	= Token >> 4;
+
+		if (NumLiterals == 15 && _Compressor_GetLength(Input, InputBytes, &InputAt, &NumLiterals) == FALSE) return FALSE;
+		if (NumLiterals > InputBytes - InputAt || NumLiterals > OutputBytes - OutputAt) return FALSE;
+
+		memcpy(&Output[OutputAt], &Input[InputAt], NumLiterals);
+		InputAt  += NumLiterals;
+		OutputAt += NumLiterals;
+
+		if (InputAt == InputBytes) break;											// The last sequence
+
+		if (InputBytes - InputAt < 2) return FALSE;
+
+		uint32_t Offset 		= (uint32_t) Input[InputAt] | ((uint32_t) Input[InputAt + 1] << 8);
+		uint32_t MatchLength 	= Token & 15;
+
+		InputAt += 2;
+
+		if (MatchLength == 15 && _Compressor_GetLength(Input, InputBytes, &InputAt, &MatchLength) == FALSE) return FALSE;
+
+		MatchLength += COMPRESSOR_MIN_MATCH;
+
+		if (Offset == 0 || Offset > OutputAt || MatchLength > OutputBytes - OutputAt) return FALSE;
+
+		BYTE* Match = &Output[OutputAt - Offset];
+
+		// A match closer than its length repeats the bytes it is still writing, so it has to go byte by byte
+		if (Offset >= MatchLength) memcpy(&Output[OutputAt], Match, MatchLength);
+		else
+		{
+			uint32_t ByteIterator = 0;
+			for (ByteIterator = 0; ByteIterator < MatchLength; ByteIterator++) Output[OutputAt + ByteIterator] = Match[ByteIterator];
+		}
+
+		OutputAt += MatchLength;
+	}
+
+	return (bool) (OutputAt == OutputBytes);
+}
+
+//***************************************** Private Functions ************************************//
+
+uint32_t _Compressor_Read32(const BYTE* Input)
+{
+	uint32_t Value = 0;
+
+	memcpy(&Value, Input, sizeof(Value));
+
+	return Value;
+}
+
+uint32_t _Compressor_Hash(uint32_t Sequence)
+{
+	return (Sequence * 2654435761u) >> (32 - COMPRESSOR_HASH_BITS);
+}
+
+uint32_t _Compressor_ExtraBytes(uint32_t Length)
+{
+	return (Length < 15) ? 0 : ((Length - 15) / 255) + 1;
+}
+
+void _Compressor_PutLength(BYTE* Output, uint32_t* OutputAt, uint32_t Length)
+{
+	Length -= 15;
+
+	while (Length >= 255)
+	{
+		Output[(*OutputAt)++] = 255;
+		Length -= 255;
+	}
+
+	Output[(*OutputAt)++] = (BYTE) Length;
+}
+
+bool _Compressor_GetLength(const BYTE* Input, uint32_t InputBytes, uint32_t* InputAt, uint32_t* Length)
+{
+	BYTE Extra = 255;
+
+	while (Extra == 255)
+	{
+		if (*InputAt >= InputBytes) return FALSE;
+
+		Extra 	 = Input[(*InputAt)++];
+		*Length += Extra;
+	}
+
+	return TRUE;
+}
+
+bool _Compressor_Emit(BYTE* Output, uint32_t MaxOutput, uint32_t* OutputAt, const BYTE* Literals, uint32_t NumLiterals, uint32_t Offset, uint32_t MatchLength)
+{
+	uint32_t MatchCode = (MatchLength == 0) ? 0 : MatchLength - COMPRESSOR_MIN_MATCH;
+	uint64_t Needed 	= 1 + (uint64_t) _Compressor_ExtraBytes(NumLiterals) + NumLiterals;
+
+	if (MatchLength != 0) Needed += 2 + _Compressor_ExtraBytes(MatchCode);
+
+	if (Needed > MaxOutput - *OutputAt) return FALSE;
+
+	Output[(*OutputAt)++] = (BYTE) (((NumLiterals < 15) ? NumLiterals : 15) << 4 | ((MatchCode < 15) ? MatchCode : 15));
+
+	if (NumLiterals >= 15) _Compressor_PutLength(Output, OutputAt, NumLiterals);
+
+	memcpy(&Output[*OutputAt], Literals, NumLiterals);
+	*OutputAt += NumLiterals;
+
+	if (MatchLength == 0) return TRUE;
+
+	Output[(*OutputAt)++] = (BYTE) (Offset & 0xFF);
+	Output[(*OutputAt)++] = (BYTE) (Offset >> 8);
+
+	if (MatchCode >= 15) _Compressor_PutLength(Output, OutputAt, MatchCode);
+
+	return TRUE;
+}
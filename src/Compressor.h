@@ -0,0 +1,31 @@
+/*
+ * Compressor.h
+ *
+ *  Created on: Oct 18, 2026
+ */
+
+#ifndef OS_FILESYS_COMPRESSOR_COMPRESSOR_H_
+#define OS_FILESYS_COMPRESSOR_COMPRESSOR_H_
+#ifndef LAB3_VRTOS_EXTERNAL_LIBRARIES_VENKATWARE_VENKATLIB_H_
+#include "venkatlib.h"
+#endif
+
+// A small LZ77 codec in the manner of LZ4: fast to compress, faster still to decompress, and with no state kept between
+// calls. The output is a run of sequences, each a token byte, literals copied as is, and a match to copy from earlier
+// in the output:
+//
+//	token			high nibble: literals (15 = more follow as extra bytes), low nibble: match length - COMPRESSOR_MIN_MATCH
+//	[extra bytes]	added to a nibble of 15, for as long as they are 255
+//	literals
+//	offset			2 bytes, little endian: how far back the match starts
+//	[extra bytes]	for the match length
+//
+// The last sequence has literals only, and ends the input.
+
+#define COMPRESSOR_MIN_MATCH 	4
+#define COMPRESSOR_MAX_OFFSET 	65535
+#define COMPRESSOR_HASH_BITS 	12												// Positions remembered while looking for matches
+
+uint32_t	Compressor_Compress(const BYTE* Input, uint32_t InputBytes, BYTE* Output, uint32_t MaxOutput);	// Bytes written to Output (0 if they would not fit in MaxOutput)
+bool		Compressor_Decompress(const BYTE* Input, uint32_t InputBytes, BYTE* Output, uint32_t OutputBytes);	// FALSE unless Input decodes to exactly OutputBytes
+#endif /* OS_FILESYS_COMPRESSOR_COMPRESSOR_H_ */
@@ -0,0 +1,693 @@
+/*
+ * Directory.c
+ *
+ *  Created on: Oct 18, 2026
+ */
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include "Directory.h"
+#include "venkatlib.h"
+
+// Private helpers
+uint32_t 		_DirectoryTree_Hash(const char* Name);
+uint32_t 		_DirectoryTree_Bucket(uint32_t BlockNum);
+DirectoryNode* 	_DirectoryTree_Find(DirectoryTree* tree, uint32_t BlockNum);
+DirectoryNode* 	_DirectoryTree_GetNode(DirectoryTree* tree, uint32_t BlockNum, int32_t Depth);	// Resident copy of the node, read in if needed (0 if it cannot be, or is not a node of that depth; -1 takes any depth)
+DirectoryNode* 	_DirectoryTree_NewNode(DirectoryTree* tree, uint32_t BlockNum, uint32_t Depth);	// An empty node, not resident yet
+void 			_DirectoryTree_Adopt(DirectoryTree* tree, DirectoryNode* Node);					// Make a new node resident and changed
+void 			_DirectoryTree_NoteChanged(DirectoryTree* tree, DirectoryNode* Node);
+void 			_DirectoryTree_Retire(DirectoryTree* tree, uint32_t BlockNum);
+void 			_DirectoryTree_FreeNode(DirectoryTree* tree, uint32_t BlockNum, int32_t Depth);	// Retire the node and everything under it
+DirectoryNode* 	_DirectoryTree_FindLeaf(DirectoryTree* tree, uint32_t RootBlock, uint32_t Hash, DirectoryNode** Path, uint32_t* Slots, uint32_t* Depth);	// Leftmost leaf the hash can be in, and the way down to it
+DirectoryNode* 	_DirectoryTree_Locate(DirectoryTree* tree, uint32_t RootBlock, const char* Name, uint32_t* Position);	// Leaf holding the name (0 if none)
+uint32_t 		_DirectoryTree_Capacity(DirectoryTree* tree, DirectoryNode* Node);
+uint32_t 		_DirectoryTree_EntrySize(DirectoryNode* Node);
+uint32_t 		_DirectoryTree_EntryHash(DirectoryNode* Node, uint32_t Position);
+uint32_t 		_DirectoryTree_FirstAtLeast(DirectoryNode* Node, uint32_t Hash);			// First entry hashing to Hash or above
+uint32_t 		_DirectoryTree_FirstAbove(DirectoryNode* Node, uint32_t Hash);				// First entry hashing above Hash
+void 			_DirectoryTree_InsertAt(DirectoryNode* Node, uint32_t Position, BYTE* Entry);
+bool 			_DirectoryTree_NameIs(DirectoryEntry* Entry, const char* Name);
+
+#define _NODE_HEADER(Node) 			((DirectoryNodeHeader*) (Node)->Data)
+#define _LEAF_ENTRIES(Node) 		((DirectoryEntry*) &(Node)->Data[sizeof(DirectoryNodeHeader)])
+#define _INDEX_ENTRIES(Node) 		((DirectoryIndexEntry*) &(Node)->Data[sizeof(DirectoryNodeHeader)])
+#define _NODE_ENTRY(Node, Position) (&(Node)->Data[sizeof(DirectoryNodeHeader) + ((Position) * _DirectoryTree_EntrySize(Node))])
+
+DirectoryTree* DirectoryTree_Init(uint32_t BlockSize, DirectoryNodeIO ReadNode, DirectoryNodeAllocator AllocateNode, DirectoryRunRelease Release, void* Context)
+{
+	// A leaf has to hold two entries, or splitting a full one would not make room
+	if ((BlockSize - sizeof(DirectoryNodeHeader)) / sizeof(DirectoryEntry) < 2) return 0;
+
+	DirectoryTree* NewTree = (DirectoryTree*) calloc(1, sizeof(DirectoryTree));
+
+	// if memory allocation failed, return immediately
+	if (NewTree == 0)
+	{
+		return 0;
+	}
+
+	NewTree->BlockSize 		= BlockSize;
+	NewTree->LeafEntries 	= (BlockSize - sizeof(DirectoryNodeHeader)) / sizeof(DirectoryEntry);
+	NewTree->IndexEntries 	= (BlockSize - sizeof(DirectoryNodeHeader)) / sizeof(DirectoryIndexEntry);
+	NewTree->ReadNode 		= ReadNode;
+	NewTree->AllocateNode 	= AllocateNode;
+	NewTree->Release 		= Release;
+	NewTree->Context 		= Context;
+
+	return NewTree;
+}
+
+void DirectoryTree_FormatRoot(BYTE* RootBlock)
+{
+	DirectoryNodeHeader* Header = (DirectoryNodeHeader*) RootBlock;
+
+	Header->Magic 		= DIRECTORY_NODE_MAGIC;
+	Header->Depth 		= 0;
+	Header->NumEntries 	= 0;
+	Header->NextLeaf 	= 0;
+	Header->Reserved 	= 0;
+}
+
+int64_t DirectoryTree_Create(DirectoryTree* tree, uint32_t GoalBlock)
+{
+	int64_t Block = tree->AllocateNode(tree->Context, GoalBlock);
+
+	if (Block < 0) return -1;
+
+	DirectoryNode* Root = _DirectoryTree_NewNode(tree, (uint32_t) Block, 0);
+
+	if (Root == 0)
+	{
+		tree->Release(tree->Context, (uint32_t) Block, 1);
+		return -1;
+	}
+
+	_DirectoryTree_Adopt(tree, Root);
+
+	return Block;
+}
+
+int32_t DirectoryTree_Find(DirectoryTree* tree, uint32_t RootBlock, const char* Name)
+{
+	uint32_t 	   Position = 0;
+	DirectoryNode* Leaf 	= _DirectoryTree_Locate(tree, RootBlock, Name, &Position);
+
+	if (Leaf == 0) return -1;
+
+	return (int32_t) _LEAF_ENTRIES(Leaf)[Position].InodeNum;
+}
+
+// Every full node on the way up from the leaf is split. The blocks and memory for every node needed are claimed before
+// anything changes, so a tree that cannot grow is left as it was.
+bool DirectoryTree_Insert(DirectoryTree* tree, uint32_t RootBlock, const char* Name, uint32_t InodeNum)
+{
+	DirectoryNode* 	Path[DIRECTORY_MAX_DEPTH + 2];			// Root first
+	uint32_t 		Slots[DIRECTORY_MAX_DEPTH + 2];			// Child taken at every index level
+	uint32_t 		Depth = 0;
+	DirectoryEntry 	NewEntry;
+
+	memset(&NewEntry, 0, sizeof(DirectoryEntry));
+	memcpy(NewEntry.Name, Name, strnlen(Name, DIRECTORY_NAME_CHARS));
+
+	NewEntry.Hash 		= _DirectoryTree_Hash(Name);
+	NewEntry.InodeNum 	= InodeNum;
+
+	if (_DirectoryTree_FindLeaf(tree, RootBlock, NewEntry.Hash, Path, Slots, &Depth) == 0) return FALSE;
+
+	// One new node per full level, and one more when the root is full as well, to push its entries down into
+	int32_t  Level 	  = (int32_t) Depth;
+	uint32_t NumFresh = 0;
+
+	while (Level >= 0 && _NODE_HEADER(Path[Level])->NumEntries >= _DirectoryTree_Capacity(tree, Path[Level]))
+	{
+		NumFresh++;
+		Level--;
+	}
+
+	if (Level < 0)
+	{
+		if (Depth == DIRECTORY_MAX_DEPTH) return FALSE;
+		NumFresh++;
+	}
+
+	DirectoryNode* 	Fresh[DIRECTORY_MAX_DEPTH + 2];
+	uint32_t 		Claimed = 0;
+
+	for (Claimed = 0; Claimed < NumFresh; Claimed++)
+	{
+		int64_t Block = tree->AllocateNode(tree->Context, Path[Depth]->BlockNum);
+
+		if (Block >= 0) Fresh[Claimed] = _DirectoryTree_NewNode(tree, (uint32_t) Block, 0);
+		if (Block >= 0 && Fresh[Claimed] == 0) tree->Release(tree->Context, (uint32_t) Block, 1);
+		if (Block < 0 || Fresh[Claimed] == 0) break;
+	}
+
+	if (Claimed < NumFresh)
+	{
+		while (Claimed > 0)
+		{
+			Claimed--;
+			tree->Release(tree->Context, Fresh[Claimed]->BlockNum, 1);
+			free(Fresh[Claimed]->Data);
+			free(Fresh[Claimed]);
+		}
+
+		return FALSE;
+	}
+
+	// Whatever goes into the node at Level next: the new entry at first, then the index entry of each new right half
+	BYTE 	 Pending[sizeof(DirectoryEntry)];
+	uint32_t Position 	= _DirectoryTree_FirstAbove(Path[Depth], NewEntry.Hash);
+	uint32_t Next 		= 0;
+
+	memcpy(Pending, &NewEntry, sizeof(DirectoryEntry));
+	Level = (int32_t) Depth;
+
+	while (TRUE)
+	{
+		DirectoryNode* Node = Path[Level];
+
+		if (_NODE_HEADER(Node)->NumEntries < _DirectoryTree_Capacity(tree, Node))
+		{
+			_DirectoryTree_InsertAt(Node, Position, Pending);
+			_DirectoryTree_NoteChanged(tree, Node);
+
+			return TRUE;
+		}
+
+		if (Level == 0)
+		{
+			// Push the root's entries down into a node of their own, and point the root at it. The pushed node is
+			// full, so it is split next.
+			DirectoryNode* Pushed = Fresh[Next++];
+
+			memcpy(Pushed->Data, Node->Data, tree->BlockSize);
+
+			_NODE_HEADER(Node)->Depth 			= (uint16_t) (Depth + 1);
+			_NODE_HEADER(Node)->NumEntries 		= 1;
+			_NODE_HEADER(Node)->NextLeaf 		= 0;
+			_INDEX_ENTRIES(Node)[0].Hash 		= 0;
+			_INDEX_ENTRIES(Node)[0].ChildBlock 	= Pushed->BlockNum;
+
+			Depth++;
+
+			uint32_t LevelIterator = 0;
+			for (LevelIterator = Depth; LevelIterator >= 1; LevelIterator--)
+			{
+				Path[LevelIterator]  = Path[LevelIterator - 1];
+				Slots[LevelIterator] = Slots[LevelIterator - 1];
+			}
+
+			Path[1]  = Pushed;
+			Slots[0] = 0;
+			Level 	 = 1;
+
+			_DirectoryTree_Adopt(tree, Pushed);
+			_DirectoryTree_NoteChanged(tree, Node);
+			continue;
+		}
+
+		// Split: the upper half moves to a new node to the right, and its lowest hash becomes its lower bound
+		DirectoryNode* Right 	  = Fresh[Next++];
+		uint32_t 	   NumEntries = _NODE_HEADER(Node)->NumEntries;
+		uint32_t 	   LeftCount  = (NumEntries + 1) / 2;
+
+		_NODE_HEADER(Right)->Depth 		= _NODE_HEADER(Node)->Depth;
+		_NODE_HEADER(Right)->NumEntries = (uint16_t) (NumEntries - LeftCount);
+		memcpy(_NODE_ENTRY(Right, 0), _NODE_ENTRY(Node, LeftCount), (NumEntries - LeftCount) * _DirectoryTree_EntrySize(Node));
+		_NODE_HEADER(Node)->NumEntries 	= (uint16_t) LeftCount;
+
+		if (_NODE_HEADER(Node)->Depth == 0)
+		{
+			_NODE_HEADER(Right)->NextLeaf 	= _NODE_HEADER(Node)->NextLeaf;
+			_NODE_HEADER(Node)->NextLeaf 	= Right->BlockNum;
+		}
+
+		DirectoryIndexEntry Up = {_DirectoryTree_EntryHash(Right, 0), Right->BlockNum};
+
+		// Going to the end of the left half keeps the right half's lowest hash as it is
+		if (Position <= LeftCount) _DirectoryTree_InsertAt(Node, Position, Pending);
+		else _DirectoryTree_InsertAt(Right, Position - LeftCount, Pending);
+
+		_DirectoryTree_Adopt(tree, Right);
+		_DirectoryTree_NoteChanged(tree, Node);
+
+		memcpy(Pending, &Up, sizeof(DirectoryIndexEntry));
+
+		Level--;
+		Position = Slots[Level] + 1;
+	}
+}
+
+// Leaves are never merged, even once empty
+bool DirectoryTree_Remove(DirectoryTree* tree, uint32_t RootBlock, const char* Name)
+{
+	uint32_t 	   Position = 0;
+	DirectoryNode* Leaf 	= _DirectoryTree_Locate(tree, RootBlock, Name, &Position);
+
+	if (Leaf == 0) return FALSE;
+
+	DirectoryEntry* Entries 	= _LEAF_ENTRIES(Leaf);
+	uint32_t 		NumEntries 	= _NODE_HEADER(Leaf)->NumEntries;
+
+	memmove(&Entries[Position], &Entries[Position + 1], (NumEntries - Position - 1) * sizeof(DirectoryEntry));
+	_NODE_HEADER(Leaf)->NumEntries--;
+
+	_DirectoryTree_NoteChanged(tree, Leaf);
+
+	return TRUE;
+}
+
+// Down the left edge of the tree to the first leaf, then along the leaves
+bool DirectoryTree_Walk(DirectoryTree* tree, uint32_t RootBlock, DirectoryVisitor Visit, void* VisitContext)
+{
+	DirectoryNode* Node = _DirectoryTree_GetNode(tree, RootBlock, -1);
+
+	if (Node == 0) return FALSE;
+
+	uint32_t Depth = _NODE_HEADER(Node)->Depth;
+
+	while (Depth > 0)
+	{
+		if (_NODE_HEADER(Node)->NumEntries == 0) return FALSE;
+
+		Depth--;
+		Node = _DirectoryTree_GetNode(tree, _INDEX_ENTRIES(Node)[0].ChildBlock, (int32_t) Depth);
+
+		if (Node == 0) return FALSE;
+	}
+
+	char Name[DIRECTORY_NAME_CHARS + 1];
+
+	while (TRUE)
+	{
+		uint32_t EntryIterator = 0;
+
+		for (EntryIterator = 0; EntryIterator < _NODE_HEADER(Node)->NumEntries; EntryIterator++)
+		{
+			DirectoryEntry* Entry = &_LEAF_ENTRIES(Node)[EntryIterator];
+
+			memcpy(Name, Entry->Name, DIRECTORY_NAME_CHARS);
+			Name[DIRECTORY_NAME_CHARS] = 0;
+
+			if (Visit(VisitContext, Name, Entry->InodeNum) == FALSE) return FALSE;
+		}
+
+		if (_NODE_HEADER(Node)->NextLeaf == 0) return TRUE;
+
+		Node = _DirectoryTree_GetNode(tree, _NODE_HEADER(Node)->NextLeaf, 0);
+
+		if (Node == 0) return FALSE;
+	}
+}
+
+void DirectoryTree_Free(DirectoryTree* tree, uint32_t RootBlock)
+{
+	_DirectoryTree_FreeNode(tree, RootBlock, -1);
+}
+
+// A node that cannot be logged stays changed, for the next call to try again
+bool DirectoryTree_LogChanged(DirectoryTree* tree, DirectoryNodeIO LogNode)
+{
+	DirectoryNode* 	Node 		= tree->Changed;
+	bool 			AllLogged 	= TRUE;
+
+	tree->Changed = 0;
+
+	while (Node != 0)
+	{
+		DirectoryNode* Next = Node->NextChanged;
+
+		Node->NextChanged 	= 0;
+		Node->Changed 		= FALSE;
+
+		if (Node->Retired == TRUE)
+		{
+			free(Node->Data);
+			free(Node);
+		}
+		else if (LogNode(tree->Context, Node->Data, Node->BlockNum) == FALSE)
+		{
+			AllLogged = FALSE;
+			_DirectoryTree_NoteChanged(tree, Node);
+		}
+
+		Node = Next;
+	}
+
+	return AllLogged;
+}
+
+bool DirectoryTree_HasRetired(DirectoryTree* tree)
+{
+	return (bool) (tree->NumRetired > 0);
+}
+
+void DirectoryTree_ReleaseRetired(DirectoryTree* tree)
+{
+	uint32_t RetiredIterator = 0;
+
+	for (RetiredIterator = 0; RetiredIterator < tree->NumRetired; RetiredIterator++)
+	{
+		tree->Release(tree->Context, tree->Retired[RetiredIterator], 1);
+	}
+
+	tree->NumRetired = 0;
+}
+
+void DirectoryTree_DeInit(DirectoryTree* tree)
+{
+	if (tree == 0) return;
+
+	// Retired nodes are only on the changed list, everything else is hashed
+	while (tree->Changed != 0)
+	{
+		DirectoryNode* Node = tree->Changed;
+		tree->Changed = Node->NextChanged;
+
+		if (Node->Retired == TRUE)
+		{
+			free(Node->Data);
+			free(Node);
+		}
+	}
+
+	uint32_t BucketIterator = 0;
+
+	for (BucketIterator = 0; BucketIterator < DIRECTORY_NODE_BUCKETS; BucketIterator++)
+	{
+		while (tree->Buckets[BucketIterator] != 0)
+		{
+			DirectoryNode* Node = tree->Buckets[BucketIterator];
+			tree->Buckets[BucketIterator] = Node->NextInBucket;
+
+			free(Node->Data);
+			free(Node);
+		}
+	}
+
+	free(tree->Retired);
+	free(tree);
+}
+
+//***************************************** Private Functions ************************************//
+
+// 32-bit FNV-1a
+uint32_t _DirectoryTree_Hash(const char* Name)
+{
+	uint32_t Hash = 2166136261u;
+	uint32_t CharIterator = 0;
+
+	for (CharIterator = 0; CharIterator < DIRECTORY_NAME_CHARS && Name[CharIterator] != 0; CharIterator++)
+	{
+		Hash ^= (uint8_t) Name[CharIterator];
+		Hash *= 16777619u;
+	}
+
+	return Hash;
+}
+
+uint32_t _DirectoryTree_Bucket(uint32_t BlockNum)
+{
+	return (BlockNum * 2654435761u) & (DIRECTORY_NODE_BUCKETS - 1);
+}
+
+DirectoryNode* _DirectoryTree_Find(DirectoryTree* tree, uint32_t BlockNum)
+{
+	DirectoryNode* Node = tree->Buckets[_DirectoryTree_Bucket(BlockNum)];
+
+	while (Node != 0 && Node->BlockNum != BlockNum) Node = Node->NextInBucket;
+
+	return Node;
+}
+
+DirectoryNode* _DirectoryTree_GetNode(DirectoryTree* tree, uint32_t BlockNum, int32_t Depth)
+{
+	DirectoryNode* Node = _DirectoryTree_Find(tree, BlockNum);
+
+	if (Node == 0)
+	{
+		Node = _DirectoryTree_NewNode(tree, BlockNum, 0);
+
+		if (Node == 0) return 0;
+
+		if (tree->ReadNode(tree->Context, Node->Data, BlockNum) == FALSE)
+		{
+			free(Node->Data);
+			free(Node);
+			return 0;
+		}
+
+		uint32_t Bucket = _DirectoryTree_Bucket(BlockNum);
+
+		Node->NextInBucket 		= tree->Buckets[Bucket];
+		tree->Buckets[Bucket] 	= Node;
+		tree->NodesResident		++;
+	}
+
+	DirectoryNodeHeader* Header = _NODE_HEADER(Node);
+
+	if (Header->Magic != DIRECTORY_NODE_MAGIC || Header->Depth > DIRECTORY_MAX_DEPTH) return 0;
+	if ((Depth >= 0 && Header->Depth != (uint32_t) Depth) || Header->NumEntries > _DirectoryTree_Capacity(tree, Node)) return 0;
+
+	return Node;
+}
+
+DirectoryNode* _DirectoryTree_NewNode(DirectoryTree* tree, uint32_t BlockNum, uint32_t Depth)
+{
+	DirectoryNode* NewNode = (DirectoryNode*) calloc(1, sizeof(DirectoryNode));
+
+	if (NewNode == 0) return 0;
+
+	NewNode->Data = (BYTE*) calloc(1, tree->BlockSize);
+
+	if (NewNode->Data == 0)
+	{
+		free(NewNode);
+		return 0;
+	}
+
+	NewNode->BlockNum = BlockNum;
+
+	DirectoryTree_FormatRoot(NewNode->Data);
+	_NODE_HEADER(NewNode)->Depth = (uint16_t) Depth;
+
+	return NewNode;
+}
+
+void _DirectoryTree_Adopt(DirectoryTree* tree, DirectoryNode* Node)
+{
+	uint32_t Bucket = _DirectoryTree_Bucket(Node->BlockNum);
+
+	Node->NextInBucket 		= tree->Buckets[Bucket];
+	tree->Buckets[Bucket] 	= Node;
+	tree->NodesResident		++;
+
+	_DirectoryTree_NoteChanged(tree, Node);
+}
+
+void _DirectoryTree_NoteChanged(DirectoryTree* tree, DirectoryNode* Node)
+{
+	if (Node->Changed == TRUE) return;
+
+	Node->Changed 		= TRUE;
+	Node->NextChanged 	= tree->Changed;
+	tree->Changed 		= Node;
+}
+
+// The node leaves the resident set now, but its block is only released by DirectoryTree_ReleaseRetired
+void _DirectoryTree_Retire(DirectoryTree* tree, uint32_t BlockNum)
+{
+	DirectoryNode** Link = &tree->Buckets[_DirectoryTree_Bucket(BlockNum)];
+
+	while (*Link != 0 && (*Link)->BlockNum != BlockNum) Link = &(*Link)->NextInBucket;
+
+	if (*Link != 0)
+	{
+		DirectoryNode* Node = *Link;
+
+		*Link = Node->NextInBucket;
+		tree->NodesResident--;
+
+		if (Node->Changed == TRUE) Node->Retired = TRUE;						// Freed by DirectoryTree_LogChanged
+		else
+		{
+			free(Node->Data);
+			free(Node);
+		}
+	}
+
+	if (tree->NumRetired == tree->MaxRetired)
+	{
+		uint32_t  MaxRetired = (tree->MaxRetired == 0) ? 64 : tree->MaxRetired * 2;
+		uint32_t* Retired 	 = (uint32_t*) realloc(tree->Retired, MaxRetired * sizeof(uint32_t));
+
+		if (Retired != 0)
+		{
+			tree->Retired 	 = Retired;
+			tree->MaxRetired = MaxRetired;
+		}
+	}
+
+	// Without room to remember it the block is never released, which wastes it but is otherwise harmless
+	if (tree->NumRetired < tree->MaxRetired) tree->Retired[tree->NumRetired++] = BlockNum;
+}
+
+void _DirectoryTree_FreeNode(DirectoryTree* tree, uint32_t BlockNum, int32_t Depth)
+{
+	DirectoryNode* Node = _DirectoryTree_GetNode(tree, BlockNum, Depth);
+
+	// A node that cannot be read leaks whatever hangs off it
+	if (Node != 0 && _NODE_HEADER(Node)->Depth > 0)
+	{
+		uint32_t ChildDepth 	= _NODE_HEADER(Node)->Depth - 1u;
+		uint32_t EntryIterator 	= 0;
+
+		for (EntryIterator = 0; EntryIterator < _NODE_HEADER(Node)->NumEntries; EntryIterator++)
+		{
+			_DirectoryTree_FreeNode(tree, _INDEX_ENTRIES(Node)[EntryIterator].ChildBlock, (int32_t) ChildDepth);
+		}
+	}
+
+	_DirectoryTree_Retire(tree, BlockNum);
+}
+
+// At every level, the last child whose lower bound is below the hash: entries with the hash itself can only be in
+// that child or to the right of it.
+DirectoryNode* _DirectoryTree_FindLeaf(DirectoryTree* tree, uint32_t RootBlock, uint32_t Hash, DirectoryNode** Path, uint32_t* Slots, uint32_t* Depth)
+{
+	DirectoryNode* Node = _DirectoryTree_GetNode(tree, RootBlock, -1);
+
+	if (Node == 0) return 0;
+
+	uint32_t TreeDepth 	= _NODE_HEADER(Node)->Depth;
+	uint32_t Level 		= 0;
+
+	for (Level = 0; Level < TreeDepth; Level++)
+	{
+		if (_NODE_HEADER(Node)->NumEntries == 0) return 0;
+
+		uint32_t Slot = _DirectoryTree_FirstAtLeast(Node, Hash);
+		if (Slot > 0) Slot--;
+
+		if (Path != 0)
+		{
+			Path[Level]  = Node;
+			Slots[Level] = Slot;
+		}
+
+		Node = _DirectoryTree_GetNode(tree, _INDEX_ENTRIES(Node)[Slot].ChildBlock, (int32_t) (TreeDepth - Level - 1));
+
+		if (Node == 0) return 0;
+	}
+
+	if (Path != 0) Path[TreeDepth] = Node;
+	if (Depth != 0) *Depth = TreeDepth;
+
+	return Node;
+}
+
+DirectoryNode* _DirectoryTree_Locate(DirectoryTree* tree, uint32_t RootBlock, const char* Name, uint32_t* Position)
+{
+	uint32_t 	   Hash = _DirectoryTree_Hash(Name);
+	DirectoryNode* Leaf = _DirectoryTree_FindLeaf(tree, RootBlock, Hash, 0, 0, 0);
+
+	if (Leaf == 0) return 0;
+
+	uint32_t EntryIterator = _DirectoryTree_FirstAtLeast(Leaf, Hash);
+
+	while (TRUE)
+	{
+		for (; EntryIterator < _NODE_HEADER(Leaf)->NumEntries; EntryIterator++)
+		{
+			DirectoryEntry* Entry = &_LEAF_ENTRIES(Leaf)[EntryIterator];
+
+			if (Entry->Hash != Hash) return 0;									// Past every name with this hash
+
+			if (_DirectoryTree_NameIs(Entry, Name))
+			{
+				*Position = EntryIterator;
+				return Leaf;
+			}
+		}
+
+		// Names with this hash may carry on in the next leaf
+		if (_NODE_HEADER(Leaf)->NextLeaf == 0) return 0;
+
+		Leaf = _DirectoryTree_GetNode(tree, _NODE_HEADER(Leaf)->NextLeaf, 0);
+		EntryIterator = 0;
+
+		if (Leaf == 0) return 0;
+	}
+}
+
+uint32_t _DirectoryTree_Capacity(DirectoryTree* tree, DirectoryNode* Node)
+{
+	return (_NODE_HEADER(Node)->Depth == 0) ? tree->LeafEntries : tree->IndexEntries;
+}
+
+uint32_t _DirectoryTree_EntrySize(DirectoryNode* Node)
+{
+	return (_NODE_HEADER(Node)->Depth == 0) ? sizeof(DirectoryEntry) : sizeof(DirectoryIndexEntry);
+}
+
+// Both kinds of entry start with their hash
+uint32_t _DirectoryTree_EntryHash(DirectoryNode* Node, uint32_t Position)
+{
+	uint32_t Hash = 0;
+
+	memcpy(&Hash, _NODE_ENTRY(Node, Position), sizeof(uint32_t));
+
+	return Hash;
+}
+
+uint32_t _DirectoryTree_FirstAtLeast(DirectoryNode* Node, uint32_t Hash)
+{
+	uint32_t Low 	= 0;
+	uint32_t High 	= _NODE_HEADER(Node)->NumEntries;
+
+	while (Low < High)
+	{
+		uint32_t Middle = Low + ((High - Low) / 2);
+
+		if (_DirectoryTree_EntryHash(Node, Middle) < Hash) Low = Middle + 1;
+		else High = Middle;
+	}
+
+	return Low;
+}
+
+uint32_t _DirectoryTree_FirstAbove(DirectoryNode* Node, uint32_t Hash)
+{
+	uint32_t Low 	= 0;
+	uint32_t High 	= _NODE_HEADER(Node)->NumEntries;
+
+	while (Low < High)
+	{
+		uint32_t Middle = Low + ((High - Low) / 2);
+
+		if (_DirectoryTree_EntryHash(Node, Middle) <= Hash) Low = Middle + 1;
+		else High = Middle;
+	}
+
+	return Low;
+}
+
+// The node has room for one more entry
+void _DirectoryTree_InsertAt(DirectoryNode* Node, uint32_t Position, BYTE* Entry)
+{
+	uint32_t EntrySize 	= _DirectoryTree_EntrySize(Node);
+	uint32_t NumEntries = _NODE_HEADER(Node)->NumEntries;
+
+	memmove(_NODE_ENTRY(Node, Position + 1), _NODE_ENTRY(Node, Position), (NumEntries - Position) * EntrySize);
+	memcpy(_NODE_ENTRY(Node, Position), Entry, EntrySize);
+
+	_NODE_HEADER(Node)->NumEntries++;
+}
+
+// Names that use every character have no terminator, so never compare past the field
+bool _DirectoryTree_NameIs(DirectoryEntry* Entry, const char* Name)
+{
+	return (bool) (strncmp(Entry->Name, Name, DIRECTORY_NAME_CHARS) == 0);
+}
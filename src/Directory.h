@@ -0,0 +1,111 @@
+/*
+ * Directory.h
+ *
+ *  Created on: Oct 18, 2026
+ */
+
+#ifndef OS_FILESYS_DIRECTORY_DIRECTORY_H_
+#define OS_FILESYS_DIRECTORY_DIRECTORY_H_
+#ifndef LAB3_VRTOS_EXTERNAL_LIBRARIES_VENKATWARE_VENKATLIB_H_
+#include "venkatlib.h"
+#endif
+
+// Keeps the entries of directories in B+trees keyed by the hash of their names, as EXT4's hashed trees do.
+//
+// Every tree is made of nodes one block apiece, and its root stays in the block it was created in. Leaves hold the
+// entries, in hash order, and are chained from left to right. Index nodes hold, for every child, a hash no larger than
+// any in the child, so finding a name is a binary search at every level and then a walk along the leaves for as long
+// as the hash matches (names with the same hash may end up on either side of a split).
+//
+// A full node is split in two and the lower bound of the new half goes up to its parent; a full root has its entries
+// pushed down into a new node first, which makes the tree one level deeper. Nodes are never merged, so a directory
+// keeps its nodes until it is freed.
+//
+// Nodes are read in the first time they are needed and stay resident, as a changed node only reaches its home
+// once the journal checkpoints it. The owner logs the changed ones with DirectoryTree_LogChanged at every commit.
+// Nodes of a freed tree are retired: their blocks are only handed back (DirectoryTree_ReleaseRetired) once the owner
+// has made sure no logged image of them can be replayed any more.
+
+#define DIRECTORY_NAME_CHARS 		56											// Names that use every character have no terminator
+#define DIRECTORY_MAX_DEPTH 		8
+#define DIRECTORY_NODE_MAGIC 		0x52494453									// "SDIR"
+#define DIRECTORY_NODE_BUCKETS 		1024										// Power of two
+
+typedef struct NNODE_DirectoryEntry
+{
+	uint32_t Hash;						// Of Name
+	uint32_t InodeNum;
+	char	 Name[DIRECTORY_NAME_CHARS];
+} DirectoryEntry;
+
+typedef struct NNODE_DirectoryIndexEntry
+{
+	uint32_t Hash;						// No entry under the child hashes lower
+	uint32_t ChildBlock;
+} DirectoryIndexEntry;
+
+// Start of every node block; the entries follow it
+typedef struct NNODE_DirectoryNodeHeader
+{
+	uint32_t Magic;
+	uint16_t Depth;						// 0 for leaves
+	uint16_t NumEntries;
+	uint32_t NextLeaf;					// Leaves: block of the leaf to the right (0 for the last one)
+	uint32_t Reserved;
+} DirectoryNodeHeader;
+
+typedef struct NNODE_DirectoryNode
+{
+	uint32_t BlockNum;
+	bool	 Changed;					// On the changed list, to be logged
+	bool	 Retired;					// Its tree was freed; dropped instead of logged
+
+	BYTE*	 Data;						// One block: header, then entries
+
+	struct NNODE_DirectoryNode* NextInBucket;
+	struct NNODE_DirectoryNode* NextChanged;
+} DirectoryNode;
+
+// Store accessors. Context is handed through as is.
+typedef bool 	(*DirectoryNodeIO)(void* Context, BYTE* Buffer, uint32_t BlockNum);
+typedef int64_t (*DirectoryNodeAllocator)(void* Context, uint32_t GoalBlock);			// Claim one block, close to GoalBlock (-1 if there is none)
+typedef void 	(*DirectoryRunRelease)(void* Context, uint32_t FirstBlock, uint32_t NumBlocks);
+
+// Handed every entry of a directory by DirectoryTree_Walk. Returning FALSE stops the walk.
+typedef bool 	(*DirectoryVisitor)(void* Context, const char* Name, uint32_t InodeNum);
+
+// Nothing here is locked: the owner makes sure only one call runs at a time, over all of the trees.
+typedef struct NNODE_DirectoryTree
+{
+	uint32_t				BlockSize;
+	uint32_t				LeafEntries;			// Entries that fit in a leaf
+	uint32_t				IndexEntries;			// Entries that fit in an index node
+
+	DirectoryNode*			Buckets[DIRECTORY_NODE_BUCKETS];
+	DirectoryNode*			Changed;				// Changed since the last DirectoryTree_LogChanged
+
+	uint32_t*				Retired;				// Blocks of retired nodes
+	uint32_t				NumRetired;
+	uint32_t				MaxRetired;
+
+	DirectoryNodeIO			ReadNode;
+	DirectoryNodeAllocator	AllocateNode;
+	DirectoryRunRelease		Release;
+	void*					Context;
+
+	uint64_t				NodesResident;
+} DirectoryTree;
+
+DirectoryTree*	DirectoryTree_Init(uint32_t BlockSize, DirectoryNodeIO ReadNode, DirectoryNodeAllocator AllocateNode, DirectoryRunRelease Release, void* Context);
+void			DirectoryTree_FormatRoot(BYTE* RootBlock);											// Lay down the root of an empty tree (used by the filesystem format)
+int64_t			DirectoryTree_Create(DirectoryTree* tree, uint32_t GoalBlock);						// A new, empty tree. Returns its root block (-1 if there is no room).
+int32_t			DirectoryTree_Find(DirectoryTree* tree, uint32_t RootBlock, const char* Name);		// Inode of the entry (-1 if there is none)
+bool			DirectoryTree_Insert(DirectoryTree* tree, uint32_t RootBlock, const char* Name, uint32_t InodeNum);	// The name must not be in the tree yet. FALSE if the tree cannot grow.
+bool			DirectoryTree_Remove(DirectoryTree* tree, uint32_t RootBlock, const char* Name);	// FALSE if the name is not in the tree
+bool			DirectoryTree_Walk(DirectoryTree* tree, uint32_t RootBlock, DirectoryVisitor Visit, void* VisitContext);	// Every entry, in hash order
+void			DirectoryTree_Free(DirectoryTree* tree, uint32_t RootBlock);						// Retire every node of the tree
+bool			DirectoryTree_LogChanged(DirectoryTree* tree, DirectoryNodeIO LogNode);				// Hand every changed node to LogNode
+bool			DirectoryTree_HasRetired(DirectoryTree* tree);
+void			DirectoryTree_ReleaseRetired(DirectoryTree* tree);									// Hand the blocks of retired nodes back
+void			DirectoryTree_DeInit(DirectoryTree* tree);											// Changes not logged yet are lost
+#endif /* OS_FILESYS_DIRECTORY_DIRECTORY_H_ */
@@ -0,0 +1,657 @@
+/*
+ * ExtentTree.c
+ *
+ *  Created on: Oct 18, 2026
+ */
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <pthread.h>
+#include "ExtentTree.h"
+#include "venkatlib.h"
+
+// Private helpers
+uint32_t 	_ExtentTree_Hash(uint32_t BlockNum);
+ExtentNode* _ExtentTree_Find(ExtentTree* tree, uint32_t BlockNum);					// Needs the tree's lock
+ExtentNode* _ExtentTree_GetNode(ExtentTree* tree, uint32_t BlockNum, uint32_t Depth);	// Resident copy of the node, read in if needed (0 if it cannot be, or is not a node of that depth)
+ExtentNode* _ExtentTree_NewNode(ExtentTree* tree, uint32_t BlockNum, uint32_t Depth);	// An empty node, not resident yet
+void 		_ExtentTree_Adopt(ExtentTree* tree, ExtentNode* Node);					// Make a new node resident and changed
+void 		_ExtentTree_NoteChanged(ExtentTree* tree, ExtentNode* Node);
+void 		_ExtentTree_LinkChanged(ExtentTree* tree, ExtentNode* Node);				// _ExtentTree_NoteChanged for callers holding the tree's lock
+void 		_ExtentTree_Retire(ExtentTree* tree, uint32_t BlockNum);
+void 		_ExtentTree_FreeEntries(ExtentTree* tree, Extent* Entries, uint32_t NumEntries, uint32_t Depth);
+ExtentLookup _ExtentTree_WalkEntries(ExtentTree* tree, Extent* Entries, uint32_t NumEntries, uint32_t Depth, ExtentVisitor Visit, void* Context);
+uint32_t 	_ExtentTree_Search(Extent* Entries, uint32_t NumEntries, uint32_t FileBlock);	// Last entry starting at or before FileBlock
+ExtentLookup _ExtentTree_Leaf(ExtentTree* tree, ExtentRoot* Root, uint32_t FileBlock, Extent** Found, ExtentNode** Node);	// Leaf entry covering FileBlock, and the node holding it (0 for the root)
+bool 		_ExtentTree_Append(ExtentTree* tree, ExtentRoot* Root, uint32_t StartBlock, uint32_t NumBlocks);	// NumBlocks as kept in the entry
+
+#define _NODE_HEADER(Node) 	((ExtentNodeHeader*) (Node)->Data)
+#define _NODE_ENTRIES(Node) ((Extent*) &(Node)->Data[sizeof(ExtentNodeHeader)])
+
+ExtentTree* ExtentTree_Init(uint32_t BlockSize, ExtentNodeIO ReadNode, ExtentNodeAllocator AllocateNode, ExtentRunRelease Release, void* Context)
+{
+	// A node has to hold more than the root, or pushing the root down would not make room
+	if ((BlockSize - sizeof(ExtentNodeHeader)) / sizeof(Extent) <= EXTENT_ROOT_ENTRIES) return 0;
+
+	ExtentTree* NewTree = (ExtentTree*) calloc(1, sizeof(ExtentTree));
+
+	// if memory allocation failed, return immediately
+	if (NewTree == 0)
+	{
+		return 0;
+	}
+
+	if (pthread_mutex_init(&NewTree->Lock, 0) != 0)
+	{
+		free(NewTree);
+		return 0;
+	}
+
+	NewTree->BlockSize 		= BlockSize;
+	NewTree->NodeEntries 	= (BlockSize - sizeof(ExtentNodeHeader)) / sizeof(Extent);
+	NewTree->ReadNode 		= ReadNode;
+	NewTree->AllocateNode 	= AllocateNode;
+	NewTree->Release 		= Release;
+	NewTree->Context 		= Context;
+
+	return NewTree;
+}
+
+ExtentLookup ExtentTree_Map(ExtentTree* tree, ExtentRoot* Root, uint32_t FileBlock, uint32_t* BlockNum, uint32_t* RunLength)
+{
+	Extent* 	 Found 	= 0;
+	ExtentLookup Result = _ExtentTree_Leaf(tree, Root, FileBlock, &Found, 0);
+
+	if (Result != EXTENT_FOUND) return Result;
+	if (EXTENT_IS_CLUSTER(Found)) return EXTENT_UNMAPPED;
+
+	*BlockNum = Found->StartBlock + (FileBlock - Found->FileBlock);
+	if (RunLength != 0) *RunLength = Found->NumBlocks - (FileBlock - Found->FileBlock);
+
+	return EXTENT_FOUND;
+}
+
+ExtentLookup ExtentTree_Find(ExtentTree* tree, ExtentRoot* Root, uint32_t FileBlock, Extent* Found)
+{
+	Extent* 	 Leaf 	= 0;
+	ExtentLookup Result = _ExtentTree_Leaf(tree, Root, FileBlock, &Leaf, 0);
+
+	if (Result == EXTENT_FOUND) *Found = *Leaf;
+
+	return Result;
+}
+
+ExtentLookup ExtentTree_Last(ExtentTree* tree, ExtentRoot* Root, Extent* Last)
+{
+	Extent*  Entries 	= Root->Entries;
+	uint32_t NumEntries = Root->NumEntries;
+	uint32_t Depth 		= Root->Depth;
+
+	if (Depth > EXTENT_MAX_DEPTH) return EXTENT_UNREADABLE;
+
+	while (NumEntries > 0 && Depth > 0)
+	{
+		Depth--;
+
+		ExtentNode* Child = _ExtentTree_GetNode(tree, Entries[NumEntries - 1].StartBlock, Depth);
+
+		if (Child == 0) return EXTENT_UNREADABLE;
+
+		Entries 	= _NODE_ENTRIES(Child);
+		NumEntries 	= _NODE_HEADER(Child)->NumEntries;
+	}
+
+	if (NumEntries == 0) return EXTENT_UNMAPPED;
+
+	*Last = Entries[NumEntries - 1];
+
+	return EXTENT_FOUND;
+}
+
+// A lookup like the others: nodes are read in as needed, and the tree is not changed
+ExtentLookup ExtentTree_Walk(ExtentTree* tree, ExtentRoot* Root, ExtentVisitor Visit, void* Context)
+{
+	if (Root->Depth > EXTENT_MAX_DEPTH) return EXTENT_UNREADABLE;
+	if (Root->NumEntries == 0) return EXTENT_UNMAPPED;
+
+	return _ExtentTree_WalkEntries(tree, Root->Entries, Root->NumEntries, Root->Depth, Visit, Context);
+}
+
+bool ExtentTree_Append(ExtentTree* tree, ExtentRoot* Root, uint32_t StartBlock, uint32_t NumBlocks)
+{
+	if (NumBlocks > EXTENT_LENGTH_MASK) return FALSE;
+
+	return _ExtentTree_Append(tree, Root, StartBlock, NumBlocks);
+}
+
+bool ExtentTree_AppendCluster(ExtentTree* tree, ExtentRoot* Root, uint32_t StartBlock, uint32_t FileBlocks, uint32_t StoredBlocks)
+{
+	if (FileBlocks == 0 || FileBlocks > EXTENT_LENGTH_MASK || StoredBlocks == 0 || StoredBlocks > EXTENT_MAX_STORED) return FALSE;
+
+	return _ExtentTree_Append(tree, Root, StartBlock, FileBlocks | (StoredBlocks << EXTENT_LENGTH_BITS));
+}
+
+bool ExtentTree_Remap(ExtentTree* tree, ExtentRoot* Root, uint32_t FileBlock, uint32_t StartBlock, uint32_t StoredBlocks)
+{
+	ExtentNode* Node 	= 0;
+	Extent* 	Found 	= 0;
+
+	if (_ExtentTree_Leaf(tree, Root, FileBlock, &Found, &Node) != EXTENT_FOUND) return FALSE;
+	if (EXTENT_IS_CLUSTER(Found) == FALSE || Found->FileBlock != FileBlock) return FALSE;
+	if (StoredBlocks == 0 || StoredBlocks > EXTENT_MAX_STORED) return FALSE;
+
+	Found->StartBlock 	= StartBlock;
+	Found->NumBlocks 	= EXTENT_FILE_BLOCKS(Found) | (StoredBlocks << EXTENT_LENGTH_BITS);
+
+	if (Node != 0) _ExtentTree_NoteChanged(tree, Node);
+
+	return TRUE;
+}
+
+// The run either lengthens the last extent (when it carries straight on from it) or becomes a new one. A new one goes
+// into the rightmost leaf, or under a chain of new nodes hanging off the lowest ancestor with room. The blocks and
+// memory for every node needed are claimed before anything changes, so a tree that cannot grow is left as it was.
+bool _ExtentTree_Append(ExtentTree* tree, ExtentRoot* Root, uint32_t StartBlock, uint32_t NumBlocks)
+{
+	Extent*		Entries[EXTENT_MAX_DEPTH + 1];			// Right edge of the tree, root first
+	uint16_t*	Counts[EXTENT_MAX_DEPTH + 1];
+	ExtentNode*	Nodes[EXTENT_MAX_DEPTH + 1];			// 0 for the root
+	uint32_t	Depth = Root->Depth;
+	uint32_t	Level = 0;
+
+	if (NumBlocks == 0) return TRUE;
+	if (Depth > EXTENT_MAX_DEPTH) return FALSE;
+
+	Entries[0] = Root->Entries;
+	Counts[0]  = &Root->NumEntries;
+	Nodes[0]   = 0;
+
+	for (Level = 0; Level < Depth; Level++)
+	{
+		if (*Counts[Level] == 0) return FALSE;
+
+		ExtentNode* Child = _ExtentTree_GetNode(tree, Entries[Level][*Counts[Level] - 1].StartBlock, Depth - Level - 1);
+
+		if (Child == 0) return FALSE;
+
+		Entries[Level + 1] = _NODE_ENTRIES(Child);
+		Counts[Level + 1]  = &_NODE_HEADER(Child)->NumEntries;
+		Nodes[Level + 1]   = Child;
+	}
+
+	uint32_t FileBlock = 0;
+
+	if (*Counts[Depth] > 0)
+	{
+		Extent* LastExtent = &Entries[Depth][*Counts[Depth] - 1];
+
+		// Clusters stay extents of their own
+		bool Joins = (bool) (EXTENT_IS_CLUSTER(LastExtent) == FALSE && (NumBlocks >> EXTENT_LENGTH_BITS) == 0);
+
+		if (Joins && LastExtent->StartBlock + LastExtent->NumBlocks == StartBlock && LastExtent->NumBlocks + NumBlocks <= EXTENT_LENGTH_MASK)
+		{
+			LastExtent->NumBlocks += NumBlocks;
+			if (Nodes[Depth] != 0) _ExtentTree_NoteChanged(tree, Nodes[Depth]);
+
+			return TRUE;
+		}
+
+		FileBlock = LastExtent->FileBlock + EXTENT_FILE_BLOCKS(LastExtent);
+	}
+
+	// Lowest level with room for one more entry (-1 when even the root is full)
+	int32_t Roomy = (int32_t) Depth;
+	while (Roomy >= 0 && *Counts[Roomy] >= ((Roomy == 0) ? EXTENT_ROOT_ENTRIES : tree->NodeEntries)) Roomy--;
+
+	bool 	 Grows 	  = (bool) (Roomy < 0);
+	uint32_t NumFresh = Grows ? Depth + 1 : Depth - (uint32_t) Roomy;
+
+	if (Grows && Depth == EXTENT_MAX_DEPTH) return FALSE;
+
+	ExtentNode* Fresh[EXTENT_MAX_DEPTH + 1];
+	uint32_t 	Claimed = 0;
+
+	for (Claimed = 0; Claimed < NumFresh; Claimed++)
+	{
+		int64_t Block = tree->AllocateNode(tree->Context, StartBlock);
+
+		if (Block >= 0) Fresh[Claimed] = _ExtentTree_NewNode(tree, (uint32_t) Block, 0);
+		if (Block >= 0 && Fresh[Claimed] == 0) tree->Release(tree->Context, (uint32_t) Block, 1);
+		if (Block < 0 || Fresh[Claimed] == 0) break;
+	}
+
+	if (Claimed < NumFresh)
+	{
+		while (Claimed > 0)
+		{
+			Claimed--;
+			tree->Release(tree->Context, Fresh[Claimed]->BlockNum, 1);
+			free(Fresh[Claimed]->Data);
+			free(Fresh[Claimed]);
+		}
+
+		return FALSE;
+	}
+
+	uint32_t Next = 0;
+
+	if (Grows)
+	{
+		// Push the root's entries down into a node of their own, and point the root at it
+		ExtentNode* Pushed = Fresh[Next++];
+
+		_NODE_HEADER(Pushed)->Depth 		= (uint16_t) Depth;
+		_NODE_HEADER(Pushed)->NumEntries 	= Root->NumEntries;
+		memcpy(_NODE_ENTRIES(Pushed), Root->Entries, Root->NumEntries * sizeof(Extent));
+
+		Root->Entries[0].StartBlock = Pushed->BlockNum;
+		Root->Entries[0].NumBlocks 	= 0;
+		Root->NumEntries 			= 1;
+		Root->Depth 				= (uint16_t) ++Depth;
+
+		for (Level = Depth; Level >= 2; Level--)
+		{
+			Entries[Level] 	= Entries[Level - 1];
+			Counts[Level] 	= Counts[Level - 1];
+			Nodes[Level] 	= Nodes[Level - 1];
+		}
+
+		Entries[1] 	= _NODE_ENTRIES(Pushed);
+		Counts[1] 	= &_NODE_HEADER(Pushed)->NumEntries;
+		Nodes[1] 	= Pushed;
+		Roomy 		= 1;
+
+		_ExtentTree_Adopt(tree, Pushed);
+	}
+
+	// Build the chain bottom up: a leaf holding the new extent, and above it index nodes with one entry each
+	Extent NewEntry = {FileBlock, StartBlock, NumBlocks};
+
+	for (Level = Depth; Level > (uint32_t) Roomy; Level--)
+	{
+		ExtentNode* Chain = Fresh[Next++];
+
+		_NODE_HEADER(Chain)->Depth 		= (uint16_t) (Depth - Level);
+		_NODE_HEADER(Chain)->NumEntries = 1;
+		_NODE_ENTRIES(Chain)[0] 		= NewEntry;
+
+		NewEntry.StartBlock = Chain->BlockNum;
+		NewEntry.NumBlocks 	= 0;
+
+		_ExtentTree_Adopt(tree, Chain);
+	}
+
+	Entries[Roomy][*Counts[Roomy]] = NewEntry;
+	(*Counts[Roomy])++;
+
+	if (Nodes[Roomy] != 0) _ExtentTree_NoteChanged(tree, Nodes[Roomy]);
+
+	return TRUE;
+}
+
+void ExtentTree_Free(ExtentTree* tree, ExtentRoot* Root)
+{
+	if (Root->Depth <= EXTENT_MAX_DEPTH) _ExtentTree_FreeEntries(tree, Root->Entries, Root->NumEntries, Root->Depth);
+
+	Root->Depth 		= 0;
+	Root->NumEntries 	= 0;
+}
+
+// A node that cannot be logged stays changed, for the next call to try again
+bool ExtentTree_LogChanged(ExtentTree* tree, ExtentNodeIO LogNode)
+{
+	pthread_mutex_lock(&tree->Lock);
+
+	ExtentNode* Node 		= tree->Changed;
+	bool 		AllLogged 	= TRUE;
+
+	tree->Changed = 0;
+
+	while (Node != 0)
+	{
+		ExtentNode* Next = Node->NextChanged;
+
+		Node->NextChanged 	= 0;
+		Node->Changed 		= FALSE;
+
+		if (Node->Retired == TRUE)
+		{
+			free(Node->Data);
+			free(Node);
+		}
+		else if (LogNode(tree->Context, Node->Data, Node->BlockNum) == FALSE)
+		{
+			AllLogged = FALSE;
+			_ExtentTree_LinkChanged(tree, Node);
+		}
+
+		Node = Next;
+	}
+
+	pthread_mutex_unlock(&tree->Lock);
+
+	return AllLogged;
+}
+
+bool ExtentTree_HasRetired(ExtentTree* tree)
+{
+	pthread_mutex_lock(&tree->Lock);
+
+	bool HasRetired = (bool) (tree->NumRetired > 0);
+
+	pthread_mutex_unlock(&tree->Lock);
+
+	return HasRetired;
+}
+
+void ExtentTree_ReleaseRetired(ExtentTree* tree)
+{
+	pthread_mutex_lock(&tree->Lock);
+
+	uint32_t RetiredIterator = 0;
+
+	for (RetiredIterator = 0; RetiredIterator < tree->NumRetired; RetiredIterator++)
+	{
+		tree->Release(tree->Context, tree->Retired[RetiredIterator], 1);
+	}
+
+	tree->NumRetired = 0;
+
+	pthread_mutex_unlock(&tree->Lock);
+}
+
+void ExtentTree_DeInit(ExtentTree* tree)
+{
+	if (tree == 0) return;
+
+	// Retired nodes are only on the changed list, everything else is hashed
+	while (tree->Changed != 0)
+	{
+		ExtentNode* Node = tree->Changed;
+		tree->Changed = Node->NextChanged;
+
+		if (Node->Retired == TRUE)
+		{
+			free(Node->Data);
+			free(Node);
+		}
+	}
+
+	uint32_t BucketIterator = 0;
+
+	for (BucketIterator = 0; BucketIterator < EXTENT_NODE_BUCKETS; BucketIterator++)
+	{
+		while (tree->Buckets[BucketIterator] != 0)
+		{
+			ExtentNode* Node = tree->Buckets[BucketIterator];
+			tree->Buckets[BucketIterator] = Node->NextInBucket;
+
+			free(Node->Data);
+			free(Node);
+		}
+	}
+
+	pthread_mutex_destroy(&tree->Lock);
+	free(tree->Retired);
+	free(tree);
+}
+
+//***************************************** Private Functions ************************************//
+
+uint32_t _ExtentTree_Hash(uint32_t BlockNum)
+{
+	return (BlockNum * 2654435761u) & (EXTENT_NODE_BUCKETS - 1);
+}
+
+ExtentNode* _ExtentTree_Find(ExtentTree* tree, uint32_t BlockNum)
+{
+	ExtentNode* Node = tree->Buckets[_ExtentTree_Hash(BlockNum)];
+
+	while (Node != 0 && Node->BlockNum != BlockNum) Node = Node->NextInBucket;
+
+	return Node;
+}
+
+// The read happens outside the lock. Should another thread read the same node meanwhile, whichever copy is hashed first wins.
+ExtentNode* _ExtentTree_GetNode(ExtentTree* tree, uint32_t BlockNum, uint32_t Depth)
+{
+	pthread_mutex_lock(&tree->Lock);
+
+	ExtentNode* Node = _ExtentTree_Find(tree, BlockNum);
+
+	pthread_mutex_unlock(&tree->Lock);
+
+	if (Node == 0)
+	{
+		ExtentNode* Loaded = _ExtentTree_NewNode(tree, BlockNum, 0);
+
+		if (Loaded == 0) return 0;
+
+		if (tree->ReadNode(tree->Context, Loaded->Data, BlockNum) == FALSE)
+		{
+			free(Loaded->Data);
+			free(Loaded);
+			return 0;
+		}
+
+		pthread_mutex_lock(&tree->Lock);
+
+		Node = _ExtentTree_Find(tree, BlockNum);
+
+		if (Node == 0)
+		{
+			uint32_t Bucket = _ExtentTree_Hash(BlockNum);
+
+			Loaded->NextInBucket 	= tree->Buckets[Bucket];
+			tree->Buckets[Bucket] 	= Loaded;
+			tree->NodesResident		++;
+
+			Node 	= Loaded;
+			Loaded 	= 0;
+		}
+
+		pthread_mutex_unlock(&tree->Lock);
+
+		if (Loaded != 0)
+		{
+			free(Loaded->Data);
+			free(Loaded);
+		}
+	}
+
+	ExtentNodeHeader* Header = _NODE_HEADER(Node);
+
+	if (Header->Magic != EXTENT_NODE_MAGIC || Header->Depth != Depth || Header->NumEntries > tree->NodeEntries) return 0;
+
+	return Node;
+}
+
+ExtentNode* _ExtentTree_NewNode(ExtentTree* tree, uint32_t BlockNum, uint32_t Depth)
+{
+	ExtentNode* NewNode = (ExtentNode*) calloc(1, sizeof(ExtentNode));
+
+	if (NewNode == 0) return 0;
+
+	NewNode->Data = (BYTE*) calloc(1, tree->BlockSize);
+
+	if (NewNode->Data == 0)
+	{
+		free(NewNode);
+		return 0;
+	}
+
+	NewNode->BlockNum 				= BlockNum;
+	_NODE_HEADER(NewNode)->Magic 	= EXTENT_NODE_MAGIC;
+	_NODE_HEADER(NewNode)->Depth 	= (uint16_t) Depth;
+
+	return NewNode;
+}
+
+void _ExtentTree_Adopt(ExtentTree* tree, ExtentNode* Node)
+{
+	uint32_t Bucket = _ExtentTree_Hash(Node->BlockNum);
+
+	pthread_mutex_lock(&tree->Lock);
+
+	Node->NextInBucket 		= tree->Buckets[Bucket];
+	tree->Buckets[Bucket] 	= Node;
+	tree->NodesResident		++;
+
+	pthread_mutex_unlock(&tree->Lock);
+
+	_ExtentTree_NoteChanged(tree, Node);
+}
+
+void _ExtentTree_NoteChanged(ExtentTree* tree, ExtentNode* Node)
+{
+	pthread_mutex_lock(&tree->Lock);
+
+	_ExtentTree_LinkChanged(tree, Node);
+
+	pthread_mutex_unlock(&tree->Lock);
+}
+
+void _ExtentTree_LinkChanged(ExtentTree* tree, ExtentNode* Node)
+{
+	if (Node->Changed == TRUE) return;
+
+	Node->Changed 		= TRUE;
+	Node->NextChanged 	= tree->Changed;
+	tree->Changed 		= Node;
+}
+
+// The node leaves the resident set now, but its block is only released by ExtentTree_ReleaseRetired
+void _ExtentTree_Retire(ExtentTree* tree, uint32_t BlockNum)
+{
+	pthread_mutex_lock(&tree->Lock);
+
+	ExtentNode** Link = &tree->Buckets[_ExtentTree_Hash(BlockNum)];
+
+	while (*Link != 0 && (*Link)->BlockNum != BlockNum) Link = &(*Link)->NextInBucket;
+
+	if (*Link != 0)
+	{
+		ExtentNode* Node = *Link;
+
+		*Link = Node->NextInBucket;
+		tree->NodesResident--;
+
+		if (Node->Changed == TRUE) Node->Retired = TRUE;						// Freed by ExtentTree_LogChanged
+		else
+		{
+			free(Node->Data);
+			free(Node);
+		}
+	}
+
+	if (tree->NumRetired == tree->MaxRetired)
+	{
+		uint32_t  MaxRetired = (tree->MaxRetired == 0) ? 64 : tree->MaxRetired * 2;
+		uint32_t* Retired 	 = (uint32_t*) realloc(tree->Retired, MaxRetired * sizeof(uint32_t));
+
+		if (Retired != 0)
+		{
+			tree->Retired 	 = Retired;
+			tree->MaxRetired = MaxRetired;
+		}
+	}
+
+	// Without room to remember it the block is never released, which wastes it but is otherwise harmless
+	if (tree->NumRetired < tree->MaxRetired) tree->Retired[tree->NumRetired++] = BlockNum;
+
+	pthread_mutex_unlock(&tree->Lock);
+}
+
+void _ExtentTree_FreeEntries(ExtentTree* tree, Extent* Entries, uint32_t NumEntries, uint32_t Depth)
+{
+	uint32_t EntryIterator = 0;
+
+	for (EntryIterator = 0; EntryIterator < NumEntries; EntryIterator++)
+	{
+		if (Depth == 0)
+		{
+			tree->Release(tree->Context, Entries[EntryIterator].StartBlock, EXTENT_STORED_BLOCKS(&Entries[EntryIterator]));
+			continue;
+		}
+
+		ExtentNode* Child = _ExtentTree_GetNode(tree, Entries[EntryIterator].StartBlock, Depth - 1);
+
+		// A node that cannot be read leaks whatever it maps
+		if (Child != 0) _ExtentTree_FreeEntries(tree, _NODE_ENTRIES(Child), _NODE_HEADER(Child)->NumEntries, Depth - 1);
+
+		_ExtentTree_Retire(tree, Entries[EntryIterator].StartBlock);
+	}
+}
+
+ExtentLookup _ExtentTree_WalkEntries(ExtentTree* tree, Extent* Entries, uint32_t NumEntries, uint32_t Depth, ExtentVisitor Visit, void* Context)
+{
+	uint32_t EntryIterator = 0;
+
+	for (EntryIterator = 0; EntryIterator < NumEntries; EntryIterator++)
+	{
+		if (Depth == 0)
+		{
+			Visit(Context, &Entries[EntryIterator]);
+			continue;
+		}
+
+		ExtentNode* Child = _ExtentTree_GetNode(tree, Entries[EntryIterator].StartBlock, Depth - 1);
+
+		if (Child == 0) return EXTENT_UNREADABLE;
+
+		if (_ExtentTree_WalkEntries(tree, _NODE_ENTRIES(Child), _NODE_HEADER(Child)->NumEntries, Depth - 1, Visit, Context) == EXTENT_UNREADABLE) return EXTENT_UNREADABLE;
+	}
+
+	return EXTENT_FOUND;
+}
+
+uint32_t _ExtentTree_Search(Extent* Entries, uint32_t NumEntries, uint32_t FileBlock)
+{
+	uint32_t Low 	= 0;
+	uint32_t High 	= NumEntries;				// Entries[Low].FileBlock <= FileBlock < Entries[High].FileBlock
+
+	while (High - Low > 1)
+	{
+		uint32_t Middle = Low + ((High - Low) / 2);
+
+		if (Entries[Middle].FileBlock <= FileBlock) Low = Middle;
+		else High = Middle;
+	}
+
+	return Low;
+}
+
+ExtentLookup _ExtentTree_Leaf(ExtentTree* tree, ExtentRoot* Root, uint32_t FileBlock, Extent** Found, ExtentNode** Node)
+{
+	Extent*  Entries 	= Root->Entries;
+	uint32_t NumEntries = Root->NumEntries;
+	uint32_t Depth 		= Root->Depth;
+
+	if (Node != 0) *Node = 0;
+	if (Depth > EXTENT_MAX_DEPTH) return EXTENT_UNREADABLE;
+
+	while (TRUE)
+	{
+		if (NumEntries == 0 || Entries[0].FileBlock > FileBlock) return EXTENT_UNMAPPED;
+
+		Extent* Entry = &Entries[_ExtentTree_Search(Entries, NumEntries, FileBlock)];
+
+		if (Depth == 0)
+		{
+			if (FileBlock - Entry->FileBlock >= EXTENT_FILE_BLOCKS(Entry)) return EXTENT_UNMAPPED;	// Past the end of the file
+
+			*Found = Entry;
+			return EXTENT_FOUND;
+		}
+
+		Depth--;
+
+		ExtentNode* Child = _ExtentTree_GetNode(tree, Entry->StartBlock, Depth);
+
+		if (Child == 0) return EXTENT_UNREADABLE;
+		if (Node != 0) *Node = Child;
+
+		Entries 	= _NODE_ENTRIES(Child);
+		NumEntries 	= _NODE_HEADER(Child)->NumEntries;
+	}
+}
@@ -0,0 +1,132 @@
+/*
+ * ExtentTree.h
+ *
+ *  Created on: Oct 18, 2026
+ */
+
+#ifndef OS_FILESYS_EXTENTTREE_EXTENTTREE_H_
+#define OS_FILESYS_EXTENTTREE_EXTENTTREE_H_
+#include <pthread.h>
+#ifndef LAB3_VRTOS_EXTERNAL_LIBRARIES_VENKATWARE_VENKATLIB_H_
+#include "venkatlib.h"
+#endif
+
+// Maps the blocks of a file onto blocks of the store with a tree of extents, as in EXT4.
+//
+// The root of every tree lives in its inode and holds EXTENT_ROOT_ENTRIES entries. A file needing more gets tree
+// nodes, one block apiece. The entries of a leaf are extents; the entries of an index node (or of a root of depth
+// above 0) point at the node covering the file blocks from their FileBlock onwards. Entries are kept in file order,
+// so looking a block up is a binary search at every level.
+//
+// Files only ever grow at their end, so new entries always go to the rightmost leaf. When that leaf is full a new
+// chain of nodes hangs off the lowest ancestor with room, and when the root is full its entries are pushed down
+// into a new node, which makes the tree one level deeper.
+//
+// A file can also be mapped one cluster at a time (ExtentTree_AppendCluster), for data kept compressed: every cluster is
+// an extent of its own, covering a fixed number of file blocks but stored in as few blocks as its data needs. Clusters
+// are never merged, and a cluster rewritten elsewhere is pointed at its new home with ExtentTree_Remap.
+//
+// Nodes are read in the first time they are needed and stay resident, as a changed node only reaches its home
+// once the journal checkpoints it. The owner logs the changed ones with ExtentTree_LogChanged at every commit.
+// Nodes of a freed tree are retired: their blocks are only handed back (ExtentTree_ReleaseRetired) once the owner
+// has made sure no logged image of them can be replayed any more.
+
+#define EXTENT_ROOT_ENTRIES 	6
+#define EXTENT_MAX_DEPTH 		8											// Far more than 32 bit file block numbers can use
+#define EXTENT_NODE_MAGIC 		0x52545845									// "EXTR"
+#define EXTENT_NODE_BUCKETS 	1024										// Power of two
+
+// NumBlocks of a cluster keeps the blocks it is stored in above EXTENT_LENGTH_BITS; that part is 0 for any other extent
+#define EXTENT_LENGTH_BITS 		24
+#define EXTENT_LENGTH_MASK 		((1u << EXTENT_LENGTH_BITS) - 1)
+#define EXTENT_MAX_STORED 		255
+#define EXTENT_IS_CLUSTER(Entry) 		(((Entry)->NumBlocks >> EXTENT_LENGTH_BITS) != 0)
+#define EXTENT_FILE_BLOCKS(Entry) 		((Entry)->NumBlocks & EXTENT_LENGTH_MASK)						// File blocks covered
+#define EXTENT_STORED_BLOCKS(Entry) 	(EXTENT_IS_CLUSTER(Entry) ? (Entry)->NumBlocks >> EXTENT_LENGTH_BITS : EXTENT_FILE_BLOCKS(Entry))	// Blocks of the store taken
+
+typedef struct NNODE_Extent
+{
+	uint32_t FileBlock;					// First block of the file covered
+	uint32_t StartBlock;				// Leaf: first block of the run. Index: block of the child node
+	uint32_t NumBlocks;					// Leaf: length of the run (see EXTENT_LENGTH_BITS). Unused in index entries
+} Extent;
+
+typedef struct NNODE_ExtentRoot
+{
+	uint16_t Depth;						// 0 while the root's entries are the extents themselves
+	uint16_t NumEntries;
+	Extent	 Entries[EXTENT_ROOT_ENTRIES];
+} ExtentRoot;
+
+// Start of every tree node block; the entries follow it
+typedef struct NNODE_ExtentNodeHeader
+{
+	uint32_t Magic;
+	uint16_t Depth;						// 0 for leaves
+	uint16_t NumEntries;
+} ExtentNodeHeader;
+
+typedef struct NNODE_ExtentNode
+{
+	uint32_t BlockNum;
+	bool	 Changed;					// On the changed list, to be logged
+	bool	 Retired;					// Its tree was freed; dropped instead of logged
+
+	BYTE*	 Data;						// One block: header, then entries
+
+	struct NNODE_ExtentNode* NextInBucket;
+	struct NNODE_ExtentNode* NextChanged;
+} ExtentNode;
+
+// What a lookup found. A tree whose nodes cannot all be read is not the same as a file block that is not mapped.
+typedef enum NNODE_ExtentLookup
+{
+	EXTENT_FOUND,
+	EXTENT_UNMAPPED,					// No extent covers the file block
+	EXTENT_UNREADABLE					// A node on the way could not be read in, or is not a node of the tree
+} ExtentLookup;
+
+// Store accessors. Context is handed through as is.
+typedef bool 	(*ExtentNodeIO)(void* Context, BYTE* Buffer, uint32_t BlockNum);
+typedef int64_t (*ExtentNodeAllocator)(void* Context, uint32_t GoalBlock);				// Claim one block, close to GoalBlock (-1 if there is none)
+typedef void 	(*ExtentRunRelease)(void* Context, uint32_t FirstBlock, uint32_t NumBlocks);
+typedef void 	(*ExtentVisitor)(void* Context, Extent* Entry);						// Handed every extent by ExtentTree_Walk (its own Context)
+
+// Every call other than the lookups holds the tree's lock while it changes the resident nodes. The trees themselves are
+// guarded by their owner: a tree can be read by any number of threads at once, but changed by one thread at a time.
+typedef struct NNODE_ExtentTree
+{
+	pthread_mutex_t		Lock;
+
+	uint32_t			BlockSize;
+	uint32_t			NodeEntries;			// Entries that fit in a node
+
+	ExtentNode*			Buckets[EXTENT_NODE_BUCKETS];
+	ExtentNode*			Changed;				// Changed since the last ExtentTree_LogChanged
+
+	uint32_t*			Retired;				// Blocks of retired nodes
+	uint32_t			NumRetired;
+	uint32_t			MaxRetired;
+
+	ExtentNodeIO		ReadNode;
+	ExtentNodeAllocator	AllocateNode;
+	ExtentRunRelease	Release;
+	void*				Context;
+
+	uint64_t			NodesResident;
+} ExtentTree;
+
+ExtentTree*	ExtentTree_Init(uint32_t BlockSize, ExtentNodeIO ReadNode, ExtentNodeAllocator AllocateNode, ExtentRunRelease Release, void* Context);
+ExtentLookup ExtentTree_Map(ExtentTree* tree, ExtentRoot* Root, uint32_t FileBlock, uint32_t* BlockNum, uint32_t* RunLength);	// EXTENT_UNMAPPED for a block in a cluster too
+ExtentLookup ExtentTree_Find(ExtentTree* tree, ExtentRoot* Root, uint32_t FileBlock, Extent* Found);	// The extent covering the file block
+ExtentLookup ExtentTree_Last(ExtentTree* tree, ExtentRoot* Root, Extent* Last);	// The extent at the end of the file (EXTENT_UNMAPPED if it has none)
+ExtentLookup ExtentTree_Walk(ExtentTree* tree, ExtentRoot* Root, ExtentVisitor Visit, void* Context);	// Visit every extent in file order (EXTENT_UNREADABLE once a node cannot be read)
+bool		ExtentTree_Append(ExtentTree* tree, ExtentRoot* Root, uint32_t StartBlock, uint32_t NumBlocks);	// Map the run after the file's last block
+bool		ExtentTree_AppendCluster(ExtentTree* tree, ExtentRoot* Root, uint32_t StartBlock, uint32_t FileBlocks, uint32_t StoredBlocks);	// Map a cluster after the file's last block
+bool		ExtentTree_Remap(ExtentTree* tree, ExtentRoot* Root, uint32_t FileBlock, uint32_t StartBlock, uint32_t StoredBlocks);	// Move the cluster starting at the file block (FALSE if none does)
+void		ExtentTree_Free(ExtentTree* tree, ExtentRoot* Root);				// Release every run and retire every node of the tree
+bool		ExtentTree_LogChanged(ExtentTree* tree, ExtentNodeIO LogNode);		// Hand every changed node to LogNode
+bool		ExtentTree_HasRetired(ExtentTree* tree);
+void		ExtentTree_ReleaseRetired(ExtentTree* tree);						// Hand the blocks of retired nodes back
+void		ExtentTree_DeInit(ExtentTree* tree);								// Changes not logged yet are lost
+#endif /* OS_FILESYS_EXTENTTREE_EXTENTTREE_H_ */
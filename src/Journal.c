@@ -0,0 +1,329 @@
+/*
+ * Journal.c
+ *
+ *  Created on: Oct 18, 2026
+ */
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include "Journal.h"
+#include "Checksum.h"
+#include "venkatlib.h"
+
+#define JOURNAL_HEADER_MAGIC		0x4A524E4C		// "JRNL"
+#define JOURNAL_DESCRIPTOR_MAGIC	0x4A445343		// "JDSC"
+#define JOURNAL_COMMIT_MAGIC		0x4A434D54		// "JCMT"
+
+// On-disk layouts. Each sits at the start of its own sector.
+typedef struct NNODE_JournalHeader
+{
+	uint32_t Magic;
+	uint32_t Sequence;					// Sequence number of the first transaction in the log
+} JournalHeader;
+
+typedef struct NNODE_JournalDescriptor
+{
+	uint32_t Magic;
+	uint32_t Sequence;
+	uint32_t NumSectors;				// Images following the descriptor
+	uint32_t HomeSectors[];				// Where each of them belongs
+} JournalDescriptor;
+
+typedef struct NNODE_JournalCommit
+{
+	uint32_t Magic;
+	uint32_t Sequence;
+	uint32_t NumSectors;
+	uint32_t Checksum;					// Over the descriptor and every image
+} JournalCommit;
+
+// Used by Journal_Checkpoint to order the home writes
+typedef struct NNODE_CheckpointSector
+{
+	uint64_t HomeSector;
+	uint32_t Slot;
+} CheckpointSector;
+
+// Private helpers
+bool		_Journal_WriteHeader(Journal* journal);
+void		_Journal_AddToCheckpoint(Journal* journal, BYTE* Sector, uint64_t HomeSector);
+int 		_Journal_CompareHomes(const void* first, const void* second);
+
+Journal* Journal_Init(uint64_t StartSector, uint32_t NumSectors, uint32_t SectorSize, JournalRunIO ReadLog, JournalRunIO WriteLog, JournalSectorIO WriteHome, JournalBarrier Sync, void* Context)
+{
+	if (NumSectors < 4) return 0;													// Header plus room for one single sector transaction
+
+	Journal* NewJournal = (Journal*) calloc(1, sizeof(Journal));
+
+	// if memory allocation failed, return immediately
+	if (NewJournal == 0)
+	{
+		return 0;
+	}
+
+	NewJournal->StartSector = StartSector;
+	NewJournal->LogSectors 	= NumSectors - 1;
+	NewJournal->SectorSize 	= SectorSize;
+	NewJournal->Sequence 	= 1;
+
+	// A transaction has to fit both in the log and in its descriptor
+	NewJournal->MaxPending = (SectorSize - sizeof(JournalDescriptor)) / sizeof(uint32_t);
+	if (NewJournal->MaxPending > NewJournal->LogSectors - 2) NewJournal->MaxPending = NewJournal->LogSectors - 2;
+
+	// Every committed image takes up a log sector, so the log never holds more of them than it has sectors
+	NewJournal->MaxCheckpoint = NewJournal->LogSectors;
+
+	NewJournal->PendingHomes 		= (uint64_t*) malloc(sizeof(uint64_t) * NewJournal->MaxPending);
+	NewJournal->Transaction 		= (BYTE*) malloc((size_t) (NewJournal->MaxPending + 2) * SectorSize);
+	NewJournal->CheckpointHomes 	= (uint64_t*) malloc(sizeof(uint64_t) * NewJournal->MaxCheckpoint);
+	NewJournal->CheckpointImages 	= (BYTE*) malloc((size_t) NewJournal->MaxCheckpoint * SectorSize);
+	NewJournal->HeaderSector 		= (BYTE*) malloc(SectorSize);
+
+	// if memory allocation failed, clean up the created allocations and return
+	if (NewJournal->PendingHomes == 0 || NewJournal->Transaction == 0 || NewJournal->CheckpointHomes == 0 ||
+		NewJournal->CheckpointImages == 0 || NewJournal->HeaderSector == 0)
+	{
+		Journal_DeInit(NewJournal);
+		return 0;
+	}
+
+	NewJournal->ReadLog 	= ReadLog;
+	NewJournal->WriteLog 	= WriteLog;
+	NewJournal->WriteHome 	= WriteHome;
+	NewJournal->Sync 		= Sync;
+	NewJournal->Context 	= Context;
+
+	return NewJournal;
+}
+
+void Journal_FormatHeader(BYTE* HeaderSector)
+{
+	JournalHeader* Header = (JournalHeader*) HeaderSector;
+
+	Header->Magic 	 = JOURNAL_HEADER_MAGIC;
+	Header->Sequence = 1;
+}
+
+bool Journal_Replay(Journal* journal)
+{
+	if (journal->ReadLog(journal->Context, journal->HeaderSector, journal->StartSector, 1) == FALSE) return FALSE;
+
+	JournalHeader* Header = (JournalHeader*) journal->HeaderSector;
+
+	// Nothing we wrote, so there is nothing to replay. Start the journal over.
+	if (Header->Magic != JOURNAL_HEADER_MAGIC)
+	{
+		return _Journal_WriteHeader(journal);
+	}
+
+	uint32_t Sequence 	= Header->Sequence;
+	uint32_t Position 	= 0;
+	uint32_t SectorSize = journal->SectorSize;
+	uint64_t LogStart 	= journal->StartSector + 1;
+
+	JournalDescriptor* Descriptor = (JournalDescriptor*) journal->Transaction;
+
+	while (Position + 2 <= journal->LogSectors)
+	{
+		if (journal->ReadLog(journal->Context, journal->Transaction, LogStart + Position, 1) == FALSE) return FALSE;
+
+		uint32_t NumSectors = Descriptor->NumSectors;
+
+		if (Descriptor->Magic != JOURNAL_DESCRIPTOR_MAGIC || Descriptor->Sequence != Sequence) break;
+		if (NumSectors == 0 || NumSectors > journal->MaxPending || Position + NumSectors + 2 > journal->LogSectors) break;
+
+		// The images and the commit sector
+		if (journal->ReadLog(journal->Context, &journal->Transaction[SectorSize], LogStart + Position + 1, NumSectors + 1) == FALSE) return FALSE;
+
+		JournalCommit* Commit = (JournalCommit*) &journal->Transaction[(NumSectors + 1) * SectorSize];
+
+		if (Commit->Magic != JOURNAL_COMMIT_MAGIC || Commit->Sequence != Sequence || Commit->NumSectors != NumSectors) break;
+		if (Commit->Checksum != Checksum_CRC32C(journal->Transaction, (NumSectors + 1) * SectorSize)) break;	// Torn write
+
+		uint32_t SectorIterator = 0;
+		for (SectorIterator = 0; SectorIterator < NumSectors; SectorIterator++)
+		{
+			if (journal->WriteHome(journal->Context, &journal->Transaction[(SectorIterator + 1) * SectorSize], Descriptor->HomeSectors[SectorIterator]) == FALSE) return FALSE;
+		}
+
+		journal->Replayed++;
+		Sequence++;
+		Position += NumSectors + 2;
+	}
+
+	journal->Sequence 	= Sequence;
+	journal->Head 		= 0;
+
+	// Everything in the log is home now, so empty it
+	if (journal->Replayed > 0) return _Journal_WriteHeader(journal);
+
+	return TRUE;
+}
+
+// Logging a sector that is already part of the running transaction just replaces its image
+bool Journal_Log(Journal* journal, BYTE* Sector, uint64_t HomeSector)
+{
+	uint32_t Slot = 0;
+
+	while (Slot < journal->NumPending && journal->PendingHomes[Slot] != HomeSector) Slot++;
+
+	if (Slot == journal->NumPending)
+	{
+		// Too big for one transaction: commit what is there and start another one
+		if (journal->NumPending == journal->MaxPending)
+		{
+			if (Journal_Commit(journal) == FALSE) return FALSE;
+			Slot = 0;
+		}
+
+		journal->PendingHomes[Slot] = HomeSector;
+		journal->NumPending++;
+	}
+
+	memcpy(&journal->Transaction[(Slot + 1) * journal->SectorSize], Sector, journal->SectorSize);
+
+	return TRUE;
+}
+
+bool Journal_Commit(Journal* journal)
+{
+	uint32_t NumSectors = journal->NumPending;
+	uint32_t SectorSize = journal->SectorSize;
+
+	if (NumSectors == 0) return TRUE;
+
+	// Transactions never wrap, so make room at the start of the log if it is not there at the end
+	if (journal->Head + NumSectors + 2 > journal->LogSectors)
+	{
+		if (Journal_Checkpoint(journal) == FALSE) return FALSE;
+	}
+
+	JournalDescriptor* Descriptor = (JournalDescriptor*) journal->Transaction;
+	JournalCommit* Commit = (JournalCommit*) &journal->Transaction[(NumSectors + 1) * SectorSize];
+	uint32_t SectorIterator = 0;
+
+	memset(Descriptor, 0, SectorSize);
+	Descriptor->Magic 		= JOURNAL_DESCRIPTOR_MAGIC;
+	Descriptor->Sequence 	= journal->Sequence;
+	Descriptor->NumSectors 	= NumSectors;
+
+	for (SectorIterator = 0; SectorIterator < NumSectors; SectorIterator++)
+	{
+		Descriptor->HomeSectors[SectorIterator] = (uint32_t) journal->PendingHomes[SectorIterator];
+	}
+
+	memset(Commit, 0, SectorSize);
+	Commit->Magic 		= JOURNAL_COMMIT_MAGIC;
+	Commit->Sequence 	= journal->Sequence;
+	Commit->NumSectors 	= NumSectors;
+	Commit->Checksum 	= Checksum_CRC32C(journal->Transaction, (NumSectors + 1) * SectorSize);
+
+	// One sequential append for the whole transaction. The checksum lets replay tell a torn one apart.
+	if (journal->WriteLog(journal->Context, journal->Transaction, journal->StartSector + 1 + journal->Head, NumSectors + 2) == FALSE) return FALSE;
+	if (journal->Sync(journal->Context) == FALSE) return FALSE;
+
+	for (SectorIterator = 0; SectorIterator < NumSectors; SectorIterator++)
+	{
+		_Journal_AddToCheckpoint(journal, &journal->Transaction[(SectorIterator + 1) * SectorSize], journal->PendingHomes[SectorIterator]);
+	}
+
+	journal->Head 			+= NumSectors + 2;
+	journal->Sequence		++;
+	journal->NumPending 	= 0;
+	journal->Commits		++;
+	journal->SectorsLogged 	+= NumSectors;
+
+	return TRUE;
+}
+
+bool Journal_Checkpoint(Journal* journal)
+{
+	if (journal->Head == 0) return TRUE;											// The log is already empty
+
+	CheckpointSector* Sectors = (CheckpointSector*) malloc(sizeof(CheckpointSector) * (journal->NumCheckpoint + 1));
+	uint32_t SectorIterator = 0;
+
+	if (Sectors == 0) return FALSE;
+
+	for (SectorIterator = 0; SectorIterator < journal->NumCheckpoint; SectorIterator++)
+	{
+		Sectors[SectorIterator].HomeSector 	= journal->CheckpointHomes[SectorIterator];
+		Sectors[SectorIterator].Slot 		= SectorIterator;
+	}
+
+	// Writing home in sector order keeps the store accesses as sequential as possible
+	qsort(Sectors, journal->NumCheckpoint, sizeof(CheckpointSector), _Journal_CompareHomes);
+
+	for (SectorIterator = 0; SectorIterator < journal->NumCheckpoint; SectorIterator++)
+	{
+		BYTE* Image = &journal->CheckpointImages[(size_t) Sectors[SectorIterator].Slot * journal->SectorSize];
+
+		if (journal->WriteHome(journal->Context, Image, Sectors[SectorIterator].HomeSector) == FALSE)
+		{
+			free(Sectors);
+			return FALSE;
+		}
+	}
+
+	free(Sectors);
+
+	// Only once everything is home may the log be emptied
+	if (_Journal_WriteHeader(journal) == FALSE) return FALSE;
+
+	journal->Head 			= 0;
+	journal->NumCheckpoint 	= 0;
+	journal->Checkpoints	++;
+
+	return TRUE;
+}
+
+void Journal_DeInit(Journal* journal)
+{
+	free(journal->PendingHomes);
+	free(journal->Transaction);
+	free(journal->CheckpointHomes);
+	free(journal->CheckpointImages);
+	free(journal->HeaderSector);
+	free(journal);
+
+	journal = 0;
+}
+
+//***************************************** Private Functions ************************************//
+
+// The header names the sequence number the log starts at, which empties it of everything older. Whatever was written
+// home beforehand has to be durable first, or the log would be emptied of images the store does not have yet.
+bool _Journal_WriteHeader(Journal* journal)
+{
+	if (journal->Sync(journal->Context) == FALSE) return FALSE;
+
+	memset(journal->HeaderSector, 0, journal->SectorSize);
+	Journal_FormatHeader(journal->HeaderSector);
+
+	((JournalHeader*) journal->HeaderSector)->Sequence = journal->Sequence;
+
+	return journal->WriteLog(journal->Context, journal->HeaderSector, journal->StartSector, 1);
+}
+
+void _Journal_AddToCheckpoint(Journal* journal, BYTE* Sector, uint64_t HomeSector)
+{
+	uint32_t Slot = 0;
+
+	while (Slot < journal->NumCheckpoint && journal->CheckpointHomes[Slot] != HomeSector) Slot++;
+
+	if (Slot == journal->NumCheckpoint)
+	{
+		journal->CheckpointHomes[Slot] = HomeSector;
+		journal->NumCheckpoint++;
+	}
+
+	memcpy(&journal->CheckpointImages[(size_t) Slot * journal->SectorSize], Sector, journal->SectorSize);
+}
+
+int _Journal_CompareHomes(const void* first, const void* second)
+{
+	uint64_t FirstHome 	= ((const CheckpointSector*) first)->HomeSector;
+	uint64_t SecondHome = ((const CheckpointSector*) second)->HomeSector;
+
+	return (FirstHome > SecondHome) - (FirstHome < SecondHome);
+}
@@ -0,0 +1,72 @@
+/*
+ * Journal.h
+ *
+ *  Created on: Oct 18, 2026
+ */
+
+#ifndef OS_FILESYS_JOURNAL_JOURNAL_H_
+#define OS_FILESYS_JOURNAL_JOURNAL_H_
+#ifndef LAB3_VRTOS_EXTERNAL_LIBRARIES_VENKATWARE_VENKATLIB_H_
+#include "venkatlib.h"
+#endif
+
+// Write-ahead journal for metadata sectors.
+//
+// The region starts with a header sector, followed by the log. Every transaction is appended to the log as one
+// sequential run: a descriptor sector (which home sectors follow), the new images of those sectors and a commit
+// sector that checksums the lot. Once a transaction is in the log its images are only copied to their home
+// sectors at a checkpoint, which happens when the log runs out of room (or on request). A checkpoint rewrites
+// the header, emptying the log. The store's write barrier orders the steps: a transaction is only committed once
+// it is durable in the log, and the header is only rewritten once every image is durable at home.
+//
+// Replay walks the log from its start, applying every complete transaction whose sequence number follows on
+// from the header's; the first torn or stale one ends it.
+
+// Store accessors the journal uses. Log accesses are runs, home writes are single sectors. Context is handed through as is.
+typedef bool (*JournalRunIO)(void* Context, BYTE* Buffer, uint64_t FirstSector, uint32_t NumSectors);
+typedef bool (*JournalSectorIO)(void* Context, BYTE* Buffer, uint64_t SectorNum);
+typedef bool (*JournalBarrier)(void* Context);								// Everything written so far is durable once it returns TRUE
+
+typedef struct NNODE_Journal
+{
+	uint64_t		StartSector;		// Header sector; the log follows it
+	uint32_t		LogSectors;
+	uint32_t		SectorSize;
+
+	uint32_t		Sequence;			// Sequence number the next committed transaction gets
+	uint32_t		Head;				// Next free log sector, relative to the start of the log
+
+	// Running transaction, laid out as it goes into the log: descriptor, images, commit sector
+	uint32_t		MaxPending;
+	uint32_t		NumPending;
+	uint64_t*		PendingHomes;
+	BYTE*			Transaction;		// (MaxPending + 2) * SectorSize bytes
+
+	// Committed images still waiting for the checkpoint to write them home (at most one per home sector)
+	uint32_t		MaxCheckpoint;
+	uint32_t		NumCheckpoint;
+	uint64_t*		CheckpointHomes;
+	BYTE*			CheckpointImages;
+
+	BYTE*			HeaderSector;
+
+	JournalRunIO	ReadLog;
+	JournalRunIO	WriteLog;
+	JournalSectorIO	WriteHome;
+	JournalBarrier	Sync;
+	void*			Context;
+
+	uint64_t		Commits;
+	uint64_t		SectorsLogged;
+	uint64_t		Checkpoints;
+	uint64_t		Replayed;			// Transactions applied by Journal_Replay
+} Journal;
+
+Journal*	Journal_Init(uint64_t StartSector, uint32_t NumSectors, uint32_t SectorSize, JournalRunIO ReadLog, JournalRunIO WriteLog, JournalSectorIO WriteHome, JournalBarrier Sync, void* Context);
+void		Journal_FormatHeader(BYTE* HeaderSector);							// Lay down the header of an empty journal (used by the filesystem format)
+bool		Journal_Replay(Journal* journal);									// Bring the home sectors up to date with the log. Call once, before anything is logged.
+bool		Journal_Log(Journal* journal, BYTE* Sector, uint64_t HomeSector);	// Add a sector image to the running transaction
+bool		Journal_Commit(Journal* journal);									// Append the running transaction to the log
+bool		Journal_Checkpoint(Journal* journal);								// Write committed images home and empty the log
+void		Journal_DeInit(Journal* journal);
+#endif /* OS_FILESYS_JOURNAL_JOURNAL_H_ */
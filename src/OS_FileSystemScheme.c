@@ -4,859 +4,3798 @@
 #include <stdio.h>
 #include <unistd.h>
 #include <string.h>
+#include <pthread.h>
+#include <sys/types.h>
+#include <sys/mman.h>
 #include "venkatlib.h"
 #include "Bitmap.h"
+#include "SectorCache.h"
+#include "Directory.h"
+#include "Journal.h"
+#include "WorkQueue.h"
+#include "Compressor.h"
+#include "Checksum.h"
 #include "OS_FileSystemScheme.h"
 
-bool DiskInitialized =  FALSE;
-
-BitMap* DataBitMap;
-BitMap* InodeBitMap;
-
-struct nRTOS_SuperBlock FileSystemProperties;
-
-// Spoofed SD Card
-char SDCARD_SPOOF[] = "myfilesystem.store";
+// A block group while mounted. The free counts in the descriptor are kept current as blocks and inodes are claimed and
+// released (atomically, like the bitmaps themselves).
+typedef struct nRTOS_BlockGroup
+{
+	struct nRTOS_GroupDescriptor	Descriptor;
+	BitMap*							BlockBitMap;						// Read in the first time the group's blocks are needed (see _GroupBlockBitMap)
+	BitMap*							InodeBitMap;
+	bool							Dirty;								// Bitmaps or counts changed since they were last logged
+	uint32_t*						Checksums;							// Of every block of the group (see _ChecksumEntry)
+	uint32_t*						CommittedChecksums;					// The same entries as the journal last had them (see _OpenChecksums)
+	BitMap*							DirtyChecksums;						// One bit per checksum table block changed since it was last logged
+	BitMap*							OpenBlocks;							// Blocks of files with open handles, committed without a checksum (see _HoldFile)
+} BLOCK_GROUP;
+
+// The entries of a directory, as gathered by _ListDirectory
+typedef struct nRTOS_Listing
+{
+	DIRECTORY_ITEM*	Items;
+	uint32_t*		InodeNums;													// Of every item
+	uint32_t		NumItems;
+	uint32_t		MaxItems;
+} LISTING;
+
+// Everything one mounted store needs.
+//
+// Locking, outermost first:
+//	Lock				File operations hold it shared. Commit points, batches, format and unmount hold it exclusively,
+//						so they always see the metadata at rest.
+//	InodeLocks[n]		Shared to read file n, exclusive to change it (data, size or extents). At most one is held at a time.
+//	NamespaceLock		Guards every directory: Directories, and the DIRECTORY_ fields of the directories' inodes. Nothing
+//						else is ever waited for while it is held, apart from the store and the block bitmaps.
+//	BlockBitMapLock		Taken to read a group's block bitmap in, and held for nothing else.
+//	ChecksumLock		Taken by file writes to open checksum entries, and held across the journal commit that does it.
+// The group bitmaps need no lock: blocks and inodes are claimed with compare-and-swap on the bitmap words.
+struct nRTOS_Volume
+{
+	pthread_rwlock_t		Lock;
+	pthread_mutex_t			NamespaceLock;
+	pthread_mutex_t			MappingLock;										// Guards MappingDirtyLow/High
+	pthread_mutex_t			BlockBitMapLock;
+	pthread_mutex_t			ChecksumLock;										// Guards the journal outside of commit points (see _OpenChecksums)
+
+	char*					StorePath;											// Spoofed SD card
+	MOUNT_OPTIONS			Options;
+	bool					Mounted;											// The metadata below is resident
+
+	struct nRTOS_SuperBlock	Properties;										// Geometry and layout, read back at mount
+	uint32_t				InodesPerBlock;										// Inodes packed into each inode table block
+	uint32_t				TotalInodeBlocks;									// Inode table blocks over all groups
+
+	int						StoreDescriptor;									// Held open for the life of the mount (-1 if closed)
+	BYTE*					StoreMapping;										// Base of the mapped store (MOUNT_MAPPED only)
+	uint64_t				MappingBytes;										// Length of the mapping: every block of the volume
+	uint64_t				MappingDirtyLow;									// Lowest sector written through the mapping since the last commit
+	uint64_t				MappingDirtyHigh;									// Highest sector written through the mapping since the last commit
+
+	// Write-back cache sitting in front of the store (0 when disabled or not mounted)
+	SectorCache*			SectorBuffer;
+
+	// Every metadata sector (bitmaps, inodes) reaches the store through here while mounted
+	Journal*				MetadataJournal;
+	uint32_t				OpenBatches;										// OSFS_BeginBatch calls not yet matched by OSFS_CommitBatch (changed under the exclusive lock)
+
+	BLOCK_GROUP*			Groups;												// Properties.NumGroups of them
+	BitMap*					FullGroups;											// Bit n is set while group n has no free blocks
+	uint32_t				NextInodeGroup;										// Where the next create starts looking for an inode
+
+	// Resident copy of every inode, loaded at mount. Inode n lives at InodeTable[n].
+	INODE*					InodeTable;
+	pthread_rwlock_t*		InodeLocks;											// InodeLocks[n] guards InodeTable[n]
+	uint32_t*				OpenHandles;										// MYFILEs open on inode n (changed under InodeLocks[n])
+	BitMap*					DirtyInodeSectors;									// One bit per inode table block whose resident inodes changed
+
+	// Nodes of the files' extent trees and of the directories' entry trees. Read in as they are needed and logged with
+	// the rest of the metadata.
+	ExtentTree*				FileExtents;
+	DirectoryTree*			Directories;
+
+	// Asynchronous I/O. Submitted requests wait in IoRequests for the I/O threads; those without a callback then wait
+	// in IoCompletions to be handed back.
+	WorkQueue*				IoRequests;
+	WorkQueue*				IoCompletions;
+
+	FileError				RecentError;										// Set and read atomically
+};
 
 // Forward declarations
-bool 		_WriteToFile(BYTE* InputBuffer, uint64_t BlockNum);						// Write provided buffer to sector number
-bool 		_ReadFromFile(BYTE* OutputBuffer, uint64_t BlockNum);					// Read sector number to provided buffer
+bool 		_MountVolume(VOLUME* volume);											// Open the store (formatting it if needed) and make its metadata resident
+void 		_UnmountVolume(VOLUME* volume);										// Commit and release everything _MountVolume acquired
+bool 		_PlanVolume(GEOMETRY* Geometry, struct nRTOS_SuperBlock* Plan);		// Work out the layout of a volume (FALSE if the geometry cannot be laid out)
+void 		_FormatStore(VOLUME* volume, struct nRTOS_SuperBlock* Plan);			// Lay down an empty filesystem on the store
+bool 		_ReadSuperBlock(VOLUME* volume);										// Read the superblock into Properties, whatever the block size
+bool 		_OpenStore(VOLUME* volume);											// Open the spoofed SD card if it is not already open
+bool 		_MapStore(VOLUME* volume);												// Map every block of the volume (MOUNT_MAPPED only)
+void 		_CloseStore(VOLUME* volume);											// Close the spoofed SD card
+bool 		_CommitStore(VOLUME* volume);											// Push writes made through the mapping to the store (MOUNT_MAPPED only)
+bool 		_SyncStore(void* Context);												// Write barrier: everything written so far is made durable (JournalBarrier)
+bool 		_WriteToFile(void* Context, BYTE* InputBuffer, uint64_t BlockNum);		// Write provided buffer to sector number (SectorIO for the cache)
+bool 		_ReadFromFile(void* Context, BYTE* OutputBuffer, uint64_t BlockNum);	// Read sector number to provided buffer (SectorIO for the cache)
+bool 		_ReadRunFromFile(VOLUME* volume, BYTE* OutputBuffer, uint64_t BlockNum, uint32_t NumBlocks);	// Read consecutive sectors with a single access
+bool 		_WriteRunToFile(VOLUME* volume, BYTE* InputBuffer, uint64_t BlockNum, uint32_t NumBlocks);	// Write consecutive sectors with a single access
+bool 		_StoreRunToFile(VOLUME* volume, BYTE* InputBuffer, uint64_t BlockNum, uint32_t NumBlocks);	// Same, leaving their checksums alone
+bool 		_ReadJournalRun(void* Context, BYTE* OutputBuffer, uint64_t BlockNum, uint32_t NumBlocks);	// JournalRunIO for _ReadRunFromFile
+bool 		_WriteJournalRun(void* Context, BYTE* InputBuffer, uint64_t BlockNum, uint32_t NumBlocks);	// JournalRunIO for _WriteRunToFile
+bool 		_WriteSector(VOLUME* volume, BYTE* InputBuffer, uint64_t BlockNum);		// Same as _WriteToFile, but goes through the sector cache
+bool 		_ReadSector(VOLUME* volume, BYTE* OutputBuffer, uint64_t BlockNum);		// Same as _ReadFromFile, but goes through the sector cache
+bool 		_FlushSectorCache(VOLUME* volume);										// Write every dirty cached sector back to the store
+bool 		_WriteHomeSector(void* Context, BYTE* InputBuffer, uint64_t BlockNum);	// Where the journal checkpoints metadata to
+bool 		_CommitMetadata(VOLUME* volume);										// Log every dirty metadata sector and commit them as one transaction
+bool 		_EndOperation(VOLUME* volume);											// Commit point of a single operation (deferred while a batch is open)
+bool 		_CommitOperation(VOLUME* volume);										// _EndOperation for a file operation that has let go of the volume
+void 		_InitRWLock(pthread_rwlock_t* Lock);									// Writers go first, so commits are not held off by a steady stream of readers
+pthread_rwlock_t* _InodeLock(MYFILE* file);											// The lock guarding the file's inode
+void 		_SetError(VOLUME* volume, FileError Error);
+void 		_ServeIO(void* Context, void* Item);									// WorkHandler run by the I/O threads
+void 		_Readahead(VOLUME* volume, MYFILE* File, uint64_t Offset, uint32_t numBytes);	// Fetch the blocks a sequential reader wants next. Needs the file's inode lock.
+void 		_PrefetchRun(VOLUME* volume, uint64_t BlockNum, uint32_t NumBlocks);		// Get the sectors close at hand for the reads to come
+bool 		_ReadRun(VOLUME* volume, BYTE* OutputBuffer, uint64_t BlockNum, uint32_t NumBlocks);		// Run read around the sector cache, but coherent with it
+bool 		_WriteRun(VOLUME* volume, BYTE* InputBuffer, uint64_t BlockNum, uint32_t NumBlocks);		// Run write around the sector cache, but coherent with it
+
+// File operations behind the public calls of the same name. The caller holds the volume's lock shared, and
+// the file's inode lock for Read, Write and the cursor.
+MYFILE* 	_CreateFile(VOLUME* volume, char* path);
+MYFILE* 	_OpenFile(VOLUME* volume, char* path);
+int32_t 	_ReadFile(VOLUME* volume, MYFILE* fileDescriptor, BYTE* Buffer, uint32_t numBytes, uint64_t Offset);
+bool 		_WriteFile(VOLUME* volume, MYFILE* fileDescriptor, BYTE* Buffer, uint32_t numBytes, uint64_t Offset);
+int32_t 	_NextCursorChunk(VOLUME* volume, FILE_CURSOR* cursor, BYTE** Chunk);
+bool 		_DeleteFile(VOLUME* volume, char* path);
+bool 		_MakeDirectory(VOLUME* volume, char* path);
+bool 		_RemoveDirectory(VOLUME* volume, char* path);
+bool 		_ListDirectory(VOLUME* volume, char* path, LISTING* Listing);
+
+// Paths. Everything here needs NamespaceLock.
+int32_t 	_ResolveParent(VOLUME* volume, const char* path, char* LastName, FileError* Error);	// Directory holding the path's last name (-1 if there is none)
+int32_t 	_LookupPath(VOLUME* volume, const char* path, FileError* Error);		// Inode the path names (-1 if none)
+int32_t 	_FindEntry(VOLUME* volume, uint32_t Directory, const char* Name);		// Inode of the name in the directory (-1 if none)
+FileError 	_CheckNewPath(VOLUME* volume, const char* path);						// FILE_OK if the path could be created
+FileError 	_AddEntry(VOLUME* volume, const char* path, INODE* Child);				// Put the child under the path's last name
+int32_t 	_RemoveEntry(VOLUME* volume, const char* path, uint32_t FileType, FileError* Error);	// Take the path's last name out of its directory. Returns the inode it named (-1 if none).
+bool 		_GatherItem(void* Context, const char* Name, uint32_t InodeNum);		// DirectoryVisitor for _ListDirectory
+void 		_PrintItem(void* Context, DIRECTORY_ITEM* Item);						// DIRECTORY_VISITOR for SerialListFiles
+
+// Block groups
+bool 		_LoadBlockGroups(VOLUME* volume);										// Read the group descriptor table and every group's inode bitmap (FALSE if any of it is damaged)
+uint32_t 	_BitsPerBitMap(uint32_t BlockSize);										// Most blocks (or inodes) one block of bitmap can track
+void 		_FreeBlockGroups(VOLUME* volume);
+BLOCK_GROUP* _GroupOfBlock(VOLUME* volume, uint32_t BlockNum);						// 0 if out of range
+BLOCK_GROUP* _GroupOfInode(VOLUME* volume, uint32_t InodeNum);						// 0 if out of range
+void 		_NoteGroupChanged(BLOCK_GROUP* Group);									// The group has to be logged at the next commit
+BitMap* 	_GroupBlockBitMap(VOLUME* volume, BLOCK_GROUP* Group);					// The group's block bitmap, read in if it is not resident yet (0 and FILE_CORRUPTED if it cannot be)
+void 		_NoteFreeBlocks(VOLUME* volume, BLOCK_GROUP* Group, uint32_t OldFree, uint32_t NewFree);	// Keep FullGroups in line with the group's free count
+void 		_LogBlockGroups(VOLUME* volume);										// Log the bitmaps of every changed group, and the descriptor table with them
+
+// Checksums, as laid out in OS_FileSystemScheme.h. The tables are resident from mount to unmount.
+uint32_t 	_ChecksumsPerBlock(uint32_t BlockSize);									// Entries in one block of a checksum table
+uint32_t 	_ChecksumTableHome(VOLUME* volume, uint32_t GroupNum);					// First block of the group's checksum table
+bool 		_IsSelfChecked(VOLUME* volume, uint64_t BlockNum);						// Blocks without an entry: the superblock, the journal and the tables
+uint32_t* 	_ChecksumEntry(VOLUME* volume, uint64_t BlockNum);						// Entry of the block (0 if it has none, or its table is not resident)
+bool 		_LoadChecksums(VOLUME* volume, uint32_t GroupNum);						// Read the group's checksum table in (FALSE if a block of it does not check out)
+void 		_NoteChecksums(VOLUME* volume, BYTE* Buffer, uint64_t BlockNum, uint32_t NumBlocks);	// The blocks are about to be written with Buffer
+void 		_ForgetChecksums(VOLUME* volume, uint64_t BlockNum, uint32_t NumBlocks);	// The blocks were released: their entries go back to CHECKSUM_NONE
+bool 		_OpenChecksums(VOLUME* volume, uint64_t BlockNum, uint32_t NumBlocks);	// Commit CHECKSUM_NONE over the table blocks of file blocks about to be overwritten
+void 		_HoldChecksums(VOLUME* volume, uint64_t BlockNum, uint32_t NumBlocks, bool Hold);	// Commit the blocks without a checksum from now on, or with it again
+bool 		_HoldFile(MYFILE* File, bool Hold);										// A handle was opened or closed (TRUE if the file's blocks changed hands)
+void 		_HoldExtent(void* Context, Extent* Entry);								// ExtentVisitor for _HoldFile
+void 		_ReleaseExtent(void* Context, Extent* Entry);
+void 		_ReleaseOpenBlocks(VOLUME* volume);										// The files still open write no more
+bool 		_VerifyChecksums(VOLUME* volume, BYTE* Buffer, uint64_t BlockNum, uint32_t NumBlocks);	// FALSE (and FILE_CORRUPTED) if a block read does not match its entry
+bool 		_LogMetadata(VOLUME* volume, BYTE* Sector, uint32_t BlockNum);			// Journal_Log, along with the table block holding the sector's checksum
+void 		_LogChecksums(VOLUME* volume);											// Log the table blocks changed by data writes
+void 		_ChecksumsLogged(VOLUME* volume, uint32_t GroupNum, uint32_t TableBlock, BYTE* Sector);	// The table block was just logged as Sector
+void 		_SerializeTableBlock(VOLUME* volume, uint32_t GroupNum, uint32_t TableBlock, BYTE* Sector);	// As it is committed: open blocks go without a checksum
+void 		_SerializeChecksums(uint32_t* Checksums, BYTE* Sector, uint32_t BlockSize);	// One block of table, from its first entry
+uint32_t 	_SuperBlockChecksum(struct nRTOS_SuperBlock* SuperBlock);
+
 // Update provided BitMap struct with sector data from sector number
 bool 		_TranscribeBitMap(BYTE* blockToUse, BitMap* mapToUpdate, uint32_t NumBytes);
+void 		_SerializeBitMap(BitMap* mapToStore, BYTE* blockToUse, uint32_t NumBytes);	// Inverse of _TranscribeBitMap
 
 // Inode private declarations
-uint32_t 	_GetNextFreeInode();													// Retrieve the next free inode by checking the bitmap
-bool 		_CheckInodeOccupancy(uint32_t Inodenum);								// Check and see if the provided inode is full
-void 		_MarkInodeAsOccupied(uint32_t InodeNum);								// Mark the volatile inode as occupied
-void 		_MarkInodeAsFree(uint32_t InodeNum);									// Mark the volatile inode as free
-void 		_UpdateNonVolatileInodeCopy(uint32_t InodeNum, INODE* volatileCopy);	// Write the provided inode to the non-volatile memory
-int32_t 	_GetNextOccupiedInode(uint32_t StartLocation);							// Get the next occupied node from the provided node to get (-1 if none)
-void 		_ReadInodeFromNonVolatileMemory(uint32_t InodeNum, INODE* location);	// Update provided memory address by reading data from non-volatile memory for particular inode
-int32_t 	_GetInodeFromFileName(char* fileName);									// Returns the inode number of the inode that is associated with this filename (-1 if none).
+int32_t 	_ClaimFreeInode(VOLUME* volume);										// Retrieve the next free inode by checking the bitmap, and mark it as occupied (-1 if there is none)
+bool 		_CheckInodeOccupancy(VOLUME* volume, uint32_t Inodenum);				// Check and see if the provided inode is full
+void 		_MarkInodeAsOccupied(VOLUME* volume, uint32_t InodeNum);				// Mark the volatile inode as occupied
+void 		_MarkInodeAsFree(VOLUME* volume, uint32_t InodeNum);					// Mark the volatile inode as free
+void 		_MarkInodeAsDirty(VOLUME* volume, uint32_t InodeNum);					// The resident copy changed, its sector has to be written back
+INODE* 		_GetResidentInode(VOLUME* volume, uint32_t InodeNum);					// Returns the resident copy of the inode (0 if out of range)
+bool 		_LoadInodeTable(VOLUME* volume);										// Make the whole inode table resident with one sequential read per group (FALSE if it is damaged)
+uint32_t 	_InodeSectorHome(VOLUME* volume, uint32_t InodeSector);				// Where the InodeSector-th block of the inode table lives
+bool 		_LogInodeTable(VOLUME* volume);										// Log the sectors holding dirty inodes
 
 // Block private declarations
-uint32_t 	_GetNextFreeBlock();													// Returns the next avaliable block number (Starts at 0, iterates to the end). --> Panics!
-void 		_MarkBlockAsOccupied(uint32_t BlockNum);								// Marks and returns the provided block as being occupied in the volatile bitmap
-void 		_MarkBlockAsFree(uint32_t BlockNum);
-void 		_UpdateNonVolatileDataBlockCopy(uint32_t BlockNum, BYTE* volatileCopy); // Update the copy of the block in disk
+int32_t 	_GetNextFreeBlock(VOLUME* volume);										// Returns the next avaliable block number (Resumes after the last one handed out), -1 if the volume is full
+void 		_MarkBlockAsOccupied(VOLUME* volume, uint32_t BlockNum);				// Marks and returns the provided block as being occupied in the volatile bitmap
+void 		_MarkBlockAsFree(VOLUME* volume, uint32_t BlockNum);
+bool 		_ClaimBlocks(VOLUME* volume, uint32_t BlockNum, uint32_t NumBlocks);	// All or nothing; the run has to sit inside one group
+void 		_ReleaseBlocks(VOLUME* volume, uint32_t BlockNum, uint32_t NumBlocks);
+uint32_t 	_CountFreeBlocks(VOLUME* volume, uint32_t BlockNum, uint32_t MaxLength);	// Free blocks in a row from BlockNum, without leaving its group
+int32_t 	_FindFreeBlocks(VOLUME* volume, uint32_t GoalBlock, uint32_t NumBlocks, FileError* Error);	// A free run, as close after GoalBlock as possible (-1 if none, with FILE_NO_SPACE or FILE_CORRUPTED in Error)
+bool 		_IsInline(INODE* FileInode);											// The file's data lives in its inode (see INLINE_DATA_BYTES)
+bool 		_GrowFile(VOLUME* volume, INODE* FileInode, uint64_t BlocksNeeded);	// Make sure the file has BlocksNeeded blocks, moving inline data out to them
+bool 		_AllocateFileBlocks(VOLUME* volume, INODE* FileInode, uint32_t NumBlocks);	// Grow the file by NumBlocks, as few and as long runs as possible
+void 		_FreeFileBlocks(VOLUME* volume, INODE* FileInode);						// Release every block held by the file
+bool 		_MapFileBlock(VOLUME* volume, INODE* FileInode, uint32_t BlockIndex, uint32_t* BlockNum, uint32_t* RunLength);	// Block holding the BlockIndex-th block of the file (FALSE and FILE_CORRUPTED if the tree says otherwise)
+
+// Compressed files (see COMPRESSION_CLUSTER_BLOCKS). Need the file's inode lock, exclusive to write.
+bool 		_IsCompressed(INODE* FileInode);
+int32_t 	_ReadClusters(VOLUME* volume, INODE* FileInode, BYTE* Buffer, uint32_t numBytes, uint64_t Offset);	// _ReadFile of a compressed file
+bool 		_WriteClusters(VOLUME* volume, INODE* FileInode, BYTE* Buffer, uint32_t numBytes, uint64_t Offset);	// _WriteFile of a compressed file
+bool 		_LoadCluster(VOLUME* volume, INODE* FileInode, uint32_t ClusterNum, BYTE* Cluster, BYTE* Stored);	// The cluster's data (zeroes if it is not mapped, FALSE and FILE_CORRUPTED if it cannot be read). Stored is scratch space of the same size.
+bool 		_StoreCluster(VOLUME* volume, INODE* FileInode, uint32_t ClusterNum, BYTE* Cluster, BYTE* Stored);	// Compress and write the cluster, mapping it if it is new
+
+// Store accessors of the extent and directory trees (see ExtentTree.h and Directory.h)
+bool 		_ReadTreeNode(void* Context, BYTE* Buffer, uint32_t BlockNum);
+bool 		_LogTreeNode(void* Context, BYTE* Buffer, uint32_t BlockNum);			// Into the running journal transaction
+int64_t 	_AllocateTreeNode(void* Context, uint32_t GoalBlock);
+void 		_ReleaseTreeRun(void* Context, uint32_t FirstBlock, uint32_t NumBlocks);
+
+//***************************************** Public Functions ************************************//
+
+// Mounts the store at StorePath (formatting it first if it holds no filesystem). Returns 0 if the store cannot be opened.
+VOLUME* OSFS_Mount(const char* StorePath, MOUNT_OPTIONS* Options)
+{
+	VOLUME* volume = (VOLUME*) calloc(1, sizeof(VOLUME));
 
-// BitMap private declarations
-void 		_FlushBitMapToDisk();													// Writes the volatile copy of the bitmaps to non-volatile storage
+	if (volume == 0) return 0;
 
-// Used for temporary item movement
-INODE	    CurrentNode;															// Use this to interact with the inode storage
-BYTE 		tempBlock[SECTOR_SIZE];													// Use this to interact with any storage sector
+	volume->StorePath = strdup(StorePath);
 
-//***************************************** Public Functions ************************************//
+	if (volume->StorePath == 0 || pthread_mutex_init(&volume->NamespaceLock, 0) != 0)
+	{
+		free(volume->StorePath);
+		free(volume);
+		return 0;
+	}
+
+	_InitRWLock(&volume->Lock);
+	pthread_mutex_init(&volume->MappingLock, 0);
+	pthread_mutex_init(&volume->BlockBitMapLock, 0);
+	pthread_mutex_init(&volume->ChecksumLock, 0);
 
-// Precondition: Atomic (since called from OS_Init, no threads should have been launched yet).
-void OSFS_Init()
+	volume->Options 			= *Options;
+	volume->StoreDescriptor 	= -1;
+	volume->MappingDirtyLow 	= UINT64_MAX;
+	volume->RecentError 		= FILE_OK;
+
+	volume->IoCompletions 	= WorkQueue_Init(0, 0, 0);
+	volume->IoRequests 		= WorkQueue_Init(IO_WORKER_COUNT, _ServeIO, volume);
+
+	if (volume->IoRequests == 0 || volume->IoCompletions == 0 || _MountVolume(volume) == FALSE)
+	{
+		if (volume->IoRequests == 0 || volume->IoCompletions == 0) printf("Could not start the I/O threads\n");
+		else printf("Could not open %s\n", volume->StorePath);
+
+		WorkQueue_DeInit(volume->IoRequests);
+		WorkQueue_DeInit(volume->IoCompletions);
+		pthread_rwlock_destroy(&volume->Lock);
+		pthread_mutex_destroy(&volume->NamespaceLock);
+		pthread_mutex_destroy(&volume->MappingLock);
+		pthread_mutex_destroy(&volume->BlockBitMapLock);
+		pthread_mutex_destroy(&volume->ChecksumLock);
+		free(volume->StorePath);
+		free(volume);
+		return 0;
+	}
+
+	return volume;
+}
+
+// Commits everything and releases the volume. Nothing else may be using it (or any of its files) by now, but requests
+// still in flight are carried out first. Completed requests that were never collected are simply forgotten.
+void OSFS_Unmount(VOLUME* volume)
 {
+	WorkQueue_DeInit(volume->IoRequests);
+	WorkQueue_DeInit(volume->IoCompletions);
+
+	pthread_rwlock_wrlock(&volume->Lock);
+	_UnmountVolume(volume);
+	pthread_rwlock_unlock(&volume->Lock);
+
+	pthread_rwlock_destroy(&volume->Lock);
+	pthread_mutex_destroy(&volume->NamespaceLock);
+	pthread_mutex_destroy(&volume->MappingLock);
+	pthread_mutex_destroy(&volume->BlockBitMapLock);
+	pthread_mutex_destroy(&volume->ChecksumLock);
+	free(volume->StorePath);
+	free(volume);
+}
 
-	// Read the superblock into memory
-	memset(&tempBlock, 0, SECTOR_SIZE);
-	if (_ReadFromFile((BYTE*) &tempBlock, SUPER_BLOCK_SECTOR_NUM))
+// Writes everything buffered by the filesystem back to the store
+bool OSFS_Flush(VOLUME* volume)
+{
+	pthread_rwlock_wrlock(&volume->Lock);
+
+	bool Flushed = (volume->Mounted == FALSE) ? TRUE : _CommitMetadata(volume);
+
+	pthread_rwlock_unlock(&volume->Lock);
+
+	return Flushed;
+}
+
+void OSFS_BeginBatch(VOLUME* volume)
+{
+	pthread_rwlock_wrlock(&volume->Lock);
+	__atomic_add_fetch(&volume->OpenBatches, 1, __ATOMIC_RELEASE);
+	pthread_rwlock_unlock(&volume->Lock);
+}
+
+// Everything the batch changed goes into the journal as one transaction (several, if it does not fit in one)
+bool OSFS_CommitBatch(VOLUME* volume)
+{
+	bool Committed = FALSE;															// No batch to commit
+
+	pthread_rwlock_wrlock(&volume->Lock);
+
+	if (volume->OpenBatches > 0)
 	{
-		memcpy(&FileSystemProperties, &tempBlock, sizeof(struct nRTOS_SuperBlock));
+		__atomic_sub_fetch(&volume->OpenBatches, 1, __ATOMIC_RELEASE);
+		Committed = _EndOperation(volume);
 	}
-	else
+
+	pthread_rwlock_unlock(&volume->Lock);
+
+	return Committed;
+}
+
+void OSFS_GetCacheStats(VOLUME* volume, CACHE_STATS* Stats)
+{
+	memset(Stats, 0, sizeof(CACHE_STATS));
+
+	pthread_rwlock_wrlock(&volume->Lock);
+
+	if (volume->SectorBuffer != 0)
 	{
-		printf("File does not exist\n");
-		exit(-1);
+		Stats->CacheSectors = volume->SectorBuffer->NumEntries;
+		Stats->Hits 		= volume->SectorBuffer->Hits;
+		Stats->Misses 		= volume->SectorBuffer->Misses;
+		Stats->Evictions 	= volume->SectorBuffer->Evictions;
+		Stats->WriteBacks 	= volume->SectorBuffer->WriteBacks;
+		Stats->Prefetched 	= volume->SectorBuffer->Prefetched;
 	}
 
-	DiskInitialized = TRUE;
+	pthread_rwlock_unlock(&volume->Lock);
+}
 
-	// Transcribe the bitmaps into memory
-	DataBitMap = BitMap_Init(DATA_BITMAP_SIZE_IN_WORDS);
-	InodeBitMap = BitMap_Init(INODE_BITMAP_SIZE_IN_WORDS);
+// Erases the entire volume and mounts the empty filesystem in its place. Every file of the volume has to be closed first.
+// A geometry that cannot be laid out leaves the volume as it was.
+bool OSFS_Format(VOLUME* volume, GEOMETRY* Geometry)
+{
+	struct nRTOS_SuperBlock Plan;
+	GEOMETRY Current;
 
-	if (DataBitMap == 0 || InodeBitMap == 0) exit(-1);
+	pthread_rwlock_wrlock(&volume->Lock);
 
-	memset(&tempBlock, 0, SECTOR_SIZE);
-	if (_ReadFromFile((BYTE*) &tempBlock, INODE_BITMAP_SECTOR_NUM))
+	if (Geometry == 0)
 	{
-		_TranscribeBitMap((BYTE*)&tempBlock, InodeBitMap, sizeof(BitMap));
+		Current.BlockSize = volume->Properties.BlockSize;
+		Current.NumBlocks = volume->Properties.NumDataBlocks;
+		Current.NumInodes = volume->Properties.NumInodes;
+		Geometry = &Current;
 	}
-	else
+
+	if (_PlanVolume(Geometry, &Plan) == FALSE)
+	{
+		pthread_rwlock_unlock(&volume->Lock);
+		return FALSE;
+	}
+
+	_UnmountVolume(volume);
+	_FormatStore(volume, &Plan);
+
+	bool Mounted = _MountVolume(volume);
+
+	pthread_rwlock_unlock(&volume->Lock);
+
+	return Mounted;
+}
+
+void OSFS_GetGeometry(VOLUME* volume, GEOMETRY* Geometry)
+{
+	pthread_rwlock_rdlock(&volume->Lock);
+
+	Geometry->BlockSize = volume->Properties.BlockSize;
+	Geometry->NumBlocks = volume->Properties.NumDataBlocks;
+	Geometry->NumInodes = volume->Properties.NumInodes;
+
+	pthread_rwlock_unlock(&volume->Lock);
+}
+
+// The counts are kept up to date by every claim and release, so nothing is scanned
+void OSFS_StatFS(VOLUME* volume, STATFS* Stats)
+{
+	pthread_rwlock_rdlock(&volume->Lock);
+
+	Stats->BlockSize 	= volume->Properties.BlockSize;
+	Stats->NumBlocks 	= volume->Properties.NumDataBlocks;
+	Stats->FreeBlocks 	= __atomic_load_n(&volume->Properties.FreeBlocks, __ATOMIC_RELAXED);
+	Stats->NumInodes 	= volume->Properties.NumInodes;
+	Stats->FreeInodes 	= __atomic_load_n(&volume->Properties.FreeInodes, __ATOMIC_RELAXED);
+
+	pthread_rwlock_unlock(&volume->Lock);
+}
+
+FileError OSFS_GetError(VOLUME* volume)
+{
+	return __atomic_load_n(&volume->RecentError, __ATOMIC_RELAXED);
+}
+
+MYFILE* OSFS_Create(VOLUME* volume, char* path)
+{
+	pthread_rwlock_rdlock(&volume->Lock);
+
+	MYFILE* CreatedFile = _CreateFile(volume, path);
+
+	if (CreatedFile != 0) _HoldFile(CreatedFile, TRUE);
+
+	pthread_rwlock_unlock(&volume->Lock);
+
+	if (CreatedFile != 0) _CommitOperation(volume);
+
+	return CreatedFile;
+}
+
+MYFILE* OSFS_Open(VOLUME* volume, char* path)
+{
+	pthread_rwlock_rdlock(&volume->Lock);
+
+	MYFILE* OpenedFile = _OpenFile(volume, path);
+	bool 	Held 		= (OpenedFile != 0) ? _HoldFile(OpenedFile, TRUE) : FALSE;
+
+	pthread_rwlock_unlock(&volume->Lock);
+
+	// The checksums of the file's blocks are committed out of the way before it is written (see _HoldFile)
+	if (Held) _CommitOperation(volume);
+
+	return OpenedFile;
+}
+
+// 	Reads the specified amount of bytes from the file into the provided buffer. Offset allows specification of where in file to read from.
+//	Any number of threads can read the same file at once.
+// 	Parameters:
+//		fileDescriptor: 	FILE structure pointer provided by OSFS_Create
+//		Buffer:			Buffer to write the file data to
+//		numBytes:		Number of bytes to read from the file and into the buffer
+//		Offset:			Byte number in file to read from
+int32_t OSFS_Read(MYFILE* fileDescriptor, BYTE* Buffer, uint32_t numBytes, uint64_t Offset)
+{
+	if (fileDescriptor == 0 || Buffer==0 || numBytes==0) return FALSE;			// Invalid/useless parameters
+
+	VOLUME* volume = fileDescriptor->Volume;
+	pthread_rwlock_t* InodeLock = _InodeLock(fileDescriptor);
+
+	pthread_rwlock_rdlock(&volume->Lock);
+	pthread_rwlock_rdlock(InodeLock);
+
+	INODE* FileInode = fileDescriptor->FileInode;
+	bool   Grows 	 = (_IsInline(FileInode) == TRUE) ? (bool) (Offset + numBytes > INLINE_DATA_BYTES) :
+						(bool) ((Offset + numBytes + volume->Properties.BlockSize - 1) / volume->Properties.BlockSize > FileInode->FILE_BYTES / volume->Properties.BlockSize);
+
+	// Reading past the blocks allocated grows the file, which readers are not allowed to do. Clusters that are not
+	// there yet just read as zeroes, so a compressed file never grows on a read.
+	if (Grows && _IsCompressed(FileInode) == FALSE)
 	{
-        exit(-1);
+		pthread_rwlock_unlock(InodeLock);
+		pthread_rwlock_wrlock(InodeLock);
 	}
 
-	memset(&tempBlock, 0, SECTOR_SIZE);
-	if (_ReadFromFile((BYTE*) &tempBlock, DATA_BITMAP_SECTOR_NUM))
+	int32_t Read = _ReadFile(volume, fileDescriptor, Buffer, numBytes, Offset);
+
+	if (Read == TRUE) _Readahead(volume, fileDescriptor, Offset, numBytes);
+
+	pthread_rwlock_unlock(InodeLock);
+	pthread_rwlock_unlock(&volume->Lock);
+
+	return Read;
+}
+
+// 	Writes the specified amount of bytes from buffer into the provided file. Offset allows specification of where in file to start write from.
+//	Writes to different files run in parallel; a write has its file to itself.
+// 	Parameters:
+//		fileDescriptor: 	FILE structure pointer provided by OSFS_Create
+//		Buffer:			Buffer to write the file data to
+//		numBytes:		Number of bytes to read from the file and into the buffer
+//		Offset:			Byte number in file to read from
+bool OSFS_Write(MYFILE* fileDescriptor, BYTE* Buffer, uint32_t numBytes, uint64_t Offset)
+{
+	if (fileDescriptor == 0 || Buffer==0 || numBytes==0) return FALSE;			// Invalid/useless parameters
+
+	VOLUME* volume = fileDescriptor->Volume;
+	pthread_rwlock_t* InodeLock = _InodeLock(fileDescriptor);
+
+	pthread_rwlock_rdlock(&volume->Lock);
+	pthread_rwlock_wrlock(InodeLock);
+
+	bool Written = _WriteFile(volume, fileDescriptor, Buffer, numBytes, Offset);
+
+	pthread_rwlock_unlock(InodeLock);
+	pthread_rwlock_unlock(&volume->Lock);
+
+	return Written;
+}
+
+// 	Queues a read or write of the request's file, to be carried out by one of the volume's I/O threads.
+// 	Once it is done, Result holds what OSFS_Read or OSFS_Write returned and the request either goes to its
+//	callback or waits for OSFS_PollIO/OSFS_WaitIO.
+bool OSFS_SubmitIO(IO_REQUEST* Request)
+{
+	if (Request == 0 || Request->File == 0) return FALSE;							// Invalid/useless parameters
+	if (Request->Operation != IO_READ && Request->Operation != IO_WRITE) return FALSE;
+
+	VOLUME* volume = Request->File->Volume;
+
+	// Announced before it can possibly complete, so OSFS_WaitIO never gives up on it early
+	if (Request->Callback == 0) WorkQueue_Expect(volume->IoCompletions);
+
+	if (WorkQueue_Push(volume->IoRequests, Request) == FALSE)
 	{
-		_TranscribeBitMap((BYTE*)&tempBlock, DataBitMap, sizeof(BitMap));
+		if (Request->Callback == 0) WorkQueue_GiveUp(volume->IoCompletions);
+		return FALSE;
 	}
-	else
+
+	return TRUE;
+}
+
+IO_REQUEST* OSFS_PollIO(VOLUME* volume)
+{
+	return (IO_REQUEST*) WorkQueue_Pop(volume->IoCompletions, FALSE);
+}
+
+IO_REQUEST* OSFS_WaitIO(VOLUME* volume)
+{
+	// Two waiters never count on the same request: whether to wait is decided under the queue's lock
+	return (IO_REQUEST*) WorkQueue_PopExpected(volume->IoCompletions);
+}
+
+bool OSFS_Append(MYFILE* fileDescriptor, BYTE* buffer, uint32_t numBytes)
+{
+	if (fileDescriptor == 0 || buffer==0 || numBytes==0) return FALSE;			// Invalid/useless parameters
+
+	VOLUME* volume = fileDescriptor->Volume;
+	pthread_rwlock_t* InodeLock = _InodeLock(fileDescriptor);
+
+	pthread_rwlock_rdlock(&volume->Lock);
+	pthread_rwlock_wrlock(InodeLock);
+
+	bool Written = _WriteFile(volume, fileDescriptor, buffer, numBytes, fileDescriptor->FileInode->LATEST_CURSOR);
+
+	pthread_rwlock_unlock(InodeLock);
+	pthread_rwlock_unlock(&volume->Lock);
+
+	return Written;
+}
+
+FILE_CURSOR* OSFS_OpenCursor(MYFILE* fileToStream)
+{
+	if (fileToStream == 0 || fileToStream->FileInode == 0) return 0;
+
+	FILE_CURSOR* NewCursor = (FILE_CURSOR*) malloc(sizeof(FILE_CURSOR) * 1);
+	BYTE* 		 Chunk 	   = (BYTE*) malloc(CURSOR_CHUNK_SECTORS * fileToStream->Volume->Properties.BlockSize);
+
+	if (NewCursor == 0 || Chunk == 0)
+	{
+		free(NewCursor);
+		free(Chunk);
+		_SetError(fileToStream->Volume, FILE_INIT_FAILED);
+		return 0;
+	}
+
+	NewCursor->Chunk 	= Chunk;
+	NewCursor->File 	= fileToStream;
+	NewCursor->Position = 0;
+
+	return NewCursor;
+}
+
+// Hands back the next piece of the file: the rest of the current run, capped at CURSOR_CHUNK_SECTORS sectors.
+// With a mapped store (and no cache to be coherent with) the chunk points straight into the mapping, so nothing is copied.
+// The chunk stays valid until the next call.
+int32_t OSFS_CursorNext(FILE_CURSOR* cursor, BYTE** Chunk)
+{
+	VOLUME* volume = cursor->File->Volume;
+	pthread_rwlock_t* InodeLock = _InodeLock(cursor->File);
+
+	pthread_rwlock_rdlock(&volume->Lock);
+	pthread_rwlock_rdlock(InodeLock);
+
+	int32_t ChunkBytes = _NextCursorChunk(volume, cursor, Chunk);
+
+	pthread_rwlock_unlock(InodeLock);
+	pthread_rwlock_unlock(&volume->Lock);
+
+	return ChunkBytes;
+}
+
+void OSFS_CloseCursor(FILE_CURSOR* cursor)
+{
+	free(cursor->Chunk);
+	free(cursor);
+}
+
+bool OSFS_Close(MYFILE* fileToClose)
+{
+	VOLUME* volume = fileToClose->Volume;
+
+	pthread_rwlock_rdlock(&volume->Lock);
+
+	// Write the inode to non-volatile memory, along with the checksums of its blocks
+	_MarkInodeAsDirty(volume, fileToClose->FileInode->INODE_NUM);
+	_HoldFile(fileToClose, FALSE);
+
+	pthread_rwlock_unlock(&volume->Lock);
+
+	_CommitOperation(volume);
+
+	free(fileToClose);
+
+	fileToClose = 0;
+
+	// Write the associated data blocks to non-volatile memory
+	// TODO: Write the data blocks back to non-volatile memory
+	return TRUE;
+}
+
+bool OSFS_Delete(VOLUME* volume, char* path)
+{
+	pthread_rwlock_rdlock(&volume->Lock);
+
+	bool Deleted = _DeleteFile(volume, path);
+
+	pthread_rwlock_unlock(&volume->Lock);
+
+	if (Deleted) _CommitOperation(volume);
+
+	return Deleted;
+}
+
+bool OSFS_MakeDirectory(VOLUME* volume, char* path)
+{
+	pthread_rwlock_rdlock(&volume->Lock);
+
+	bool Made = _MakeDirectory(volume, path);
+
+	pthread_rwlock_unlock(&volume->Lock);
+
+	if (Made) _CommitOperation(volume);
+
+	return Made;
+}
+
+bool OSFS_RemoveDirectory(VOLUME* volume, char* path)
+{
+	pthread_rwlock_rdlock(&volume->Lock);
+
+	bool Removed = _RemoveDirectory(volume, path);
+
+	pthread_rwlock_unlock(&volume->Lock);
+
+	if (Removed) _CommitOperation(volume);
+
+	return Removed;
+}
+
+bool OSFS_IsDirectory(VOLUME* volume, char* path)
+{
+	FileError Error = FILE_OK;
+
+	pthread_rwlock_rdlock(&volume->Lock);
+	pthread_mutex_lock(&volume->NamespaceLock);
+
+	int32_t Found 		= _LookupPath(volume, path, &Error);
+	bool	IsDirectory = (bool) (Found >= 0 && volume->InodeTable[Found].FILE_TYPE == INODE_TYPE_DIRECTORY);
+
+	pthread_mutex_unlock(&volume->NamespaceLock);
+	pthread_rwlock_unlock(&volume->Lock);
+
+	return IsDirectory;
+}
+
+//	Hands every entry of the directory to Visit. The whole listing is taken first, so Visit runs without any of the
+//	volume's locks held and can use the volume as it pleases.
+bool OSFS_ListDirectory(VOLUME* volume, char* path, DIRECTORY_VISITOR Visit, void* Context)
+{
+	if (Visit == 0) return FALSE;
+
+	LISTING Listing = {0, 0, 0, 0};
+
+	pthread_rwlock_rdlock(&volume->Lock);
+
+	bool Listed = _ListDirectory(volume, path, &Listing);
+
+	pthread_rwlock_unlock(&volume->Lock);
+
+	uint32_t ItemIterator = 0;
+
+	for (ItemIterator = 0; Listed && ItemIterator < Listing.NumItems; ItemIterator++)
+	{
+		Visit(Context, &Listing.Items[ItemIterator]);
+	}
+
+	free(Listing.Items);
+	free(Listing.InodeNums);
+
+	return Listed;
+}
+
+uint64_t GetFileSize(MYFILE* fileToEval)
+{
+	pthread_rwlock_t* InodeLock = _InodeLock(fileToEval);
+
+	pthread_rwlock_rdlock(&fileToEval->Volume->Lock);
+	pthread_rwlock_rdlock(InodeLock);
+
+	uint64_t FileSize = fileToEval->FileInode->BYTES_USED; // Latest byte written to
+
+	pthread_rwlock_unlock(InodeLock);
+	pthread_rwlock_unlock(&fileToEval->Volume->Lock);
+
+	return FileSize;
+}
+//***************************************** Private Functions ************************************//
+
+// Volume lifetime
+
+bool _MountVolume(VOLUME* volume)
+{
+	if (_OpenStore(volume) == FALSE) return FALSE;
+
+	// Read the superblock into memory
+	if (_ReadSuperBlock(volume) == FALSE)
 	{
+		printf("File does not exist\n");
 		exit(-1);
 	}
 
+	struct nRTOS_SuperBlock Blank;
+
+	memset(&Blank, 0, sizeof(Blank));
+
+	bool Empty 		= (bool) (memcmp(&volume->Properties, &Blank, sizeof(Blank)) == 0);
+	bool Current 	= (bool) (volume->Properties.Magic == SILK_MAGIC && volume->Properties.Version == SILK_VERSION);
+
+	// Whatever a store holds is only formatted over when asked to, as it may well be someone's data
+	if (volume->Options.Format == FALSE)
+	{
+		// A superblock of this very layout that fails its checksum is damaged rather than foreign
+		if (Current == TRUE && volume->Properties.Checksum != _SuperBlockChecksum(&volume->Properties))
+		{
+			printf("%s has a damaged superblock\n", volume->StorePath);
+			_CloseStore(volume);
+			return FALSE;
+		}
+
+		// Another layout revision, or not a Silk store at all
+		if (Current == FALSE && Empty == FALSE)
+		{
+			printf("%s does not hold a filesystem of this version, it has to be formatted first\n", volume->StorePath);
+			_CloseStore(volume);
+			return FALSE;
+		}
+	}
+
+	// A brand new (empty) store has no filesystem on it yet, so lay one down first
+	if (volume->Options.Format == TRUE || Empty == TRUE)
+	{
+		GEOMETRY DefaultGeometry = {DEFAULT_BLOCK_SIZE, DEFAULT_BLOCK_COUNT, DEFAULT_INODE_COUNT};
+		struct nRTOS_SuperBlock Plan;
+
+		_PlanVolume(&DefaultGeometry, &Plan);
+		_FormatStore(volume, &Plan);
+
+		// Only done once: OSFS_Format mounts again with a geometry of its own
+		volume->Options.Format = FALSE;
+
+		if (_ReadSuperBlock(volume) == FALSE) exit(-1);
+	}
+
+	// Everything from here on is sized by the superblock
+	volume->InodesPerBlock 		= volume->Properties.BlockSize / sizeof(INODE);
+	volume->TotalInodeBlocks 	= volume->Properties.NumGroups * volume->Properties.InodeBlocksPerGroup;
+
+	if (volume->Options.Mode == MOUNT_MAPPED && _MapStore(volume) == FALSE)
+	{
+		_CloseStore(volume);
+		return FALSE;
+	}
+
+	// The mapping is already memory, so only the system call path gets a cache in front of it
+	if (volume->Options.Mode != MOUNT_MAPPED && volume->Options.CacheSectors > 0)
+	{
+		volume->SectorBuffer = SectorCache_Init(volume->Options.CacheSectors, volume->Properties.BlockSize, _ReadFromFile, _WriteToFile, volume);
+
+		if (volume->SectorBuffer == 0) exit(-1);
+	}
+
+	volume->Mounted = TRUE;
+
+	// Bring the metadata up to date with everything committed before the store was last closed
+	volume->MetadataJournal = Journal_Init(volume->Properties.JournalStartBlock, volume->Properties.JournalBlocks, volume->Properties.BlockSize, _ReadJournalRun, _WriteJournalRun, _WriteHomeSector, _SyncStore, volume);
+
+	if (volume->MetadataJournal == 0 || Journal_Replay(volume->MetadataJournal) == FALSE) exit(-1);
+
+	if (volume->MetadataJournal->Replayed > 0)
+	{
+		printf("Replayed %llu journal transactions\n", (unsigned long long) volume->MetadataJournal->Replayed);
+
+		// The free counts may have been among what was replayed
+		if (_ReadSuperBlock(volume) == FALSE || volume->Properties.Checksum != _SuperBlockChecksum(&volume->Properties)) exit(-1);
+	}
+
+	// Transcribe the group descriptors and bitmaps into memory
+	bool Loaded = _LoadBlockGroups(volume);
+
+	volume->FileExtents = ExtentTree_Init(volume->Properties.BlockSize, _ReadTreeNode, _AllocateTreeNode, _ReleaseTreeRun, volume);
+
+	volume->Directories = DirectoryTree_Init(volume->Properties.BlockSize, _ReadTreeNode, _AllocateTreeNode, _ReleaseTreeRun, volume);
+
+	if (volume->FileExtents == 0 || volume->Directories == 0) exit(-1);
+
+	if (Loaded == TRUE) Loaded = _LoadInodeTable(volume);
+
+	// Every path starts at the root directory. Nothing has changed yet, so a damaged volume is let go without a commit.
+	if (Loaded == FALSE || volume->InodeTable[ROOT_DIRECTORY_INODE].FILE_TYPE != INODE_TYPE_DIRECTORY)
+	{
+		printf("%s has damaged metadata\n", volume->StorePath);
+
+		volume->Mounted = FALSE;
+		_UnmountVolume(volume);
+		return FALSE;
+	}
+
+	return TRUE;
+}
+
+// The superblock sits at the very start of the store and fits in the smallest block there is, so it can be read
+// before the block size is known. A store too short to hold one reads back as zeroes.
+bool _ReadSuperBlock(VOLUME* volume)
+{
+	BYTE 	 Sector[MIN_BLOCK_SIZE];
+	uint32_t BytesRead = 0;
+
+	memset(Sector, 0, MIN_BLOCK_SIZE);
+
+	while (BytesRead < MIN_BLOCK_SIZE)
+	{
+		ssize_t Result = pread(volume->StoreDescriptor, &Sector[BytesRead], MIN_BLOCK_SIZE - BytesRead, (off_t) BytesRead);
+		if (Result < 0) return FALSE;
+		if (Result == 0) break;
+		BytesRead += Result;
+	}
+
+	memcpy(&volume->Properties, Sector, sizeof(struct nRTOS_SuperBlock));
+
+	// Nothing else can be trusted about a superblock with an impossible block size
+	uint32_t BlockSize = volume->Properties.BlockSize;
+
+	if (BlockSize < MIN_BLOCK_SIZE || BlockSize > MAX_BLOCK_SIZE || (BlockSize & (BlockSize - 1)) != 0) volume->Properties.Magic = 0;
+
+	return TRUE;
+}
+// Releases everything acquired by _MountVolume. The store can be formatted or mounted again afterwards.
+void _UnmountVolume(VOLUME* volume)
+{
+	if (volume->Mounted == TRUE)
+	{
+		_ReleaseOpenBlocks(volume);
+		_CommitMetadata(volume);
+	}
+
+	// A clean store has an empty journal, so the next mount has nothing to replay
+	if (volume->MetadataJournal != 0)
+	{
+		Journal_Checkpoint(volume->MetadataJournal);
+		Journal_DeInit(volume->MetadataJournal);
+		volume->MetadataJournal = 0;
+	}
+
+	if (volume->FileExtents != 0)
+	{
+		ExtentTree_DeInit(volume->FileExtents);
+		volume->FileExtents = 0;
+	}
+
+	if (volume->Directories != 0)
+	{
+		DirectoryTree_DeInit(volume->Directories);
+		volume->Directories = 0;
+	}
+
+	if (volume->InodeTable != 0)
+	{
+		uint32_t InodeIterator = 0;
+
+		for (InodeIterator = 0; InodeIterator < volume->Properties.NumInodes; InodeIterator++)
+		{
+			pthread_rwlock_destroy(&volume->InodeLocks[InodeIterator]);
+		}
+
+		free(volume->InodeTable);
+		free(volume->InodeLocks);
+		free(volume->OpenHandles);
+		BitMap_DeInit(volume->DirtyInodeSectors);
+
+		volume->InodeTable = 0;
+		volume->InodeLocks = 0;
+		volume->OpenHandles = 0;
+		volume->DirtyInodeSectors = 0;
+	}
+
+	if (volume->SectorBuffer != 0)
+	{
+		SectorCache_DeInit(volume->SectorBuffer);
+		volume->SectorBuffer = 0;
+	}
+
+	_FreeBlockGroups(volume);
+
+	_CloseStore(volume);
+
+	volume->Mounted 	= FALSE;
+	volume->OpenBatches = 0;
+}
+
+// Groups are as large as one block of bitmap allows, but there are at least MIN_BLOCK_GROUPS of them (when the volume is
+// large enough). Every group has to have room for its metadata and at least one block of data.
+bool _PlanVolume(GEOMETRY* Geometry, struct nRTOS_SuperBlock* Plan)
+{
+	uint32_t BlockSize = Geometry->BlockSize;
+
+	if (BlockSize < MIN_BLOCK_SIZE || BlockSize > MAX_BLOCK_SIZE || (BlockSize & (BlockSize - 1)) != 0) return FALSE;
+	if (Geometry->NumBlocks == 0 || Geometry->NumInodes == 0) return FALSE;
+
+	uint32_t BitsPerBitMap 	= _BitsPerBitMap(BlockSize);
+	uint32_t InodesPerBlock = BlockSize / sizeof(INODE);
+	uint32_t MaxInodeBits 	= BitsPerBitMap - (BitsPerBitMap % InodesPerBlock);		// Inodes per group are whole inode table blocks
+	uint32_t NumGroups 		= MIN_BLOCK_GROUPS;
+
+	if ((Geometry->NumBlocks + BitsPerBitMap - 1) / BitsPerBitMap > NumGroups) NumGroups = (Geometry->NumBlocks + BitsPerBitMap - 1) / BitsPerBitMap;
+	if ((Geometry->NumInodes + MaxInodeBits - 1) / MaxInodeBits > NumGroups) NumGroups = (Geometry->NumInodes + MaxInodeBits - 1) / MaxInodeBits;
+
+	memset(Plan, 0, sizeof(struct nRTOS_SuperBlock));
+
+	Plan->BlockSize 		= BlockSize;
+	Plan->NumDataBlocks 	= Geometry->NumBlocks;
+	Plan->BlocksPerGroup 	= (Geometry->NumBlocks + NumGroups - 1) / NumGroups;
+	Plan->NumGroups 		= (Geometry->NumBlocks + Plan->BlocksPerGroup - 1) / Plan->BlocksPerGroup;	// Rounding may leave fewer
+
+	uint32_t InodeBlocks 	= (((Geometry->NumInodes + Plan->NumGroups - 1) / Plan->NumGroups) + InodesPerBlock - 1) / InodesPerBlock;
+
+	Plan->InodeBlocksPerGroup 	= InodeBlocks;
+	Plan->InodesPerGroup 		= InodeBlocks * InodesPerBlock;
+	Plan->NumInodes 			= Plan->NumGroups * Plan->InodesPerGroup;
+
+	if (Plan->InodesPerGroup > BitsPerBitMap) return FALSE;
+
+	Plan->Magic 			= SILK_MAGIC;
+	Plan->Version 			= SILK_VERSION;
+	Plan->GroupTableBlock 	= GROUP_TABLE_SECTOR_NUM;
+	Plan->GroupTableBlocks 	= (Plan->NumGroups + (BlockSize / sizeof(struct nRTOS_GroupDescriptor)) - 1) / (BlockSize / sizeof(struct nRTOS_GroupDescriptor));
+	Plan->JournalStartBlock = Plan->GroupTableBlock + Plan->GroupTableBlocks;
+	Plan->JournalBlocks 	= JOURNAL_BLOCKS;
+
+	// Group 0's bitmaps follow the journal, and every group's checksum table its inode table
+	uint32_t ChecksumBlocks = (Plan->BlocksPerGroup + _ChecksumsPerBlock(BlockSize) - 1) / _ChecksumsPerBlock(BlockSize);
+
+	Plan->InodeStartBlock 		= Plan->JournalStartBlock + Plan->JournalBlocks + 2;
+	Plan->ChecksumStartBlock 	= Plan->InodeStartBlock + InodeBlocks;
+	Plan->ChecksumBlocksPerGroup = ChecksumBlocks;
+
+	uint32_t FirstGroupBlocks 	= (Plan->NumGroups == 1) ? Geometry->NumBlocks : Plan->BlocksPerGroup;
+	uint32_t LastGroupBlocks 	= Geometry->NumBlocks - ((Plan->NumGroups - 1) * Plan->BlocksPerGroup);
+
+	if (Plan->ChecksumStartBlock + ChecksumBlocks + 1 >= FirstGroupBlocks) return FALSE;	// Group 0 also holds the root directory's tree
+	if (Plan->NumGroups > 1 && 2 + InodeBlocks + ChecksumBlocks >= LastGroupBlocks) return FALSE;
+
+	return TRUE;
+}
+
+// Precondition: the volume is not mounted (its metadata is not resident), though the store may be open. Plan comes from _PlanVolume.
+void _FormatStore(VOLUME* volume, struct nRTOS_SuperBlock* Plan)
+{
+	uint32_t BlockSize 		= Plan->BlockSize;
+	uint32_t NumGroups 		= Plan->NumGroups;
+	uint32_t InodeBlocks 	= Plan->InodeBlocksPerGroup;
+	uint32_t ChecksumBlocks = Plan->ChecksumBlocksPerGroup;
+	uint32_t InodesPerBlock = BlockSize / sizeof(INODE);
+	uint32_t PerTableBlock 	= BlockSize / sizeof(struct nRTOS_GroupDescriptor);
+	uint32_t PerChecksumBlock = _ChecksumsPerBlock(BlockSize);
+
+	if (_OpenStore(volume) == FALSE) exit(-1);
+
+	struct nRTOS_GroupDescriptor* Descriptors = (struct nRTOS_GroupDescriptor*) calloc(NumGroups, sizeof(struct nRTOS_GroupDescriptor));
+	uint32_t GroupIterator = 0;
+
+	if (Descriptors == 0) exit(-1);
+
+	Plan->FreeBlocks = 0;
+	Plan->FreeInodes = 0;
+
+	for (GroupIterator = 0; GroupIterator < NumGroups; GroupIterator++)
+	{
+		struct nRTOS_GroupDescriptor* Descriptor = &Descriptors[GroupIterator];
+
+		Descriptor->FirstBlock 	= GroupIterator * Plan->BlocksPerGroup;
+		Descriptor->NumBlocks 	= (Plan->NumDataBlocks - Descriptor->FirstBlock < Plan->BlocksPerGroup) ? Plan->NumDataBlocks - Descriptor->FirstBlock : Plan->BlocksPerGroup;
+		Descriptor->FirstInode 	= GroupIterator * Plan->InodesPerGroup;
+		Descriptor->NumInodes 	= Plan->InodesPerGroup;
+
+		Descriptor->BlockBitMapBlock = (GroupIterator == 0) ? Plan->InodeStartBlock - 2 : Descriptor->FirstBlock;
+		Descriptor->InodeBitMapBlock = Descriptor->BlockBitMapBlock + 1;
+		Descriptor->InodeTableBlock  = Descriptor->BlockBitMapBlock + 2;
+
+		Descriptor->FreeBlocks 	= Descriptor->NumBlocks - (Descriptor->InodeTableBlock + InodeBlocks + ChecksumBlocks - Descriptor->FirstBlock);
+		Descriptor->FreeInodes 	= Descriptor->NumInodes;
+
+		// Group 0 starts out with the root directory: its inode, and the root of its tree right after the checksum table
+		if (GroupIterator == 0)
+		{
+			Descriptor->FreeBlocks--;
+			Descriptor->FreeInodes--;
+		}
+
+		Plan->FreeBlocks += Descriptor->FreeBlocks;
+		Plan->FreeInodes += Descriptor->FreeInodes;
+	}
+
+	// The store is written with this geometry from here on
+	Plan->Checksum 		= _SuperBlockChecksum(Plan);
+	volume->Properties 	= *Plan;
+
+	// Each group's metadata is laid out in one image and written with a single run. Group 0's run starts at the superblock
+	// and goes out last, so a store only looks formatted once every group is in place.
+	uint32_t  RootTreeBlock 	= Plan->ChecksumStartBlock + ChecksumBlocks;
+	uint32_t  MaxGroupSectors 	= RootTreeBlock + 1;
+	BYTE* 	  FormatImage 		= (BYTE*) malloc((size_t) MaxGroupSectors * BlockSize);
+	uint32_t* Checksums 		= (uint32_t*) malloc((size_t) ChecksumBlocks * PerChecksumBlock * sizeof(uint32_t));
+	bool 	  Written 			= (bool) (FormatImage != 0 && Checksums != 0);
+
+	for (GroupIterator = NumGroups; GroupIterator > 0 && Written; GroupIterator--)
+	{
+		struct nRTOS_GroupDescriptor* Descriptor = &Descriptors[GroupIterator - 1];
+
+		uint32_t RunStart 	= (GroupIterator - 1 == 0) ? SUPER_BLOCK_SECTOR_NUM : Descriptor->FirstBlock;
+		uint32_t RunSectors = Descriptor->InodeTableBlock + InodeBlocks + ChecksumBlocks - RunStart;
+		uint32_t TakenBlocks = Descriptor->InodeTableBlock + InodeBlocks + ChecksumBlocks - Descriptor->FirstBlock;
+
+		if (RunStart == SUPER_BLOCK_SECTOR_NUM)
+		{
+			RunSectors++;
+			TakenBlocks++;
+		}
+
+		memset(FormatImage, 0, (size_t) RunSectors * BlockSize);
+
+		if (RunStart == SUPER_BLOCK_SECTOR_NUM)
+		{
+			// Initialize the disk with the SuperBlock parameters so we know what exactly we're dealing with
+			memcpy(&FormatImage[SUPER_BLOCK_SECTOR_NUM * BlockSize], Plan, sizeof(struct nRTOS_SuperBlock));
+
+			// Descriptors never straddle two blocks of the table
+			uint32_t TableIterator = 0;
+			for (TableIterator = 0; TableIterator < NumGroups; TableIterator++)
+			{
+				BYTE* TableBlock = &FormatImage[(size_t) (Plan->GroupTableBlock + (TableIterator / PerTableBlock)) * BlockSize];
+				memcpy(&TableBlock[(TableIterator % PerTableBlock) * sizeof(struct nRTOS_GroupDescriptor)], &Descriptors[TableIterator], sizeof(struct nRTOS_GroupDescriptor));
+			}
+
+			Journal_FormatHeader(&FormatImage[(size_t) Plan->JournalStartBlock * BlockSize]);
+			DirectoryTree_FormatRoot(&FormatImage[(size_t) RootTreeBlock * BlockSize]);
+		}
+
+		BitMap* FormatBlockBitMap 	= BitMap_Init((Plan->BlocksPerGroup / WORD_SIZE) + 1);
+		BitMap* FormatInodeBitMap 	= BitMap_Init((Plan->InodesPerGroup / WORD_SIZE) + 1);
+
+		if (FormatBlockBitMap == 0 || FormatInodeBitMap == 0) exit(-1);
+
+		// Everything from the start of the group up to the end of its checksum table (and the root directory's tree) is taken
+		BitMap_SetRun(FormatBlockBitMap, 0, TakenBlocks);
+		if (RunStart == SUPER_BLOCK_SECTOR_NUM) BitMap_SetBit(FormatInodeBitMap, ROOT_DIRECTORY_INODE);
+
+		_SerializeBitMap(FormatBlockBitMap, &FormatImage[(size_t) (Descriptor->BlockBitMapBlock - RunStart) * BlockSize], BlockSize);
+		_SerializeBitMap(FormatInodeBitMap, &FormatImage[(size_t) (Descriptor->InodeBitMapBlock - RunStart) * BlockSize], BlockSize);
+
+		// Delete the allocations
+		BitMap_DeInit(FormatBlockBitMap);
+		BitMap_DeInit(FormatInodeBitMap);
+
+		// Every inode starts out blank apart from its number
+		uint32_t InodeIterator = 0;
+		for (InodeIterator = 0; InodeIterator < Plan->InodesPerGroup; InodeIterator++)
+		{
+			BYTE* InodeSector = &FormatImage[(size_t) (Descriptor->InodeTableBlock - RunStart + (InodeIterator / InodesPerBlock)) * BlockSize];
+
+			((INODE*) &InodeSector[(InodeIterator % InodesPerBlock) * sizeof(INODE)])->INODE_NUM = Descriptor->FirstInode + InodeIterator;
+		}
+
+		if (RunStart == SUPER_BLOCK_SECTOR_NUM)
+		{
+			INODE* RootDirectory = (INODE*) &FormatImage[(size_t) (Descriptor->InodeTableBlock - RunStart) * BlockSize];
+
+			RootDirectory->FILE_TYPE 		= INODE_TYPE_DIRECTORY;
+			RootDirectory->PARENT 			= ROOT_DIRECTORY_INODE;
+			RootDirectory->DIRECTORY_ROOT 	= RootTreeBlock;
+		}
+
+		// The checksum table goes in last, once every other block of the image is final. Blocks outside the image still
+		// hold whatever the store had in them, so they go unchecked.
+		uint32_t BlockIterator = 0;
+		for (BlockIterator = 0; BlockIterator < ChecksumBlocks * PerChecksumBlock; BlockIterator++) Checksums[BlockIterator] = CHECKSUM_NONE;
+
+		for (BlockIterator = RunStart; BlockIterator < RunStart + RunSectors; BlockIterator++)
+		{
+			if (_IsSelfChecked(volume, BlockIterator) == TRUE) continue;
+
+			Checksums[BlockIterator - Descriptor->FirstBlock] = Checksum_CRC32C(&FormatImage[(size_t) (BlockIterator - RunStart) * BlockSize], BlockSize);
+		}
+
+		for (BlockIterator = 0; BlockIterator < ChecksumBlocks; BlockIterator++)
+		{
+			BYTE* TableBlock = &FormatImage[(size_t) (Descriptor->InodeTableBlock + InodeBlocks + BlockIterator - RunStart) * BlockSize];
+
+			_SerializeChecksums(&Checksums[BlockIterator * PerChecksumBlock], TableBlock, BlockSize);
+		}
+
+		// Every other group has to be durable before group 0 makes the store look formatted
+		if (RunStart == SUPER_BLOCK_SECTOR_NUM && _SyncStore(volume) == FALSE) Written = FALSE;
+
+		if (Written == TRUE) Written = _WriteRunToFile(volume, FormatImage, RunStart, RunSectors);
+	}
+
+	if (Written == TRUE) Written = _SyncStore(volume);
+
+	free(FormatImage);
+	free(Checksums);
+	free(Descriptors);
+
+	if (Written == FALSE) exit(-1);
+
+	// The mapping and the cache only come with the mount, so everything above went straight to the store
+}
+
+// File operations. The caller holds the volume's lock.
+
+// The inode is claimed without holding NamespaceLock; the path only has to be free by the time the entry goes into
+// its directory
+MYFILE* _CreateFile(VOLUME* volume, char* path)
+{
+	pthread_mutex_lock(&volume->NamespaceLock);
+	FileError Error = _CheckNewPath(volume, path);
+	pthread_mutex_unlock(&volume->NamespaceLock);
+
+	if (Error != FILE_OK)
+	{
+		_SetError(volume, Error);
+		return 0;	// We cannot create the same path twice
+	}
+
+	MYFILE* fileToReturn = (MYFILE*) calloc(1, sizeof(MYFILE));
+
+	if (fileToReturn == 0)
+	{
+		_SetError(volume, FILE_INIT_FAILED);
+		return 0;			// Out of memory, cannot proceed
+	}
+
+	int32_t InodeNumToAssign = _ClaimFreeInode(volume);
+
+	if (InodeNumToAssign < 0)
+	{
+		free(fileToReturn);
+		_SetError(volume, FILE_NO_SPACE);
+		return 0;
+	}
+
+	// The new file's inode is its slot in the resident table
+	INODE* newFile = _GetResidentInode(volume, InodeNumToAssign);
+
+	fileToReturn->FileInode = newFile;
+	fileToReturn->Volume 	= volume;
+
+	pthread_rwlock_wrlock(_InodeLock(fileToReturn));
+
+	// Initialize the new Inode with the proper items
+	memset(newFile, 0, sizeof(INODE));
+	newFile->INODE_NUM = InodeNumToAssign;
+	newFile->FILE_TYPE = INODE_TYPE_FILE;
+	newFile->FILE_FLAGS = (volume->Options.Compress) ? INODE_FLAG_COMPRESSED : 0;
+	newFile->BYTES_USED  = 0;
+	newFile->LATEST_CURSOR = 0;
+
+	// Every file starts out with its (empty) data inline, and takes no block until it outgrows the inode
+
+	// Another create of the same path may have gotten in since the check above
+	pthread_mutex_lock(&volume->NamespaceLock);
+	Error = _AddEntry(volume, path, newFile);
+	pthread_mutex_unlock(&volume->NamespaceLock);
+
+	if (Error != FILE_OK)
+	{
+		memset(newFile, 0, sizeof(INODE));
+		newFile->INODE_NUM = InodeNumToAssign;
+	}
+	else
+	{
+		_MarkInodeAsDirty(volume, InodeNumToAssign);
+	}
+
+	pthread_rwlock_unlock(_InodeLock(fileToReturn));
+
+	_SetError(volume, Error);
+
+	if (Error != FILE_OK)
+	{
+		_MarkInodeAsFree(volume, InodeNumToAssign);
+		free(fileToReturn);
+		return 0;
+	}
+
+	return fileToReturn;
+}
+
+MYFILE* _OpenFile(VOLUME* volume, char* path)
+{
+	FileError Error = FILE_OK;
+
+	// Get the proper inode associated with this path
+	pthread_mutex_lock(&volume->NamespaceLock);
+
+	int32_t associatedInode = _LookupPath(volume, path, &Error);
+	if (associatedInode >= 0 && volume->InodeTable[associatedInode].FILE_TYPE == INODE_TYPE_DIRECTORY) Error = FILE_IS_A_DIRECTORY;
+
+	pthread_mutex_unlock(&volume->NamespaceLock);
+
+	if (Error != FILE_OK)
+	{
+		_SetError(volume, Error);
+		return 0;
+	}
+
+	MYFILE* returnFile = (MYFILE*) calloc(1, sizeof(MYFILE));
+
+	if (returnFile == 0)
+	{
+		_SetError(volume, FILE_INIT_FAILED);
+		return 0;	// Not enough memory to initialize anything, so we cannot do anything
+	}
+
+	// Every open of a file shares its resident inode
+	returnFile->FileInode = _GetResidentInode(volume, associatedInode);
+	returnFile->Volume 	  = volume;
+
+	_SetError(volume, FILE_OK);
+
+	// TODO: Read the data chunks into memory as well
+
+	return returnFile;
+}
+
+//	The file is walked one contiguous run at a time. Whole sectors are read straight into Buffer with one access per
+//	run; only a partial first or last sector is bounced through a sector buffer.
+int32_t _ReadFile(VOLUME* volume, MYFILE* fileDescriptor, BYTE* Buffer, uint32_t numBytes, uint64_t Offset)
+{
+	INODE* FileInode = fileDescriptor->FileInode;
+
+	if (FileInode == 0) return FALSE;											// Invalid/corrupted Inode
+
+	if (_IsInline(FileInode) == TRUE && Offset + numBytes <= INLINE_DATA_BYTES)
+	{
+		memcpy(Buffer, &FileInode->INLINE_DATA[Offset], numBytes);				// Past BYTES_USED the inline area is all zeroes
+		return TRUE;
+	}
+
+	if (_IsCompressed(FileInode) == TRUE) return _ReadClusters(volume, FileInode, Buffer, numBytes, Offset);
+
+	uint64_t BlocksNeeded = (Offset + numBytes + volume->Properties.BlockSize - 1) / volume->Properties.BlockSize;
+
+	if (_GrowFile(volume, FileInode, BlocksNeeded) == FALSE) return FALSE;
+
+	BYTE 	 BounceBlock[volume->Properties.BlockSize];
+	uint64_t Position 	= Offset;
+	uint32_t Remaining 	= numBytes;
+
+	while (Remaining > 0)
+	{
+		uint32_t RunLength 		 = 0;
+		uint32_t BlockWanted 	 = 0;
+		uint32_t IntraBlockIndex = Position % volume->Properties.BlockSize;
+		uint32_t BytesDone 		 = 0;
+
+		if (_MapFileBlock(volume, FileInode, (uint32_t) (Position / volume->Properties.BlockSize), &BlockWanted, &RunLength) == FALSE) return FALSE;
+
+		if (IntraBlockIndex != 0 || Remaining < volume->Properties.BlockSize)
+		{
+			// Partial sector: bounce it
+			BytesDone = volume->Properties.BlockSize - IntraBlockIndex;
+			if (BytesDone > Remaining) BytesDone = Remaining;
+
+			if (_ReadSector(volume, BounceBlock, BlockWanted) == FALSE) return FALSE;
+			memcpy(Buffer, &BounceBlock[IntraBlockIndex], BytesDone);
+		}
+		else
+		{
+			// Every whole sector left in this run, in one access
+			uint32_t WholeBlocks = Remaining / volume->Properties.BlockSize;
+			if (WholeBlocks > RunLength) WholeBlocks = RunLength;
+
+			if (_ReadRun(volume, Buffer, BlockWanted, WholeBlocks) == FALSE) return FALSE;
+			BytesDone = WholeBlocks * volume->Properties.BlockSize;
+		}
+
+		Buffer 		+= BytesDone;
+		Position 	+= BytesDone;
+		Remaining 	-= BytesDone;
+	}
+
+	return TRUE;
+}
+
+//	Same walk as OSFS_Read. A partial sector is read, patched and written back, unless it is past the end of the file's
+//	data, in which case there is nothing worth reading.
+bool _WriteFile(VOLUME* volume, MYFILE* fileDescriptor, BYTE* Buffer, uint32_t numBytes, uint64_t Offset)
+{
+	INODE* FileInode = fileDescriptor->FileInode;
+
+	if (FileInode == 0) return FALSE;											// Invalid/corrupted Inode
+
+	// Data that still fits in the inode is written there, and goes out with the inode at the next commit
+	if (_IsInline(FileInode) == TRUE && Offset + numBytes <= INLINE_DATA_BYTES)
+	{
+		memcpy(&FileInode->INLINE_DATA[Offset], Buffer, numBytes);
+
+		if (Offset + numBytes > FileInode->BYTES_USED) FileInode->BYTES_USED = Offset + numBytes;
+		FileInode->LATEST_CURSOR = Offset + numBytes;
+
+		_MarkInodeAsDirty(volume, FileInode->INODE_NUM);
+		return TRUE;
+	}
+
+	if (_IsCompressed(FileInode) == TRUE) return _WriteClusters(volume, FileInode, Buffer, numBytes, Offset);
+
+	// Allocate everything this write will touch up front, so it can be handed out as one contiguous run
+	uint64_t BlocksNeeded = (Offset + numBytes + volume->Properties.BlockSize - 1) / volume->Properties.BlockSize;
+
+	if (_GrowFile(volume, FileInode, BlocksNeeded) == FALSE) return FALSE;
+
+	BYTE 	 BounceBlock[volume->Properties.BlockSize];
+	uint64_t Position 	= Offset;
+	uint32_t Remaining 	= numBytes;
+	bool	 Written 	= TRUE;
+
+	while (Remaining > 0)
+	{
+		uint32_t RunLength 		 = 0;
+		uint32_t BlockWanted 	 = 0;
+		uint32_t IntraBlockIndex = Position % volume->Properties.BlockSize;
+		uint32_t BytesDone 		 = 0;
+
+		Written = _MapFileBlock(volume, FileInode, (uint32_t) (Position / volume->Properties.BlockSize), &BlockWanted, &RunLength);
+
+		if (Written == FALSE) break;
+
+		if (IntraBlockIndex != 0 || Remaining < volume->Properties.BlockSize)
+		{
+			BytesDone = volume->Properties.BlockSize - IntraBlockIndex;
+			if (BytesDone > Remaining) BytesDone = Remaining;
+
+			if ((Position - IntraBlockIndex) >= FileInode->BYTES_USED)
+			{
+				memset(BounceBlock, 0, volume->Properties.BlockSize);								// Nothing has been stored in this sector yet
+			}
+			else if (_ReadSector(volume, BounceBlock, BlockWanted) == FALSE)
+			{
+				Written = FALSE;
+				break;
+			}
+
+			memcpy(&BounceBlock[IntraBlockIndex], Buffer, BytesDone);
+			Written = _WriteSector(volume, BounceBlock, BlockWanted);
+		}
+		else
+		{
+			uint32_t WholeBlocks = Remaining / volume->Properties.BlockSize;
+			if (WholeBlocks > RunLength) WholeBlocks = RunLength;
+
+			BytesDone = WholeBlocks * volume->Properties.BlockSize;
+			Written = _WriteRun(volume, Buffer, BlockWanted, WholeBlocks);
+		}
+
+		if (Written == FALSE) break;
+
+		Buffer 		+= BytesDone;
+		Position 	+= BytesDone;
+		Remaining 	-= BytesDone;
+	}
+
+	// Whatever made it to the disk counts
+	if (Position > FileInode->BYTES_USED)
+	{
+		FileInode->BYTES_USED = Position;
+	}
+
+	FileInode->LATEST_CURSOR = Position;
+
+	return Written;
+}
+
+// The chunk handed out by OSFS_CursorNext
+int32_t _NextCursorChunk(VOLUME* volume, FILE_CURSOR* cursor, BYTE** Chunk)
+{
+	INODE* FileInode = cursor->File->FileInode;
+
+	if (cursor->Position >= FileInode->BYTES_USED) return 0;
+
+	uint64_t Remaining 	 = FileInode->BYTES_USED - cursor->Position;
+
+	// The whole of an inline file is one chunk, copied out as the inode is only stable while its lock is held
+	if (_IsInline(FileInode) == TRUE)
+	{
+		memcpy(cursor->Chunk, &FileInode->INLINE_DATA[cursor->Position], (size_t) Remaining);
+
+		*Chunk 			  = cursor->Chunk;
+		cursor->Position += Remaining;
+
+		return (int32_t) Remaining;
+	}
+
+	// A compressed file is handed out a cluster at a time, decompressed into the chunk buffer
+	if (_IsCompressed(FileInode) == TRUE)
+	{
+		uint32_t ClusterBytes = COMPRESSION_CLUSTER_BLOCKS * volume->Properties.BlockSize;
+		uint64_t ChunkBytes   = ClusterBytes - (cursor->Position % ClusterBytes);
+
+		if (ChunkBytes > CURSOR_CHUNK_SECTORS * volume->Properties.BlockSize) ChunkBytes = CURSOR_CHUNK_SECTORS * volume->Properties.BlockSize;
+		if (ChunkBytes > Remaining) ChunkBytes = Remaining;
+
+		if (_ReadClusters(volume, FileInode, cursor->Chunk, (uint32_t) ChunkBytes, cursor->Position) == FALSE) return -1;
+
+		*Chunk 			  = cursor->Chunk;
+		cursor->Position += ChunkBytes;
+
+		return (int32_t) ChunkBytes;
+	}
+
+	uint32_t RunLength 	 = 0;
+	uint32_t BlockWanted = 0;
+	uint64_t SectorsLeft = (Remaining + volume->Properties.BlockSize - 1) / volume->Properties.BlockSize;
+
+	if (_MapFileBlock(volume, FileInode, (uint32_t) (cursor->Position / volume->Properties.BlockSize), &BlockWanted, &RunLength) == FALSE) return -1;
+
+	if (RunLength > SectorsLeft) RunLength = (uint32_t) SectorsLeft;
+
+	if (volume->StoreMapping != 0 && volume->SectorBuffer == 0)
+	{
+		*Chunk = &volume->StoreMapping[(uint64_t) BlockWanted * volume->Properties.BlockSize];
+
+		if (_VerifyChecksums(volume, *Chunk, BlockWanted, RunLength) == FALSE) return -1;
+	}
+	else
+	{
+		if (RunLength > CURSOR_CHUNK_SECTORS) RunLength = CURSOR_CHUNK_SECTORS;
+
+		if (_ReadRun(volume, cursor->Chunk, BlockWanted, RunLength) == FALSE) return -1;
+
+		*Chunk = cursor->Chunk;
+	}
+
+	uint32_t ChunkBytes = RunLength * volume->Properties.BlockSize;
+	if (ChunkBytes > Remaining) ChunkBytes = (uint32_t) Remaining;
+
+	cursor->Position += ChunkBytes;
+
+	return (int32_t) ChunkBytes;
+}
+
+// The entry goes first, so nothing can open the file any more. Whoever is still using the inode is waited for before it is emptied.
+bool _DeleteFile(VOLUME* volume, char* path)
+{
+	FileError Error = FILE_OK;
+
+	pthread_mutex_lock(&volume->NamespaceLock);
+	int32_t associatedInode = _RemoveEntry(volume, path, INODE_TYPE_FILE, &Error);
+	pthread_mutex_unlock(&volume->NamespaceLock);
+
+	_SetError(volume, Error);
+
+	if (associatedInode == -1) return FALSE;
+
+	INODE* deletedFile = _GetResidentInode(volume, associatedInode);
+
+	if (deletedFile == 0) exit(-1);											// The directory is corrupted
+
+	pthread_rwlock_wrlock(&volume->InodeLocks[associatedInode]);
+
+	_FreeFileBlocks(volume, deletedFile);
+
+	// Leave a blank inode behind, the same as a freshly formatted one
+	memset(deletedFile, 0, sizeof(INODE));
+	deletedFile->INODE_NUM = associatedInode;
+	_MarkInodeAsDirty(volume, associatedInode);
+
+	pthread_rwlock_unlock(&volume->InodeLocks[associatedInode]);
+
+	// Only now can the inode be handed out again
+	_MarkInodeAsFree(volume, associatedInode);
+
+	return TRUE;
+
+}
+
+// The new directory's tree starts out in the group its inode came from
+bool _MakeDirectory(VOLUME* volume, char* path)
+{
+	int32_t InodeNumToAssign = _ClaimFreeInode(volume);
+
+	if (InodeNumToAssign < 0)
+	{
+		_SetError(volume, FILE_NO_SPACE);
+		return FALSE;
+	}
+
+	INODE* newDirectory = _GetResidentInode(volume, InodeNumToAssign);
+	FileError Error 	= FILE_OK;
+
+	if (newDirectory == 0) exit(-1);
+
+	pthread_rwlock_wrlock(&volume->InodeLocks[InodeNumToAssign]);
+
+	memset(newDirectory, 0, sizeof(INODE));
+	newDirectory->INODE_NUM = InodeNumToAssign;
+	newDirectory->FILE_TYPE = INODE_TYPE_DIRECTORY;
+
+	pthread_mutex_lock(&volume->NamespaceLock);
+
+	Error = _CheckNewPath(volume, path);
+
+	if (Error == FILE_OK)
+	{
+		int64_t RootBlock = DirectoryTree_Create(volume->Directories, _GroupOfInode(volume, InodeNumToAssign)->Descriptor.FirstBlock);
+
+		if (RootBlock < 0) Error = FILE_NO_SPACE;
+		else
+		{
+			newDirectory->DIRECTORY_ROOT = (uint32_t) RootBlock;
+			Error = _AddEntry(volume, path, newDirectory);
+
+			if (Error != FILE_OK) DirectoryTree_Free(volume->Directories, newDirectory->DIRECTORY_ROOT);
+		}
+	}
+
+	pthread_mutex_unlock(&volume->NamespaceLock);
+
+	if (Error != FILE_OK)
+	{
+		memset(newDirectory, 0, sizeof(INODE));
+		newDirectory->INODE_NUM = InodeNumToAssign;
+	}
+	else
+	{
+		_MarkInodeAsDirty(volume, InodeNumToAssign);
+	}
+
+	pthread_rwlock_unlock(&volume->InodeLocks[InodeNumToAssign]);
+
+	_SetError(volume, Error);
+
+	if (Error != FILE_OK)
+	{
+		_MarkInodeAsFree(volume, InodeNumToAssign);
+		return FALSE;
+	}
+
+	return TRUE;
+}
+
+// Only empty directories go. Their tree is freed along with the entry, so all that is left is the inode.
+bool _RemoveDirectory(VOLUME* volume, char* path)
+{
+	FileError Error = FILE_OK;
+
+	pthread_mutex_lock(&volume->NamespaceLock);
+	int32_t associatedInode = _RemoveEntry(volume, path, INODE_TYPE_DIRECTORY, &Error);
+	pthread_mutex_unlock(&volume->NamespaceLock);
+
+	_SetError(volume, Error);
+
+	if (associatedInode == -1) return FALSE;
+
+	INODE* removedDirectory = _GetResidentInode(volume, associatedInode);
+
+	if (removedDirectory == 0) exit(-1);											// The directory is corrupted
+
+	pthread_rwlock_wrlock(&volume->InodeLocks[associatedInode]);
+
+	memset(removedDirectory, 0, sizeof(INODE));
+	removedDirectory->INODE_NUM = associatedInode;
+	_MarkInodeAsDirty(volume, associatedInode);
+
+	pthread_rwlock_unlock(&volume->InodeLocks[associatedInode]);
+
+	_MarkInodeAsFree(volume, associatedInode);
+
+	return TRUE;
+}
+
+// The names are taken under NamespaceLock, the sizes afterwards under each inode's own lock (the lock order does not
+// allow both at once). An entry removed in between is still listed.
+bool _ListDirectory(VOLUME* volume, char* path, LISTING* Listing)
+{
+	FileError Error = FILE_OK;
+
+	pthread_mutex_lock(&volume->NamespaceLock);
+
+	int32_t Directory = _LookupPath(volume, path, &Error);
+
+	if (Directory >= 0 && volume->InodeTable[Directory].FILE_TYPE != INODE_TYPE_DIRECTORY) Error = FILE_NOT_A_DIRECTORY;
+
+	if (Error == FILE_OK && DirectoryTree_Walk(volume->Directories, volume->InodeTable[Directory].DIRECTORY_ROOT, _GatherItem, Listing) == FALSE)
+	{
+		Error = FILE_INIT_FAILED;
+	}
+
+	uint32_t ItemIterator = 0;
+
+	for (ItemIterator = 0; Error == FILE_OK && ItemIterator < Listing->NumItems; ItemIterator++)
+	{
+		Listing->Items[ItemIterator].IsDirectory = (bool) (volume->InodeTable[Listing->InodeNums[ItemIterator]].FILE_TYPE == INODE_TYPE_DIRECTORY);
+	}
+
+	pthread_mutex_unlock(&volume->NamespaceLock);
+
+	_SetError(volume, Error);
+
+	if (Error != FILE_OK) return FALSE;
+
+	for (ItemIterator = 0; ItemIterator < Listing->NumItems; ItemIterator++)
+	{
+		uint32_t InodeNum = Listing->InodeNums[ItemIterator];
+
+		if (Listing->Items[ItemIterator].IsDirectory) continue;
+
+		pthread_rwlock_rdlock(&volume->InodeLocks[InodeNum]);
+		Listing->Items[ItemIterator].Bytes = volume->InodeTable[InodeNum].BYTES_USED;
+		pthread_rwlock_unlock(&volume->InodeLocks[InodeNum]);
+	}
+
+	return TRUE;
+}
+
+bool _GatherItem(void* Context, const char* Name, uint32_t InodeNum)
+{
+	LISTING* Listing = (LISTING*) Context;
+
+	if (Listing->NumItems == Listing->MaxItems)
+	{
+		uint32_t MaxItems 			= (Listing->MaxItems == 0) ? 64 : Listing->MaxItems * 2;
+		DIRECTORY_ITEM* Items 		= (DIRECTORY_ITEM*) realloc(Listing->Items, MaxItems * sizeof(DIRECTORY_ITEM));
+
+		if (Items == 0) return FALSE;
+		Listing->Items = Items;
+
+		uint32_t* InodeNums 		= (uint32_t*) realloc(Listing->InodeNums, MaxItems * sizeof(uint32_t));
+
+		if (InodeNums == 0) return FALSE;
+		Listing->InodeNums = InodeNums;
+
+		Listing->MaxItems = MaxItems;
+	}
+
+	DIRECTORY_ITEM* Item = &Listing->Items[Listing->NumItems];
+
+	memset(Item, 0, sizeof(DIRECTORY_ITEM));
+	strncpy(Item->Name, Name, MAX_FILE_NAME_CHARS);
+
+	Listing->InodeNums[Listing->NumItems] = InodeNum;
+	Listing->NumItems++;
+
+	return TRUE;
+}
+
+// Paths
+
+// Paths are always taken from the root directory; leading, trailing and doubled slashes do not matter. "." and ".."
+// work as usual (".." of the root is the root). LastName gets the last component that is not one of those, or is
+// left empty when the path names a directory by itself (such as "/" or "a/..").
+int32_t _ResolveParent(VOLUME* volume, const char* path, char* LastName, FileError* Error)
+{
+	uint32_t Directory = ROOT_DIRECTORY_INODE;
+
+	LastName[0] = 0;
+	*Error 		= FILE_OK;
+
+	while (*path)
+	{
+		size_t Length = strcspn(path, "/");
+
+		if (Length == 0)
+		{
+			path++;
+			continue;
+		}
+
+		if (Length > MAX_FILE_NAME_CHARS)
+		{
+			*Error = FILE_NAME_TOO_LONG;
+			return -1;
+		}
+
+		// Only a name with more of the path after it has to be a directory
+		if (LastName[0] != 0)
+		{
+			int32_t Next = _FindEntry(volume, Directory, LastName);
+
+			if (Next < 0)
+			{
+				*Error = FILE_DOES_NOT_EXIST;
+				return -1;
+			}
+
+			if (volume->InodeTable[Next].FILE_TYPE != INODE_TYPE_DIRECTORY)
+			{
+				*Error = FILE_NOT_A_DIRECTORY;
+				return -1;
+			}
+
+			Directory 	= (uint32_t) Next;
+			LastName[0] = 0;
+		}
+
+		if (Length == 2 && strncmp(path, "..", 2) == 0) Directory = volume->InodeTable[Directory].PARENT;
+		else if (Length != 1 || path[0] != '.')
+		{
+			memcpy(LastName, path, Length);
+			LastName[Length] = 0;
+		}
+
+		path += Length;
+	}
+
+	return (int32_t) Directory;
+}
+
+int32_t _LookupPath(VOLUME* volume, const char* path, FileError* Error)
+{
+	char LastName[MAX_FILE_NAME_CHARS + 1];
+
+	int32_t Directory = _ResolveParent(volume, path, LastName, Error);
+
+	if (Directory < 0 || LastName[0] == 0) return Directory;
+
+	int32_t Found = _FindEntry(volume, (uint32_t) Directory, LastName);
+
+	if (Found < 0) *Error = FILE_DOES_NOT_EXIST;
+
+	return Found;
+}
+
+int32_t _FindEntry(VOLUME* volume, uint32_t Directory, const char* Name)
+{
+	int32_t Found = DirectoryTree_Find(volume->Directories, volume->InodeTable[Directory].DIRECTORY_ROOT, Name);
+
+	if (Found >= (int32_t) volume->Properties.NumInodes) exit(-1);				// The directory is corrupted
+
+	return Found;
+}
+
+FileError _CheckNewPath(VOLUME* volume, const char* path)
+{
+	char 	  LastName[MAX_FILE_NAME_CHARS + 1];
+	FileError Error = FILE_OK;
+
+	int32_t Directory = _ResolveParent(volume, path, LastName, &Error);
+
+	if (Directory < 0) return Error;
+	if (LastName[0] == 0 || _FindEntry(volume, (uint32_t) Directory, LastName) >= 0) return FILE_ALREADY_EXISTS;
+
+	return FILE_OK;
+}
+
+// The child's inode is not reachable yet, so its PARENT can be set here
+FileError _AddEntry(VOLUME* volume, const char* path, INODE* Child)
+{
+	char 	  LastName[MAX_FILE_NAME_CHARS + 1];
+	FileError Error = _CheckNewPath(volume, path);
+
+	if (Error != FILE_OK) return Error;
+
+	uint32_t Directory = (uint32_t) _ResolveParent(volume, path, LastName, &Error);
+
+	if (DirectoryTree_Insert(volume->Directories, volume->InodeTable[Directory].DIRECTORY_ROOT, LastName, Child->INODE_NUM) == FALSE) return FILE_NO_SPACE;
+
+	volume->InodeTable[Directory].DIRECTORY_ENTRIES++;
+	_MarkInodeAsDirty(volume, Directory);
+
+	Child->PARENT = Directory;
+
+	return FILE_OK;
+}
+
+// FileType is what the caller expects to find there. A directory also has its tree freed.
+int32_t _RemoveEntry(VOLUME* volume, const char* path, uint32_t FileType, FileError* Error)
+{
+	char LastName[MAX_FILE_NAME_CHARS + 1];
+
+	int32_t Directory = _ResolveParent(volume, path, LastName, Error);
+
+	if (Directory < 0) return -1;
+
+	// The path names a directory by itself, which is never taken out of its parent this way
+	if (LastName[0] == 0)
+	{
+		*Error = (FileType == INODE_TYPE_FILE) ? FILE_IS_A_DIRECTORY : FILE_DOES_NOT_EXIST;
+		return -1;
+	}
+
+	int32_t Found = _FindEntry(volume, (uint32_t) Directory, LastName);
+
+	if (Found < 0) *Error = FILE_DOES_NOT_EXIST;
+	else if (volume->InodeTable[Found].FILE_TYPE != FileType) *Error = (FileType == INODE_TYPE_FILE) ? FILE_IS_A_DIRECTORY : FILE_NOT_A_DIRECTORY;
+	else if (FileType == INODE_TYPE_DIRECTORY && volume->InodeTable[Found].DIRECTORY_ENTRIES > 0) *Error = FILE_DIRECTORY_NOT_EMPTY;
+
+	if (*Error != FILE_OK) return -1;
+
+	if (DirectoryTree_Remove(volume->Directories, volume->InodeTable[Directory].DIRECTORY_ROOT, LastName) == FALSE) exit(-1);
+
+	volume->InodeTable[Directory].DIRECTORY_ENTRIES--;
+	_MarkInodeAsDirty(volume, (uint32_t) Directory);
+
+	if (FileType == INODE_TYPE_DIRECTORY) DirectoryTree_Free(volume->Directories, volume->InodeTable[Found].DIRECTORY_ROOT);
+
+	return Found;
+}
+
+// Private functions for interacting with physical disk
+
+// The store is opened once and every sector access is a single positional read or write of just that sector,
+// so the cost of a sector operation does not depend on how large the image is.
+// In MOUNT_MAPPED mode the whole store is mapped instead, and sector accesses are copies into and out of the mapping.
+bool _OpenStore(VOLUME* volume)
+{
+	if (volume->StoreDescriptor >= 0) return TRUE;
+
+	volume->StoreDescriptor = open(volume->StorePath, O_RDWR | O_CREAT, 0644);
+
+	if (volume->StoreDescriptor < 0) return FALSE;
+
+	return TRUE;
+}
+
+// The mapping has to cover every block of the volume, so it can only be set up once the superblock is known
+bool _MapStore(VOLUME* volume)
+{
+	volume->MappingBytes = (uint64_t) volume->Properties.NumDataBlocks * volume->Properties.BlockSize;
+
+	// Grow the store up front if needed
+	if (lseek(volume->StoreDescriptor, 0, SEEK_END) < (off_t) volume->MappingBytes && ftruncate(volume->StoreDescriptor, (off_t) volume->MappingBytes) != 0) return FALSE;
+
+	void* Mapping = mmap(0, volume->MappingBytes, PROT_READ | PROT_WRITE, MAP_SHARED, volume->StoreDescriptor, 0);
+
+	if (Mapping == MAP_FAILED) return FALSE;
+
+	volume->StoreMapping = (BYTE*) Mapping;
+
+	return TRUE;
+}
+
+void _CloseStore(VOLUME* volume)
+{
+	if (volume->StoreDescriptor < 0) return;
+
+	if (volume->StoreMapping != 0)
+	{
+		_CommitStore(volume);
+		munmap(volume->StoreMapping, volume->MappingBytes);
+		volume->StoreMapping = 0;
+	}
+
+	close(volume->StoreDescriptor);
+	volume->StoreDescriptor = -1;
+}
+
+// Synchronously flush the pages written through the mapping since the last call. Writes opening checksum entries
+// commit outside of commit points (see _OpenChecksums), so the range is only looked at under its lock.
+bool _CommitStore(VOLUME* volume)
+{
+	if (volume->StoreMapping == 0) return TRUE;
+
+	pthread_mutex_lock(&volume->MappingLock);
+
+	bool Committed = TRUE;
+
+	if (volume->MappingDirtyLow <= volume->MappingDirtyHigh)
+	{
+		uintptr_t PageSize  = (uintptr_t) sysconf(_SC_PAGESIZE);
+		uintptr_t DirtyStart = (uintptr_t) &volume->StoreMapping[volume->MappingDirtyLow * volume->Properties.BlockSize];
+		uintptr_t DirtyEnd   = (uintptr_t) &volume->StoreMapping[(volume->MappingDirtyHigh + 1) * volume->Properties.BlockSize];
+
+		DirtyStart &= ~(PageSize - 1);												// msync needs a page aligned start
+
+		Committed = (bool) (msync((void*) DirtyStart, DirtyEnd - DirtyStart, MS_SYNC) == 0);
+	}
+
+	if (Committed == TRUE)
+	{
+		volume->MappingDirtyLow  = UINT64_MAX;
+		volume->MappingDirtyHigh = 0;
+	}
+
+	pthread_mutex_unlock(&volume->MappingLock);
+
+	return Committed;
+}
+
+// A pwrite is only in the kernel's page cache until it is synced, and a write through the mapping only in the mapping
+bool _SyncStore(void* Context)
+{
+	VOLUME* volume = (VOLUME*) Context;
+
+	if (volume->StoreMapping != 0) return _CommitStore(volume);
+
+	return (bool) (fdatasync(volume->StoreDescriptor) == 0);
+}
+
+bool _WriteSector(VOLUME* volume, BYTE* InputBuffer, uint64_t BlockNum)
+{
+	if (_OpenChecksums(volume, BlockNum, 1) == FALSE) return FALSE;
+
+	if (volume->SectorBuffer == 0) return _WriteToFile(volume, InputBuffer, BlockNum);
+
+	return SectorCache_Write(volume->SectorBuffer, InputBuffer, BlockNum);
+}
+
+bool _ReadSector(VOLUME* volume, BYTE* OutputBuffer, uint64_t BlockNum)
+{
+	if (volume->SectorBuffer == 0) return _ReadFromFile(volume, OutputBuffer, BlockNum);
+
+	return SectorCache_Read(volume->SectorBuffer, OutputBuffer, BlockNum);
+}
+
+bool _FlushSectorCache(VOLUME* volume)
+{
+	if (volume->SectorBuffer == 0) return TRUE;
+
+	return SectorCache_Flush(volume->SectorBuffer);
+}
+
+// Metadata is read once at mount, so checkpointed sectors go straight to the store rather than through the cache.
+// Their checksums were set when they were logged (see _LogMetadata): an older image checkpointed after the sector was
+// logged again must not take its checksum back.
+bool _WriteHomeSector(void* Context, BYTE* InputBuffer, uint64_t BlockNum)
+{
+	VOLUME* volume = (VOLUME*) Context;
+
+	if (volume->SectorBuffer != 0) SectorCache_Update(volume->SectorBuffer, InputBuffer, BlockNum);
+
+	return _StoreRunToFile(volume, InputBuffer, BlockNum, 1);
+}
+
+// Commit point: every metadata change since the last one goes into the journal as a single transaction.
+// Data goes out (and is synced) first, so a committed inode never references blocks whose contents the store may
+// not have yet. The journal syncs the transaction itself before it counts as committed.
+bool _CommitMetadata(VOLUME* volume)
+{
+	bool Committed = _FlushSectorCache(volume);
+
+	Committed = _SyncStore(volume) && Committed;
+
+	Committed = ExtentTree_LogChanged(volume->FileExtents, _LogTreeNode) && Committed;
+	Committed = DirectoryTree_LogChanged(volume->Directories, _LogTreeNode) && Committed;
+	_LogBlockGroups(volume);
+	Committed = _LogInodeTable(volume) && Committed;
+	_LogChecksums(volume);
+	Committed = Journal_Commit(volume->MetadataJournal) && Committed;
+
+	// The log can still hold images of freed tree nodes. Their blocks are handed back only once those images are
+	// checkpointed, so no replay can write one over whatever the block holds next.
+	bool HasRetired = (bool) (ExtentTree_HasRetired(volume->FileExtents) || DirectoryTree_HasRetired(volume->Directories));
+
+	if (Committed == TRUE && HasRetired == TRUE && Journal_Checkpoint(volume->MetadataJournal) == TRUE)
+	{
+		ExtentTree_ReleaseRetired(volume->FileExtents);
+		DirectoryTree_ReleaseRetired(volume->Directories);
+
+		_LogBlockGroups(volume);
+		_LogChecksums(volume);
+		Committed = Journal_Commit(volume->MetadataJournal);
+	}
+
+	return Committed;
+}
+
+// The caller holds the volume's lock exclusively
+bool _EndOperation(VOLUME* volume)
+{
+	if (volume->OpenBatches > 0) return TRUE;
+
+	return _CommitMetadata(volume);
+}
+
+// Committing needs the volume to itself, which an open batch makes pointless to wait for
+bool _CommitOperation(VOLUME* volume)
+{
+	if (__atomic_load_n(&volume->OpenBatches, __ATOMIC_ACQUIRE) > 0) return TRUE;
+
+	pthread_rwlock_wrlock(&volume->Lock);
+
+	bool Committed = _EndOperation(volume);
+
+	pthread_rwlock_unlock(&volume->Lock);
+
+	return Committed;
+}
+
+void _InitRWLock(pthread_rwlock_t* Lock)
+{
+	pthread_rwlockattr_t LockAttributes;
+
+	pthread_rwlockattr_init(&LockAttributes);
+#if defined(__GLIBC__)
+	pthread_rwlockattr_setkind_np(&LockAttributes, PTHREAD_RWLOCK_PREFER_WRITER_NONRECURSIVE_NP);
+#endif
+
+	if (pthread_rwlock_init(Lock, &LockAttributes) != 0) exit(-1);
+
+	pthread_rwlockattr_destroy(&LockAttributes);
+}
+
+pthread_rwlock_t* _InodeLock(MYFILE* file)
+{
+	return &file->Volume->InodeLocks[file->FileInode->INODE_NUM];
+}
+
+// Only the file's written bytes are fetched ahead, and never more than a quarter of the sector cache at once so the
+// reader's own sectors are not pushed out. A new batch is only fetched once the reader is halfway through the last one.
+void _Readahead(VOLUME* volume, MYFILE* File, uint64_t Offset, uint32_t numBytes)
+{
+	INODE* FileInode = File->FileInode;
+
+	if (_IsInline(FileInode) == TRUE) return;									// The data came in with the inode
+	if (_IsCompressed(FileInode) == TRUE) return;								// Clusters are read whole, and decompressed straight away
+
+	uint32_t Window = __atomic_load_n(&File->ReadaheadBlocks, __ATOMIC_RELAXED);
+	uint32_t Fetched = __atomic_load_n(&File->ReadaheadEnd, __ATOMIC_RELAXED);
+
+	if (__atomic_exchange_n(&File->NextSequential, Offset + numBytes, __ATOMIC_RELAXED) != Offset)
+	{
+		__atomic_store_n(&File->ReadaheadBlocks, 0, __ATOMIC_RELAXED);
+		__atomic_store_n(&File->ReadaheadEnd, 0, __ATOMIC_RELAXED);
+		return;
+	}
+
+	uint32_t MaxWindow = READAHEAD_MAX_BLOCKS;
+	if (volume->SectorBuffer != 0 && volume->SectorBuffer->NumEntries / 4 < MaxWindow) MaxWindow = volume->SectorBuffer->NumEntries / 4;
+
+	Window = (Window == 0) ? READAHEAD_MIN_BLOCKS : Window * 2;
+	if (Window > MaxWindow) Window = MaxWindow;
+	__atomic_store_n(&File->ReadaheadBlocks, Window, __ATOMIC_RELAXED);
+
+	if (Window == 0) return;
+
+	uint32_t NextBlock 	= (uint32_t) ((Offset + numBytes + volume->Properties.BlockSize - 1) / volume->Properties.BlockSize);	// A partly read block is cached already
+	uint32_t UsedBlocks = (uint32_t) ((FileInode->BYTES_USED + volume->Properties.BlockSize - 1) / volume->Properties.BlockSize);
+	uint32_t FirstBlock = (Fetched > NextBlock) ? Fetched : NextBlock;
+	uint32_t EndBlock 	= NextBlock + Window;
+
+	if (EndBlock > UsedBlocks) EndBlock = UsedBlocks;
+	if (FirstBlock >= EndBlock) return;
+	if (FirstBlock > NextBlock + (Window / 2)) return;						// Still well ahead of the reader
+
+	__atomic_store_n(&File->ReadaheadEnd, EndBlock, __ATOMIC_RELAXED);
+
+	// One access per extent the window covers
+	while (FirstBlock < EndBlock)
+	{
+		uint32_t RunLength 	= 0;
+		uint32_t BlockNum 	= 0;
+
+		if (_MapFileBlock(volume, FileInode, FirstBlock, &BlockNum, &RunLength) == FALSE) return;			// The read itself will fail on it
+		if (RunLength > EndBlock - FirstBlock) RunLength = EndBlock - FirstBlock;
+
+		_PrefetchRun(volume, BlockNum, RunLength);
+
+		FirstBlock += RunLength;
+	}
+}
+
+// Cached: the sectors go into the sector cache. Mapped or uncached: the kernel is asked to start reading them.
+void _PrefetchRun(VOLUME* volume, uint64_t BlockNum, uint32_t NumBlocks)
+{
+	if (volume->StoreMapping != 0)
+	{
+		uint64_t PageSize 	= (uint64_t) sysconf(_SC_PAGESIZE);
+		uint64_t FirstByte 	= (BlockNum * volume->Properties.BlockSize) & ~(PageSize - 1);
+		uint64_t EndByte 	= (BlockNum + NumBlocks) * volume->Properties.BlockSize;
+
+		madvise(&volume->StoreMapping[FirstByte], EndByte - FirstByte, MADV_WILLNEED);
+		return;
+	}
+
+	if (volume->SectorBuffer == 0)
+	{
+		posix_fadvise(volume->StoreDescriptor, (off_t) (BlockNum * volume->Properties.BlockSize), (off_t) NumBlocks * volume->Properties.BlockSize, POSIX_FADV_WILLNEED);
+		return;
+	}
+
+	if (NumBlocks > READAHEAD_MAX_BLOCKS) NumBlocks = READAHEAD_MAX_BLOCKS;
+
+	BYTE* Run = (BYTE*) malloc((size_t) NumBlocks * volume->Properties.BlockSize);
+
+	if (Run == 0) return;
+
+	// The file's blocks cannot be written while its inode lock is held, so once clean the store holds them as they are
+	if (SectorCache_Clean(volume->SectorBuffer, BlockNum, NumBlocks) == TRUE && _ReadRunFromFile(volume, Run, BlockNum, NumBlocks) == TRUE)
+	{
+		SectorCache_Fill(volume->SectorBuffer, Run, BlockNum, NumBlocks);
+	}
+
+	free(Run);
+}
+
+// Carries out one submitted request on an I/O thread
+void _ServeIO(void* Context, void* Item)
+{
+	VOLUME* volume 		= (VOLUME*) Context;
+	IO_REQUEST* Request = (IO_REQUEST*) Item;
+
+	if (Request->Operation == IO_READ) Request->Result = OSFS_Read(Request->File, Request->Buffer, Request->NumBytes, Request->Offset);
+	else Request->Result = OSFS_Write(Request->File, Request->Buffer, Request->NumBytes, Request->Offset);
+
+	if (Request->Callback != 0)
+	{
+		Request->Callback(Request);
+		return;
+	}
+
+	// Nothing can be done about a request that cannot be queued, other than keep OSFS_WaitIO from waiting on it
+	if (WorkQueue_Push(volume->IoCompletions, Request) == FALSE) WorkQueue_GiveUp(volume->IoCompletions);
+}
+
+void _SetError(VOLUME* volume, FileError Error)
+{
+	__atomic_store_n(&volume->RecentError, Error, __ATOMIC_RELAXED);
+}
+
+// Whole runs bypass the cache (they would only churn it), so whatever it holds for the run is written back first
+// Cached sectors at the front of the run (readahead puts them there) are copied out of the cache, the rest is read in one go
+bool _ReadRun(VOLUME* volume, BYTE* OutputBuffer, uint64_t BlockNum, uint32_t NumBlocks)
+{
+	if (volume->SectorBuffer != 0)
+	{
+		uint32_t Cached = SectorCache_ReadCached(volume->SectorBuffer, OutputBuffer, BlockNum, NumBlocks);
+
+		if (Cached == NumBlocks) return TRUE;
+
+		OutputBuffer 	+= Cached * volume->Properties.BlockSize;
+		BlockNum 		+= Cached;
+		NumBlocks 		-= Cached;
+
+		if (SectorCache_Clean(volume->SectorBuffer, BlockNum, NumBlocks) == FALSE) return FALSE;
+	}
+
+	return _ReadRunFromFile(volume, OutputBuffer, BlockNum, NumBlocks);
+}
+
+// Cached copies are refreshed before the store is written, so one being evicted meanwhile cannot land on top of the run
+bool _WriteRun(VOLUME* volume, BYTE* InputBuffer, uint64_t BlockNum, uint32_t NumBlocks)
+{
+	if (_OpenChecksums(volume, BlockNum, NumBlocks) == FALSE) return FALSE;
+
+	if (volume->SectorBuffer != 0)
+	{
+		uint32_t BlockIterator = 0;
+
+		for (BlockIterator = 0; BlockIterator < NumBlocks; BlockIterator++)
+		{
+			SectorCache_Update(volume->SectorBuffer, &InputBuffer[BlockIterator * volume->Properties.BlockSize], BlockNum + BlockIterator);
+		}
+	}
+
+	return _WriteRunToFile(volume, InputBuffer, BlockNum, NumBlocks);
+}
+
+bool _WriteToFile(void* Context, BYTE* InputBuffer, uint64_t BlockNum)
+{
+	return _WriteRunToFile((VOLUME*) Context, InputBuffer, BlockNum, 1);
+}
+
+bool _WriteRunToFile(VOLUME* volume, BYTE* InputBuffer, uint64_t BlockNum, uint32_t NumBlocks)
+{
+	_NoteChecksums(volume, InputBuffer, BlockNum, NumBlocks);
+
+	return _StoreRunToFile(volume, InputBuffer, BlockNum, NumBlocks);
+}
+
+bool _StoreRunToFile(VOLUME* volume, BYTE* InputBuffer, uint64_t BlockNum, uint32_t NumBlocks)
+{
+	if (_OpenStore(volume) == FALSE) return FALSE;
+
+	uint64_t BytesWanted = (uint64_t) NumBlocks * volume->Properties.BlockSize;
+
+	if (volume->StoreMapping != 0)
+	{
+		if (BlockNum + NumBlocks > volume->Properties.NumDataBlocks) return FALSE;			// Outside of the mapping
+
+		memcpy(&volume->StoreMapping[BlockNum * volume->Properties.BlockSize], InputBuffer, BytesWanted);
+
+		pthread_mutex_lock(&volume->MappingLock);
+		if (BlockNum < volume->MappingDirtyLow) volume->MappingDirtyLow = BlockNum;
+		if (BlockNum + NumBlocks - 1 > volume->MappingDirtyHigh) volume->MappingDirtyHigh = BlockNum + NumBlocks - 1;
+		pthread_mutex_unlock(&volume->MappingLock);
+
+		return TRUE;
+	}
+
+	uint64_t BytesWritten = 0;
+
+	while (BytesWritten < BytesWanted)
+	{
+		ssize_t Result = pwrite(volume->StoreDescriptor, &InputBuffer[BytesWritten], BytesWanted - BytesWritten, (off_t) ((BlockNum * volume->Properties.BlockSize) + BytesWritten));
+		if (Result <= 0) return FALSE;
+		BytesWritten += Result;
+	}
+
+	return TRUE;
+}
+
+
+bool _ReadFromFile(void* Context, BYTE* OutputBuffer, uint64_t BlockNum)
+{
+	return _ReadRunFromFile((VOLUME*) Context, OutputBuffer, BlockNum, 1);
+}
+
+bool _ReadJournalRun(void* Context, BYTE* OutputBuffer, uint64_t BlockNum, uint32_t NumBlocks)
+{
+	return _ReadRunFromFile((VOLUME*) Context, OutputBuffer, BlockNum, NumBlocks);
+}
+
+bool _WriteJournalRun(void* Context, BYTE* InputBuffer, uint64_t BlockNum, uint32_t NumBlocks)
+{
+	return _WriteRunToFile((VOLUME*) Context, InputBuffer, BlockNum, NumBlocks);
+}
+
+bool _ReadRunFromFile(VOLUME* volume, BYTE* OutputBuffer, uint64_t BlockNum, uint32_t NumBlocks)
+{
+	if (_OpenStore(volume) == FALSE) return FALSE;
+
+	uint64_t BytesWanted = (uint64_t) NumBlocks * volume->Properties.BlockSize;
+
+	if (volume->StoreMapping != 0)
+	{
+		if (BlockNum + NumBlocks > volume->Properties.NumDataBlocks) return FALSE;			// Outside of the mapping
+
+		memcpy(OutputBuffer, &volume->StoreMapping[BlockNum * volume->Properties.BlockSize], BytesWanted);
+
+		return _VerifyChecksums(volume, OutputBuffer, BlockNum, NumBlocks);
+	}
+
+	uint64_t BytesRead = 0;
+
+	while (BytesRead < BytesWanted)
+	{
+		ssize_t Result = pread(volume->StoreDescriptor, &OutputBuffer[BytesRead], BytesWanted - BytesRead, (off_t) ((BlockNum * volume->Properties.BlockSize) + BytesRead));
+		if (Result < 0) return FALSE;
+		if (Result == 0) break;													// Past the end of the store
+		BytesRead += Result;
+	}
+
+	// Sectors that have never been written read back as zeroes
+	memset(&OutputBuffer[BytesRead], 0, BytesWanted - BytesRead);
+
+	return _VerifyChecksums(volume, OutputBuffer, BlockNum, NumBlocks);
+}
+
+// Block tools
+
+// Function used to update the bitmap in memory from the Disk
+bool _TranscribeBitMap(BYTE* blockToUse, BitMap* mapToUpdate, uint32_t NumBytes)
+{
+	uint32_t* ArrayInput = (uint32_t*) blockToUse;
+
+	// A block that does not fit the bitmap it is meant for did not come from _SerializeBitMap
+	if (ArrayInput[1] > mapToUpdate->wordsize || (ArrayInput[1] * sizeof(uint32_t)) + (2 * sizeof(uint32_t)) > NumBytes) return FALSE;
+
+	// The pointer itself is not saved, so do not count that in the offset calculations
+	if (BitMap_LoadWords(mapToUpdate, 0, &ArrayInput[2], ArrayInput[1]) == FALSE) return FALSE;
+
+	mapToUpdate->bitsize = ArrayInput[0];
+	mapToUpdate->wordsize = ArrayInput[1];
+
+	return TRUE;
+}
+
+
+// Private Inode Functions
+
+// Return condition:
+// TRUE if inode is occupied
+// FALSE if inode is free
+bool 	_CheckInodeOccupancy(VOLUME* volume, uint32_t Inodenum)
+{
+	if (Inodenum >= volume->Properties.NumInodes) return FALSE;
+
+	BLOCK_GROUP* Group = _GroupOfInode(volume, Inodenum);
+
+	return BitMap_TestBit(Group->InodeBitMap, Inodenum - Group->Descriptor.FirstInode);
+
+}
+
+// Returns the next free inode, already marked as occupied. Creates racing for the same inode each end up with a different one.
+// Successive creates start from successive groups, so new files spread out with room to grow next to them (and
+// concurrent creates stay out of each other's way). Groups without a free block are only used once every group is out of them.
+int32_t _ClaimFreeInode(VOLUME* volume)
+{
+	if (__atomic_load_n(&volume->Properties.FreeInodes, __ATOMIC_RELAXED) == 0) return -1;
+
+	uint32_t NumGroups 	= volume->Properties.NumGroups;
+	uint32_t FirstGroup = __atomic_fetch_add(&volume->NextInodeGroup, 1, __ATOMIC_RELAXED) % NumGroups;
+	uint32_t Pass 		= 0;
+
+	for (Pass = 0; Pass < 2; Pass++)
+	{
+		uint32_t GroupIterator = 0;
+
+		for (GroupIterator = 0; GroupIterator < NumGroups; GroupIterator++)
+		{
+			BLOCK_GROUP* Group 	= &volume->Groups[(FirstGroup + GroupIterator) % NumGroups];
+			int32_t FreeInode 	= -1;
+
+			if (__atomic_load_n(&Group->Descriptor.FreeInodes, __ATOMIC_RELAXED) == 0) continue;
+			if (Pass == 0 && __atomic_load_n(&Group->Descriptor.FreeBlocks, __ATOMIC_RELAXED) == 0) continue;
+
+			while ((FreeInode = BitMap_FindFirstZero(Group->InodeBitMap, Group->Descriptor.NumInodes)) >= 0)
+			{
+				if (BitMap_ClaimBit(Group->InodeBitMap, (uint32_t) FreeInode))
+				{
+					__atomic_sub_fetch(&Group->Descriptor.FreeInodes, 1, __ATOMIC_RELAXED);
+					__atomic_sub_fetch(&volume->Properties.FreeInodes, 1, __ATOMIC_RELAXED);
+					_NoteGroupChanged(Group);
+					return (int32_t) (Group->Descriptor.FirstInode + (uint32_t) FreeInode);
+				}
+			}
+		}
+	}
+
+	return -1;																	// The last free inodes were taken by concurrent creates
+}
+
+void _MarkInodeAsOccupied(VOLUME* volume, uint32_t InodeNum)
+{
+	BLOCK_GROUP* Group = _GroupOfInode(volume, InodeNum);
+
+	if (Group == 0) exit(-1);
+
+	if (BitMap_ClaimBit(Group->InodeBitMap, InodeNum - Group->Descriptor.FirstInode))
+	{
+		__atomic_sub_fetch(&Group->Descriptor.FreeInodes, 1, __ATOMIC_RELAXED);
+		__atomic_sub_fetch(&volume->Properties.FreeInodes, 1, __ATOMIC_RELAXED);
+		_NoteGroupChanged(Group);
+	}
+}
+
+void _MarkInodeAsFree(VOLUME* volume, uint32_t InodeNum)
+{
+	BLOCK_GROUP* Group = _GroupOfInode(volume, InodeNum);
+
+	if (Group == 0) exit(-1);
+
+	BitMap_ClearBit(Group->InodeBitMap, InodeNum - Group->Descriptor.FirstInode);
+	__atomic_add_fetch(&Group->Descriptor.FreeInodes, 1, __ATOMIC_RELAXED);
+	__atomic_add_fetch(&volume->Properties.FreeInodes, 1, __ATOMIC_RELAXED);
+	_NoteGroupChanged(Group);
+
+}
+
+INODE* _GetResidentInode(VOLUME* volume, uint32_t InodeNum)
+{
+	if (InodeNum >= volume->Properties.NumInodes) return 0;
+
+	return &volume->InodeTable[InodeNum];
+}
+
+void _MarkInodeAsDirty(VOLUME* volume, uint32_t InodeNum)
+{
+	BitMap_SetBit(volume->DirtyInodeSectors, InodeNum / volume->InodesPerBlock);
+}
+
+// The on-disk table packs InodesPerBlock inodes at the start of each block. Each group's slice of it is
+// read with one access, and then unpacked into a contiguous array.
+bool _LoadInodeTable(VOLUME* volume)
+{
+	uint32_t BlockSize 		= volume->Properties.BlockSize;
+	uint32_t SliceBlocks 	= volume->Properties.InodeBlocksPerGroup;
+	BYTE* 	 InodeSectors 	= (BYTE*) malloc((size_t) SliceBlocks * BlockSize);
+
+	volume->InodeTable 			= (INODE*) malloc((size_t) volume->TotalInodeBlocks * volume->InodesPerBlock * sizeof(INODE));
+	volume->InodeLocks 			= (pthread_rwlock_t*) malloc(volume->Properties.NumInodes * sizeof(pthread_rwlock_t));
+	volume->OpenHandles 		= (uint32_t*) calloc(volume->Properties.NumInodes, sizeof(uint32_t));
+	volume->DirtyInodeSectors 	= BitMap_Init((volume->TotalInodeBlocks / WORD_SIZE) + 1);
+
+	if (InodeSectors == 0 || volume->InodeTable == 0 || volume->InodeLocks == 0 || volume->OpenHandles == 0 || volume->DirtyInodeSectors == 0) exit(-1);
+
+	uint32_t InodeIterator = 0;
+
+	for (InodeIterator = 0; InodeIterator < volume->Properties.NumInodes; InodeIterator++)
+	{
+		_InitRWLock(&volume->InodeLocks[InodeIterator]);
+	}
+
+	uint32_t GroupIterator = 0;
+
+	for (GroupIterator = 0; GroupIterator < volume->Properties.NumGroups; GroupIterator++)
+	{
+		if (_ReadRunFromFile(volume, InodeSectors, volume->Groups[GroupIterator].Descriptor.InodeTableBlock, SliceBlocks) == FALSE)
+		{
+			free(InodeSectors);
+			return FALSE;
+		}
+
+		uint32_t SectorIterator = 0;
+
+		for (SectorIterator = 0; SectorIterator < SliceBlocks; SectorIterator++)
+		{
+			uint32_t TableSector = (GroupIterator * SliceBlocks) + SectorIterator;
+
+			memcpy(&volume->InodeTable[TableSector * volume->InodesPerBlock], &InodeSectors[SectorIterator * BlockSize], volume->InodesPerBlock * sizeof(INODE));
+		}
+	}
+
+	free(InodeSectors);
+
+	return TRUE;
+}
+
+bool _LogInodeTable(VOLUME* volume)
+{
+	if (volume->InodeTable == 0) return TRUE;
+
+	BYTE	 Sector[volume->Properties.BlockSize];
+	uint32_t SectorIterator = 0;
+	bool	 AllWritten 	= TRUE;
+
+	for (SectorIterator = 0; SectorIterator < volume->TotalInodeBlocks; SectorIterator++)
+	{
+		if (BitMap_TestBit(volume->DirtyInodeSectors, SectorIterator) == FALSE) continue;
+
+		memset(Sector, 0, volume->Properties.BlockSize);
+		memcpy(Sector, &volume->InodeTable[SectorIterator * volume->InodesPerBlock], volume->InodesPerBlock * sizeof(INODE));
+
+		if (_LogMetadata(volume, Sector, _InodeSectorHome(volume, SectorIterator)))
+		{
+			BitMap_ClearBit(volume->DirtyInodeSectors, SectorIterator);
+		}
+		else
+		{
+			AllWritten = FALSE;
+		}
+	}
+
+	return AllWritten;
+}
+
+uint32_t _InodeSectorHome(VOLUME* volume, uint32_t InodeSector)
+{
+	uint32_t SliceBlocks = volume->Properties.InodeBlocksPerGroup;
+
+	return volume->Groups[InodeSector / SliceBlocks].Descriptor.InodeTableBlock + (InodeSector % SliceBlocks);
+}
+
+// Block operations
+
+bool _CheckBlockOccupancy(VOLUME* volume, uint32_t BlockNum)
+{
+	BLOCK_GROUP* Group = _GroupOfBlock(volume, BlockNum);
+
+	if (Group == 0) return FALSE;
+
+	BitMap* BlockBitMap = _GroupBlockBitMap(volume, Group);
+
+	if (BlockBitMap == 0) return TRUE;											// Not to be handed out
+
+	return BitMap_TestBit(BlockBitMap, BlockNum - Group->Descriptor.FirstBlock);
+
+}
+
+// Returns the next free block. Does NOT mark the inode as occupied.
+int32_t _GetNextFreeBlock(VOLUME* volume)
+{
+	FileError Error = FILE_OK;
+
+	if (__atomic_load_n(&volume->Properties.FreeBlocks, __ATOMIC_RELAXED) == 0) return -1;
+
+	return _FindFreeBlocks(volume, volume->Properties.NumDataBlocks, 1, &Error);
+}
+
+void _MarkBlockAsOccupied(VOLUME* volume, uint32_t BlockNum)
+{
+	if (volume->Groups == 0) exit(-1);
+	_ClaimBlocks(volume, BlockNum, 1);
+}
+
+void _MarkBlockAsFree(VOLUME* volume, uint32_t BlockNum)
+{
+	if (volume->Groups == 0) exit(-1);
+	_ReleaseBlocks(volume, BlockNum, 1);
+}
+
+bool _ClaimBlocks(VOLUME* volume, uint32_t BlockNum, uint32_t NumBlocks)
+{
+	BLOCK_GROUP* Group = _GroupOfBlock(volume, BlockNum);
+
+	if (Group == 0 || BlockNum + NumBlocks > Group->Descriptor.FirstBlock + Group->Descriptor.NumBlocks) return FALSE;
+
+	BitMap* BlockBitMap = _GroupBlockBitMap(volume, Group);
+
+	if (BlockBitMap == 0 || BitMap_ClaimRun(BlockBitMap, BlockNum - Group->Descriptor.FirstBlock, NumBlocks) == FALSE) return FALSE;
+
+	uint32_t OldFree = __atomic_fetch_sub(&Group->Descriptor.FreeBlocks, NumBlocks, __ATOMIC_ACQ_REL);
+	_NoteFreeBlocks(volume, Group, OldFree, OldFree - NumBlocks);
+	__atomic_sub_fetch(&volume->Properties.FreeBlocks, NumBlocks, __ATOMIC_RELAXED);
+	_NoteGroupChanged(Group);
+
+	return TRUE;
+}
+
+// The run may span groups, in which case each group gets its part back. A group whose bitmap cannot be read keeps
+// its part, which wastes those blocks but is otherwise harmless.
+void _ReleaseBlocks(VOLUME* volume, uint32_t BlockNum, uint32_t NumBlocks)
+{
+	while (NumBlocks > 0)
+	{
+		BLOCK_GROUP* Group = _GroupOfBlock(volume, BlockNum);
+
+		if (Group == 0) exit(-1);
+
+		uint32_t GroupEnd 		= Group->Descriptor.FirstBlock + Group->Descriptor.NumBlocks;
+		uint32_t Released 		= (BlockNum + NumBlocks > GroupEnd) ? GroupEnd - BlockNum : NumBlocks;
+		BitMap*  BlockBitMap 	= _GroupBlockBitMap(volume, Group);
+
+		if (BlockBitMap != 0)
+		{
+			BitMap_ClearRun(BlockBitMap, BlockNum - Group->Descriptor.FirstBlock, Released);
+			_ForgetChecksums(volume, BlockNum, Released);
+
+			uint32_t OldFree = __atomic_fetch_add(&Group->Descriptor.FreeBlocks, Released, __ATOMIC_ACQ_REL);
+			_NoteFreeBlocks(volume, Group, OldFree, OldFree + Released);
+			__atomic_add_fetch(&volume->Properties.FreeBlocks, Released, __ATOMIC_RELAXED);
+			_NoteGroupChanged(Group);
+		}
+
+		BlockNum 	+= Released;
+		NumBlocks 	-= Released;
+	}
+}
+
+uint32_t _CountFreeBlocks(VOLUME* volume, uint32_t BlockNum, uint32_t MaxLength)
+{
+	BLOCK_GROUP* Group = _GroupOfBlock(volume, BlockNum);
+
+	if (Group == 0) return 0;
+
+	BitMap* BlockBitMap = _GroupBlockBitMap(volume, Group);
+
+	if (BlockBitMap == 0) return 0;
+
+	return BitMap_CountZeroRun(BlockBitMap, BlockNum - Group->Descriptor.FirstBlock, MaxLength, Group->Descriptor.NumBlocks);
+}
+
+// The goal's group is searched first, starting at the goal itself, then the groups after it. Groups whose free count
+// says the run cannot be there are never scanned. The search stops at a group whose block bitmap cannot be read.
+int32_t _FindFreeBlocks(VOLUME* volume, uint32_t GoalBlock, uint32_t NumBlocks, FileError* Error)
+{
+	BLOCK_GROUP* GoalGroup 	= _GroupOfBlock(volume, GoalBlock);
+	uint32_t NumGroups 		= volume->Properties.NumGroups;
+	uint32_t FirstGroup 	= (GoalGroup != 0) ? (uint32_t) (GoalGroup - volume->Groups) : 0;
+	uint32_t GroupNum 		= FirstGroup;
+	bool	 Wrapped 		= FALSE;
+
+	// Full groups are skipped through FullGroups' summary, without looking at their descriptors
+	while (TRUE)
+	{
+		int32_t NextGroup = BitMap_FindNextZero(volume->FullGroups, GroupNum, (Wrapped) ? FirstGroup : NumGroups);
+
+		if (NextGroup < 0)
+		{
+			if (Wrapped || FirstGroup == 0)
+			{
+				*Error = FILE_NO_SPACE;
+				return -1;
+			}
+
+			Wrapped 	= TRUE;
+			GroupNum 	= 0;
+			continue;
+		}
+
+		BLOCK_GROUP* Group 	= &volume->Groups[NextGroup];
+		int32_t Found 		= -1;
+
+		GroupNum = (uint32_t) NextGroup + 1;
+
+		if (__atomic_load_n(&Group->Descriptor.FreeBlocks, __ATOMIC_RELAXED) < NumBlocks) continue;
+
+		BitMap* BlockBitMap = _GroupBlockBitMap(volume, Group);
+
+		if (BlockBitMap == 0)
+		{
+			*Error = FILE_CORRUPTED;
+			return -1;
+		}
+
+		if (Group == GoalGroup) Found = BitMap_FindZeroRunNear(BlockBitMap, GoalBlock - Group->Descriptor.FirstBlock, NumBlocks, Group->Descriptor.NumBlocks);
+		else Found = BitMap_FindZeroRun(BlockBitMap, NumBlocks, Group->Descriptor.NumBlocks);
+
+		if (Found >= 0) return (int32_t) (Group->Descriptor.FirstBlock + (uint32_t) Found);
+	}
+}
+
+bool _IsInline(INODE* FileInode)
+{
+	return (bool) (FileInode->FILE_BYTES == 0);
+}
+
+// An inline file gets its blocks mapped from an empty root, and its data written to the first of them. If that cannot
+// be done the file is left inline as it was.
+bool _GrowFile(VOLUME* volume, INODE* FileInode, uint64_t BlocksNeeded)
+{
+	uint64_t BlocksAllocated = FileInode->FILE_BYTES / volume->Properties.BlockSize;			// Number of blocks already allocated
+
+	if (BlocksAllocated >= BlocksNeeded) return TRUE;
+
+	// Cannot create new space to index into this address
+	if (BlocksNeeded > MAX_FILE_BLOCKS)
+	{
+		_SetError(volume, FILE_TOO_LARGE);
+		return FALSE;
+	}
+
+	bool 	 WasInline 	= _IsInline(FileInode);
+	BYTE 	 InlineData[INLINE_DATA_BYTES];
+	BYTE 	 FirstBlock[volume->Properties.BlockSize];
+
+	if (WasInline)
+	{
+		memcpy(InlineData, FileInode->INLINE_DATA, INLINE_DATA_BYTES);
+		memset(&FileInode->EXTENTS, 0, sizeof(ExtentRoot));
+	}
+
+	bool Grown = _AllocateFileBlocks(volume, FileInode, (uint32_t) (BlocksNeeded - BlocksAllocated));
+
+	if (Grown && WasInline)
+	{
+		uint32_t FirstBlockNum = 0;
+
+		memset(FirstBlock, 0, volume->Properties.BlockSize);
+		memcpy(FirstBlock, InlineData, INLINE_DATA_BYTES);
+
+		Grown = _MapFileBlock(volume, FileInode, 0, &FirstBlockNum, 0);
+
+		if (Grown && _WriteSector(volume, FirstBlock, FirstBlockNum) == FALSE)
+		{
+			_SetError(volume, FILE_NO_SPACE);
+			Grown = FALSE;
+		}
+	}
+
+	if (Grown == FALSE)
+	{
+		if (WasInline)
+		{
+			_FreeFileBlocks(volume, FileInode);
+			memcpy(FileInode->INLINE_DATA, InlineData, INLINE_DATA_BYTES);
+		}
+
+		return FALSE;
+	}
+
+	return TRUE;
+}
+
+// Appends NumBlocks blocks to the file. The last run is extended in place when the blocks right after it are free,
+// otherwise the longest free run (up to what is still needed) becomes a new extent. That run is looked for right after
+// the file's last block, or at the start of its inode's group for a file without blocks, so files stay clustered.
+// Runs are claimed with compare-and-swap; losing one to another allocation just means looking again.
+// The caller keeps the file within MAX_FILE_BLOCKS. Sets FILE_NO_SPACE, or FILE_CORRUPTED for a tree that cannot be read.
+bool _AllocateFileBlocks(VOLUME* volume, INODE* FileInode, uint32_t NumBlocks)
+{
+	if (volume->Groups == 0) exit(-1);
+
+	// A volume without room for the blocks fails straight away, without searching the groups for them
+	if (__atomic_load_n(&volume->Properties.FreeBlocks, __ATOMIC_RELAXED) < NumBlocks)
+	{
+		_SetError(volume, FILE_NO_SPACE);
+		return FALSE;
+	}
+
+	uint32_t GoalBlock = _GroupOfInode(volume, FileInode->INODE_NUM)->Descriptor.FirstBlock;
+	Extent	 LastExtent;
+
+	// The root of the tree lives in the inode, so the two are logged together
+	_MarkInodeAsDirty(volume, FileInode->INODE_NUM);
+
+	while (NumBlocks > 0)
+	{
+		uint32_t 	 RunStart  = 0;
+		uint32_t 	 RunLength = 0;
+		ExtentLookup HasLast   = ExtentTree_Last(volume->FileExtents, &FileInode->EXTENTS, &LastExtent);
+
+		if (HasLast == EXTENT_UNREADABLE)
+		{
+			_SetError(volume, FILE_CORRUPTED);
+			return FALSE;
+		}
+
+		if (HasLast == EXTENT_FOUND)
+		{
+			RunStart  = LastExtent.StartBlock + LastExtent.NumBlocks;
+			RunLength = _CountFreeBlocks(volume, RunStart, NumBlocks);
+			GoalBlock = RunStart;
+
+			if (RunLength > 0 && _ClaimBlocks(volume, RunStart, RunLength) == FALSE) continue;
+		}
+
+		if (RunLength == 0)
+		{
+			// Ask for the whole remainder in one run, settling for shorter runs if there isn't one
+			int32_t   FoundRun 	= -1;
+			FileError Error 	= FILE_NO_SPACE;
+			RunLength = NumBlocks;
+
+			while (RunLength > 0 && (FoundRun = _FindFreeBlocks(volume, GoalBlock, RunLength, &Error)) < 0 && Error == FILE_NO_SPACE)
+			{
+				RunLength /= 2;
+			}
+
+			if (FoundRun < 0)
+			{
+				_SetError(volume, Error);										// The disk is full, or a bitmap is damaged
+				return FALSE;
+			}
+
+			if (_ClaimBlocks(volume, (uint32_t) FoundRun, RunLength) == FALSE) continue;
+
+			RunStart = (uint32_t) FoundRun;
+		}
+
+		// A run that cannot be mapped (the tree needed a node and the disk is full) goes back
+		if (ExtentTree_Append(volume->FileExtents, &FileInode->EXTENTS, RunStart, RunLength) == FALSE)
+		{
+			_ReleaseBlocks(volume, RunStart, RunLength);
+			_SetError(volume, FILE_NO_SPACE);
+			return FALSE;
+		}
+
+		// Files are only ever grown through an open handle
+		_HoldChecksums(volume, RunStart, RunLength, TRUE);
+
+		FileInode->FILE_BYTES += (uint64_t) RunLength * volume->Properties.BlockSize;
+		NumBlocks -= RunLength;
+	}
+
+	return TRUE;
+}
+
+void _FreeFileBlocks(VOLUME* volume, INODE* FileInode)
+{
+	if (_IsInline(FileInode) == TRUE) return;									// Nothing but the inode to free
+
+	ExtentTree_Free(volume->FileExtents, &FileInode->EXTENTS);
+
+	FileInode->FILE_BYTES = 0;
+}
+
+// Looks the BlockIndex-th block of the file up in its extent tree. RunLength (if provided) gets
+// how many blocks, starting with the one in BlockNum, are contiguous on disk.
+bool _MapFileBlock(VOLUME* volume, INODE* FileInode, uint32_t BlockIndex, uint32_t* BlockNum, uint32_t* RunLength)
+{
+	// Callers never map past the blocks allocated, so a block the tree has no extent for is as corrupted as a node
+	// that cannot be read
+	if (ExtentTree_Map(volume->FileExtents, &FileInode->EXTENTS, BlockIndex, BlockNum, RunLength) != EXTENT_FOUND)
+	{
+		_SetError(volume, FILE_CORRUPTED);
+		return FALSE;
+	}
+
+	return TRUE;
+}
+
+bool _IsCompressed(INODE* FileInode)
+{
+	return (bool) ((FileInode->FILE_FLAGS & INODE_FLAG_COMPRESSED) != 0);
+}
+
+// Every cluster the read touches is decompressed whole, and the part wanted copied out. Anything past the clusters
+// stored reads as zeroes, as does an inline file past its inline data.
+int32_t _ReadClusters(VOLUME* volume, INODE* FileInode, BYTE* Buffer, uint32_t numBytes, uint64_t Offset)
+{
+	uint32_t ClusterBytes = COMPRESSION_CLUSTER_BLOCKS * volume->Properties.BlockSize;
+
+	if ((Offset + numBytes + ClusterBytes - 1) / ClusterBytes * COMPRESSION_CLUSTER_BLOCKS > MAX_FILE_BLOCKS)
+	{
+		_SetError(volume, FILE_TOO_LARGE);
+		return FALSE;
+	}
+
+	if (_IsInline(FileInode) == TRUE)
+	{
+		uint32_t InlineBytes = (Offset < INLINE_DATA_BYTES) ? (uint32_t) (INLINE_DATA_BYTES - Offset) : 0;
+		if (InlineBytes > numBytes) InlineBytes = numBytes;
+
+		if (InlineBytes > 0) memcpy(Buffer, &FileInode->INLINE_DATA[Offset], InlineBytes);
+		memset(&Buffer[InlineBytes], 0, numBytes - InlineBytes);
+
+		return TRUE;
+	}
+
+	BYTE* 	 Cluster 	= (BYTE*) malloc(ClusterBytes);
+	BYTE* 	 Stored 	= (BYTE*) malloc(ClusterBytes);
+	uint64_t Position 	= Offset;
+	uint32_t Remaining 	= numBytes;
+	bool 	 Read 		= (bool) (Cluster != 0 && Stored != 0);
+
+	while (Read && Remaining > 0)
+	{
+		uint32_t IntraClusterIndex 	= (uint32_t) (Position % ClusterBytes);
+		uint32_t BytesDone 			= ClusterBytes - IntraClusterIndex;
+
+		if (BytesDone > Remaining) BytesDone = Remaining;
+
+		Read = _LoadCluster(volume, FileInode, (uint32_t) (Position / ClusterBytes), Cluster, Stored);
+		if (Read) memcpy(Buffer, &Cluster[IntraClusterIndex], BytesDone);
+
+		Buffer 		+= BytesDone;
+		Position 	+= BytesDone;
+		Remaining 	-= BytesDone;
+	}
+
+	free(Cluster);
+	free(Stored);
+
+	return Read;
+}
+
+// Every cluster the write touches is read, patched and stored again; one it covers completely is not read at all.
+// Clusters between the end of the file and the write are stored as zeroes, so a compressed file never has holes in
+// its tree. An inline file's data goes to its first cluster, and stays inline if that cannot be stored.
+bool _WriteClusters(VOLUME* volume, INODE* FileInode, BYTE* Buffer, uint32_t numBytes, uint64_t Offset)
+{
+	uint32_t ClusterBytes 	= COMPRESSION_CLUSTER_BLOCKS * volume->Properties.BlockSize;
+	uint64_t End 			= Offset + numBytes;
+	uint64_t EndCluster 	= (End + ClusterBytes - 1) / ClusterBytes;
+	uint64_t NumClusters 	= FileInode->FILE_BYTES / ClusterBytes;
+	uint64_t ClusterNum 	= Offset / ClusterBytes;
+
+	if (EndCluster * COMPRESSION_CLUSTER_BLOCKS > MAX_FILE_BLOCKS)
+	{
+		_SetError(volume, FILE_TOO_LARGE);
+		return FALSE;
+	}
+
+	BYTE* 	 Cluster 	= (BYTE*) malloc(ClusterBytes);
+	BYTE* 	 Stored 	= (BYTE*) malloc(ClusterBytes);
+	bool 	 WasInline 	= _IsInline(FileInode);
+	BYTE 	 InlineData[INLINE_DATA_BYTES];
+	uint64_t Position 	= Offset;												// End of the part of the write stored so far
+	bool 	 Written 	= (bool) (Cluster != 0 && Stored != 0);
+
+	if (Written == FALSE) _SetError(volume, FILE_INIT_FAILED);
+
+	if (Written && WasInline)
+	{
+		memcpy(InlineData, FileInode->INLINE_DATA, INLINE_DATA_BYTES);
+		memset(&FileInode->EXTENTS, 0, sizeof(ExtentRoot));
+	}
+
+	if (ClusterNum > NumClusters) ClusterNum = NumClusters;
+
+	for (; Written && ClusterNum < EndCluster; ClusterNum++)
+	{
+		uint64_t ClusterStart 	= ClusterNum * ClusterBytes;
+		uint64_t From 			= (Offset > ClusterStart) ? Offset : ClusterStart;
+		uint64_t To 			= (End < ClusterStart + ClusterBytes) ? End : ClusterStart + ClusterBytes;
+
+		if (ClusterNum >= NumClusters || From >= To || To - From == ClusterBytes) memset(Cluster, 0, ClusterBytes);
+		else Written = _LoadCluster(volume, FileInode, (uint32_t) ClusterNum, Cluster, Stored);
+
+		if (ClusterNum == 0 && WasInline) memcpy(Cluster, InlineData, INLINE_DATA_BYTES);
+		if (From < To) memcpy(&Cluster[From - ClusterStart], &Buffer[From - Offset], To - From);
+
+		if (Written) Written = _StoreCluster(volume, FileInode, (uint32_t) ClusterNum, Cluster, Stored);
+		if (Written && From < To) Position = To;
+	}
+
+	if (WasInline && _IsInline(FileInode) == TRUE) memcpy(FileInode->INLINE_DATA, InlineData, INLINE_DATA_BYTES);
+
+	// Whatever made it to the disk counts
+	if (Position > FileInode->BYTES_USED) FileInode->BYTES_USED = Position;
+	FileInode->LATEST_CURSOR = Position;
+
+	free(Cluster);
+	free(Stored);
+
+	return Written;
+}
+
+// A cluster stored in fewer blocks than it covers is compressed, and starts with the length of its compressed data
+bool _LoadCluster(VOLUME* volume, INODE* FileInode, uint32_t ClusterNum, BYTE* Cluster, BYTE* Stored)
+{
+	uint32_t 	 ClusterBytes = COMPRESSION_CLUSTER_BLOCKS * volume->Properties.BlockSize;
+	uint32_t 	 PackedBytes  = 0;
+	Extent 	 	 Found;
+	ExtentLookup Result 	  = ExtentTree_Find(volume->FileExtents, &FileInode->EXTENTS, ClusterNum * COMPRESSION_CLUSTER_BLOCKS, &Found);
+
+	if (Result == EXTENT_UNMAPPED)
+	{
+		memset(Cluster, 0, ClusterBytes);										// Past the clusters stored
+		return TRUE;
+	}
+
+	if (Result == EXTENT_UNREADABLE)
+	{
+		_SetError(volume, FILE_CORRUPTED);
+		return FALSE;
+	}
+
+	uint32_t StoredBlocks = EXTENT_STORED_BLOCKS(&Found);
+
+	if (StoredBlocks >= COMPRESSION_CLUSTER_BLOCKS) return _ReadRun(volume, Cluster, Found.StartBlock, COMPRESSION_CLUSTER_BLOCKS);
+
+	if (_ReadRun(volume, Stored, Found.StartBlock, StoredBlocks) == FALSE) return FALSE;
+
+	memcpy(&PackedBytes, Stored, sizeof(PackedBytes));
+
+	if (PackedBytes > StoredBlocks * volume->Properties.BlockSize - sizeof(PackedBytes) ||
+		Compressor_Decompress(&Stored[sizeof(PackedBytes)], PackedBytes, Cluster, ClusterBytes) == FALSE)
+	{
+		_SetError(volume, FILE_CORRUPTED);
+		return FALSE;
+	}
+
+	return TRUE;
+}
+
+// The cluster is kept compressed if that saves at least a block, and as it is otherwise. It is rewritten where it
+// is while it still fits there (handing back the blocks it no longer needs). One that has grown takes the blocks
+// right after it if they are free, or moves to a new run near its old one. A new cluster goes after the file's last.
+bool _StoreCluster(VOLUME* volume, INODE* FileInode, uint32_t ClusterNum, BYTE* Cluster, BYTE* Stored)
+{
+	uint32_t BlockSize 		= volume->Properties.BlockSize;
+	uint32_t ClusterBytes 	= COMPRESSION_CLUSTER_BLOCKS * BlockSize;
+	uint32_t FileBlock 		= ClusterNum * COMPRESSION_CLUSTER_BLOCKS;
+	uint32_t PackedBytes 	= Compressor_Compress(Cluster, ClusterBytes, &Stored[sizeof(uint32_t)], (COMPRESSION_CLUSTER_BLOCKS - 1) * BlockSize - sizeof(uint32_t));
+	uint32_t StoredBlocks 	= COMPRESSION_CLUSTER_BLOCKS;
+	BYTE* 	 Data 			= Cluster;
+	Extent 	 Old;
+	ExtentLookup Lookup 	= ExtentTree_Find(volume->FileExtents, &FileInode->EXTENTS, FileBlock, &Old);
+
+	// Mapping the cluster again would leave two extents for it
+	if (Lookup == EXTENT_UNREADABLE)
+	{
+		_SetError(volume, FILE_CORRUPTED);
+		return FALSE;
+	}
+
+	bool 	 Exists 	= (bool) (Lookup == EXTENT_FOUND);
+	uint32_t OldBlocks 	= (Exists) ? EXTENT_STORED_BLOCKS(&Old) : 0;
+
+	if (PackedBytes > 0)
+	{
+		StoredBlocks = (sizeof(PackedBytes) + PackedBytes + BlockSize - 1) / BlockSize;
+		Data 		 = Stored;
+
+		memcpy(Stored, &PackedBytes, sizeof(PackedBytes));
+		memset(&Stored[sizeof(PackedBytes) + PackedBytes], 0, StoredBlocks * BlockSize - sizeof(PackedBytes) - PackedBytes);
+	}
+
+	// The root of the tree lives in the inode, so the two are logged together
+	_MarkInodeAsDirty(volume, FileInode->INODE_NUM);
+
+	if (Exists && OldBlocks >= StoredBlocks)
+	{
+		if (_WriteRun(volume, Data, Old.StartBlock, StoredBlocks) == FALSE) return FALSE;
+
+		if (StoredBlocks < OldBlocks)
+		{
+			if (ExtentTree_Remap(volume->FileExtents, &FileInode->EXTENTS, FileBlock, Old.StartBlock, StoredBlocks) == FALSE) exit(-1);
+			_ReleaseBlocks(volume, Old.StartBlock + StoredBlocks, OldBlocks - StoredBlocks);
+		}
+
+		return TRUE;
+	}
+
+	uint32_t RunStart 	= 0;
+	uint32_t GoalBlock 	= _GroupOfInode(volume, FileInode->INODE_NUM)->Descriptor.FirstBlock;
+	bool 	 Extended 	= FALSE;
+	Extent 	 LastExtent;
+
+	if (Exists) GoalBlock = Old.StartBlock;
+	else if ((Lookup = ExtentTree_Last(volume->FileExtents, &FileInode->EXTENTS, &LastExtent)) == EXTENT_FOUND) GoalBlock = LastExtent.StartBlock + EXTENT_STORED_BLOCKS(&LastExtent);
+
+	// The new cluster would be mapped through the same nodes
+	if (Lookup == EXTENT_UNREADABLE)
+	{
+		_SetError(volume, FILE_CORRUPTED);
+		return FALSE;
+	}
+
+	if (Exists && _CountFreeBlocks(volume, Old.StartBlock + OldBlocks, StoredBlocks - OldBlocks) == StoredBlocks - OldBlocks)
+	{
+		Extended = _ClaimBlocks(volume, Old.StartBlock + OldBlocks, StoredBlocks - OldBlocks);
+		RunStart = Old.StartBlock;
+	}
+
+	if (Extended == FALSE)
+	{
+		int32_t   FoundRun 	= -1;
+		FileError Error 	= FILE_OK;
+
+		// Runs are claimed with compare-and-swap; losing one to another allocation just means looking again
+		while ((FoundRun = _FindFreeBlocks(volume, GoalBlock, StoredBlocks, &Error)) >= 0 && _ClaimBlocks(volume, (uint32_t) FoundRun, StoredBlocks) == FALSE);
+
+		if (FoundRun < 0)
+		{
+			_SetError(volume, Error);
+			return FALSE;
+		}
+
+		RunStart = (uint32_t) FoundRun;
+	}
+
+	_HoldChecksums(volume, RunStart, StoredBlocks, TRUE);
+
+	if (_WriteRun(volume, Data, RunStart, StoredBlocks) == FALSE)
+	{
+		if (Extended) _ReleaseBlocks(volume, Old.StartBlock + OldBlocks, StoredBlocks - OldBlocks);
+		else _ReleaseBlocks(volume, RunStart, StoredBlocks);
+
+		return FALSE;
+	}
+
+	if (Exists)
+	{
+		if (ExtentTree_Remap(volume->FileExtents, &FileInode->EXTENTS, FileBlock, RunStart, StoredBlocks) == FALSE) exit(-1);
+		if (Extended == FALSE) _ReleaseBlocks(volume, Old.StartBlock, OldBlocks);
+
+		return TRUE;
+	}
+
+	// A cluster that cannot be mapped (the tree needed a node and the disk is full) goes back
+	if (ExtentTree_AppendCluster(volume->FileExtents, &FileInode->EXTENTS, RunStart, COMPRESSION_CLUSTER_BLOCKS, StoredBlocks) == FALSE)
+	{
+		_ReleaseBlocks(volume, RunStart, StoredBlocks);
+		_SetError(volume, FILE_NO_SPACE);
+		return FALSE;
+	}
+
+	FileInode->FILE_BYTES += ClusterBytes;
+
+	return TRUE;
+}
+
+bool _ReadTreeNode(void* Context, BYTE* Buffer, uint32_t BlockNum)
+{
+	return _ReadSector((VOLUME*) Context, Buffer, BlockNum);
+}
+
+bool _LogTreeNode(void* Context, BYTE* Buffer, uint32_t BlockNum)
+{
+	return _LogMetadata((VOLUME*) Context, Buffer, BlockNum);
+}
+
+// Tree nodes go close to the blocks they map
+int64_t _AllocateTreeNode(void* Context, uint32_t GoalBlock)
+{
+	VOLUME*   volume 		= (VOLUME*) Context;
+	int32_t   FoundBlock 	= -1;
+	FileError Error 		= FILE_OK;
+
+	while ((FoundBlock = _FindFreeBlocks(volume, GoalBlock, 1, &Error)) >= 0)
+	{
+		if (_ClaimBlocks(volume, (uint32_t) FoundBlock, 1) == TRUE) return FoundBlock;
+	}
+
+	return -1;
+}
+
+void _ReleaseTreeRun(void* Context, uint32_t FirstBlock, uint32_t NumBlocks)
+{
+	_ReleaseBlocks((VOLUME*) Context, FirstBlock, NumBlocks);
 }
 
-// Precondition: Called BEFORE OS_Init! Make sure that OS_Init has not been called before this has been called!
+// Block group operations
 
-bool OSFS_Format()
+// The descriptor table takes GroupTableBlocks blocks, with no descriptor straddling two of them; each group's bitmaps
+// are one block apiece. Whatever was read in before a damaged block is left for _FreeBlockGroups.
+bool _LoadBlockGroups(VOLUME* volume)
 {
-	if (DiskInitialized == TRUE) return FALSE;
+	uint32_t BlockSize 		= volume->Properties.BlockSize;
+	uint32_t PerTableBlock 	= BlockSize / sizeof(struct nRTOS_GroupDescriptor);
+	uint32_t NumGroups 		= volume->Properties.NumGroups;
+	uint32_t GroupIterator 	= 0;
+
+	if (NumGroups == 0 || NumGroups > volume->Properties.GroupTableBlocks * PerTableBlock) return FALSE;
 
-	const struct nRTOS_SuperBlock PermanentSuperBlock = {MAX_INODE_COUNT, MAX_BLOCKS_TRACKED, INODE_BLOCK_START_NUM};
+	BYTE* Table 		= (BYTE*) malloc((size_t) volume->Properties.GroupTableBlocks * BlockSize);
+	volume->Groups 		= (BLOCK_GROUP*) calloc(NumGroups, sizeof(BLOCK_GROUP));
+	volume->FullGroups 	= BitMap_Init((NumGroups / WORD_SIZE) + 1);
 
-	// Initialize the disk with the SuperBlock parameters so we know what exactly we're dealing with
-	memset(&tempBlock, 0, SECTOR_SIZE);
-	memcpy(&tempBlock, &PermanentSuperBlock, sizeof(struct nRTOS_SuperBlock));
+	if (Table == 0 || volume->Groups == 0 || volume->FullGroups == 0) exit(-1);
 
-	if (_WriteToFile((BYTE*) &tempBlock, SUPER_BLOCK_SECTOR_NUM) == FALSE)
+	bool Intact = TRUE;
+
+	// Every read is checked from here on, the group table's included
+	for (GroupIterator = 0; GroupIterator < NumGroups && Intact; GroupIterator++) Intact = _LoadChecksums(volume, GroupIterator);
+
+	if (Intact == TRUE) Intact = _ReadRun(volume, Table, volume->Properties.GroupTableBlock, volume->Properties.GroupTableBlocks);
+
+	if (Intact == FALSE)
 	{
-		exit(-1);
+		free(Table);
+		return FALSE;
 	}
 
-	memset(&tempBlock, 0, SECTOR_SIZE);
+	for (GroupIterator = 0; GroupIterator < NumGroups; GroupIterator++)
+	{
+		BLOCK_GROUP* Group = &volume->Groups[GroupIterator];
+		BYTE* TableBlock = &Table[(size_t) (GroupIterator / PerTableBlock) * BlockSize];
+
+		memcpy(&Group->Descriptor, &TableBlock[(GroupIterator % PerTableBlock) * sizeof(struct nRTOS_GroupDescriptor)], sizeof(struct nRTOS_GroupDescriptor));
+
+		Group->InodeBitMap = BitMap_Init((volume->Properties.InodesPerGroup / WORD_SIZE) + 1);
 
-	DataBitMap 	= BitMap_Init(DATA_BITMAP_SIZE_IN_WORDS);
-	InodeBitMap 	= BitMap_Init(INODE_BITMAP_SIZE_IN_WORDS);
+		if (Group->InodeBitMap == 0) exit(-1);
 
-	if (DataBitMap == 0 || InodeBitMap == 0) exit(-1);
+		if (Group->Descriptor.FreeBlocks == 0) BitMap_SetBit(volume->FullGroups, GroupIterator);
+	}
+
+	free(Table);
 
-	// Store the data bit map into the proper area
-	BitMap_SetBit(DataBitMap, SUPER_BLOCK_SECTOR_NUM); 				// The superblock location is taken.
-	BitMap_SetBit(DataBitMap, INODE_BITMAP_SECTOR_NUM);				// The inode bitmap block is taken.
-	BitMap_SetBit(DataBitMap, DATA_BITMAP_SECTOR_NUM);				// The data bitmap block is taken.
-	BitMap_SetBit(DataBitMap, MAX_INODE_COUNT);						// Debugging instrument
+	BYTE Sector[BlockSize];
 
-	int inodeSectors = 0;
-	for (inodeSectors = 0; inodeSectors < TOTAL_INODE_SECTORS; inodeSectors++)
+	// Block bitmaps are left on the store until they are needed, so mounting a large volume only reads the checksum
+	// tables, the group table and the inode bitmaps
+	for (GroupIterator = 0; GroupIterator < NumGroups; GroupIterator++)
 	{
-		BitMap_SetBit(DataBitMap, INODE_BLOCK_START_NUM + inodeSectors);		// Mark all the inode sectors as occupied.
+		BLOCK_GROUP* Group = &volume->Groups[GroupIterator];
+
+		if (_ReadSector(volume, Sector, Group->Descriptor.InodeBitMapBlock) == FALSE) return FALSE;
+		if (_TranscribeBitMap(Sector, Group->InodeBitMap, BlockSize) == FALSE) return FALSE;
 	}
 
-	//Since the bitmap has a dynamic array, we need to transcribe it manually
-	//CurrentBlock.SizeInBytes = sizeof(BitMap) + (DATA_BITMAP_SIZE_IN_WORDS * sizeof(uint32_t)) - sizeof(uint32_t*); // everything but the pointer
-	memset(&tempBlock, 0, SECTOR_SIZE);
-	memcpy(&tempBlock[0], DataBitMap, sizeof(BitMap) - sizeof(uint32_t*)); // Store everything but the pointer.
+	return TRUE;
+}
 
-	uint32_t SizeUsed = sizeof(BitMap) - sizeof(uint32_t*);	// The amount of sized used so far in the struct
+void _FreeBlockGroups(VOLUME* volume)
+{
+	if (volume->Groups == 0) return;
 
-	memcpy(((&tempBlock[SizeUsed])), DataBitMap->dataarray, DATA_BITMAP_SIZE_IN_WORDS * sizeof(uint32_t)); // Copy over the dynamic data
+	uint32_t GroupIterator = 0;
 
-	if (_WriteToFile((BYTE*) &tempBlock, DATA_BITMAP_SECTOR_NUM) == FALSE)
+	for (GroupIterator = 0; GroupIterator < volume->Properties.NumGroups; GroupIterator++)
 	{
-			exit(-1);
-	}
+		if (volume->Groups[GroupIterator].BlockBitMap != 0) BitMap_DeInit(volume->Groups[GroupIterator].BlockBitMap);
+		if (volume->Groups[GroupIterator].InodeBitMap != 0) BitMap_DeInit(volume->Groups[GroupIterator].InodeBitMap);
+		if (volume->Groups[GroupIterator].DirtyChecksums != 0) BitMap_DeInit(volume->Groups[GroupIterator].DirtyChecksums);
+		if (volume->Groups[GroupIterator].OpenBlocks != 0) BitMap_DeInit(volume->Groups[GroupIterator].OpenBlocks);
 
-	memset(&tempBlock, 0, SECTOR_SIZE);
+		free(volume->Groups[GroupIterator].Checksums);
+		free(volume->Groups[GroupIterator].CommittedChecksums);
+	}
 
-	// Store the inode bit map into the proper area
+	free(volume->Groups);
+	volume->Groups = 0;
 
-	if (DataBitMap == 0 || InodeBitMap == 0) exit(-1);
+	if (volume->FullGroups != 0) BitMap_DeInit(volume->FullGroups);
+	volume->FullGroups = 0;
+}
 
-	// Since the bitmap has a dynamic array, we need to transcribe it manually
-	//CurrentBlock.SizeInBytes = sizeof(BitMap) + (INODE_BITMAP_SIZE_IN_WORDS * sizeof(uint32_t)) - sizeof(uint32_t*); // everything but the pointer
+BLOCK_GROUP* _GroupOfBlock(VOLUME* volume, uint32_t BlockNum)
+{
+	if (BlockNum >= volume->Properties.NumDataBlocks) return 0;
 
-	memcpy(&tempBlock[0], InodeBitMap, sizeof(BitMap) - sizeof(uint32_t*)); // Store everything but the pointer.
+	return &volume->Groups[BlockNum / volume->Properties.BlocksPerGroup];
+}
 
-	SizeUsed = sizeof(BitMap) - sizeof(uint32_t*);	// The amount of sized used so far in the struct
+BLOCK_GROUP* _GroupOfInode(VOLUME* volume, uint32_t InodeNum)
+{
+	if (InodeNum >= volume->Properties.NumInodes) return 0;
 
-	memcpy(((&tempBlock[SizeUsed])), InodeBitMap->dataarray, INODE_BITMAP_SIZE_IN_WORDS * sizeof(uint32_t)); // Copy over the dynamic data
+	return &volume->Groups[InodeNum / volume->Properties.InodesPerGroup];
+}
 
-	if (_WriteToFile((BYTE*) &tempBlock, INODE_BITMAP_SECTOR_NUM) == FALSE)
-	{
-			exit(-1);
-	}
+void _NoteGroupChanged(BLOCK_GROUP* Group)
+{
+	__atomic_store_n(&Group->Dirty, TRUE, __ATOMIC_RELAXED);
+}
 
-	memset(&tempBlock, 0, SECTOR_SIZE);
+// Double-checked: once published, a bitmap stays put until the volume is unmounted. One that does not check out is
+// never published, so every allocation that needs it fails.
+BitMap* _GroupBlockBitMap(VOLUME* volume, BLOCK_GROUP* Group)
+{
+	BitMap* BlockBitMap = __atomic_load_n(&Group->BlockBitMap, __ATOMIC_ACQUIRE);
 
-	// Delete the allocations
-	BitMap_DeInit(DataBitMap);
-	BitMap_DeInit(InodeBitMap);
+	if (BlockBitMap != 0) return BlockBitMap;
 
+	pthread_mutex_lock(&volume->BlockBitMapLock);
 
-	// Start creating and storing the inodes (will take a while)
-	uint32_t InodeIterator = 0;
-	memset(&CurrentNode, 0, sizeof(INODE));
-	memset(&tempBlock, 0, SECTOR_SIZE);
+	BlockBitMap = Group->BlockBitMap;
 
-	for (InodeIterator = 0; InodeIterator < TOTAL_INODE_SECTORS; InodeIterator++)
+	if (BlockBitMap == 0)
 	{
-		uint32_t InsideIterator = 0;
-		for(InsideIterator = 0; InsideIterator < INODES_PER_SECTOR; InsideIterator++)
+		BYTE Sector[volume->Properties.BlockSize];
+
+		BlockBitMap = BitMap_Init((volume->Properties.BlocksPerGroup / WORD_SIZE) + 1);
+
+		if (BlockBitMap == 0) exit(-1);
+
+		// The bitmap has not changed since the last mount, so its home is current once the journal has been replayed
+		if (_ReadSector(volume, Sector, Group->Descriptor.BlockBitMapBlock) == FALSE || _TranscribeBitMap(Sector, BlockBitMap, volume->Properties.BlockSize) == FALSE)
 		{
-			CurrentNode.INODE_NUM = (INODES_PER_SECTOR * InodeIterator) + InsideIterator;
-			memcpy(&tempBlock[InsideIterator * sizeof(INODE)], &CurrentNode, sizeof(INODE));
-			memset(&CurrentNode, 0, sizeof(INODE));
+			BitMap_DeInit(BlockBitMap);
+			BlockBitMap = 0;
+			_SetError(volume, FILE_CORRUPTED);
 		}
-
-		if (_WriteToFile((BYTE*) &tempBlock, INODE_BLOCK_START_NUM + InodeIterator) == FALSE)	// Write to the proper inode sector location
+		else
 		{
-			exit(-1);
+			__atomic_store_n(&Group->BlockBitMap, BlockBitMap, __ATOMIC_RELEASE);
 		}
-
-		memset(&tempBlock, 0, SECTOR_SIZE);
 	}
 
-	return TRUE;
+	pthread_mutex_unlock(&volume->BlockBitMapLock);
 
+	return BlockBitMap;
 }
 
-FileError RecentError;
-
-FileError OSFS_GetError()
-{
-	return RecentError;
-}
-MYFILE* OSFS_Create(char* fileName)
+// Same protocol as the bitmap summaries: a group marked full is looked at again, in case blocks were released before
+// the mark went in.
+void _NoteFreeBlocks(VOLUME* volume, BLOCK_GROUP* Group, uint32_t OldFree, uint32_t NewFree)
 {
-	if (strlen(fileName) > MAX_FILE_NAME_CHARS)
-	{
-		RecentError = FILE_NAME_TOO_LONG;
-		return 0;
-	}
+	uint32_t GroupNum = (uint32_t) (Group - volume->Groups);
 
-	INODE* newFile = (INODE*) malloc(sizeof(INODE) * 1);
+	if (NewFree == 0 && OldFree != 0)
+	{
+		BitMap_SetBit(volume->FullGroups, GroupNum);
 
-	if (newFile == 0)
+		if (__atomic_load_n(&Group->Descriptor.FreeBlocks, __ATOMIC_ACQUIRE) != 0) BitMap_ClearBit(volume->FullGroups, GroupNum);
+	}
+	else if (OldFree == 0 && NewFree != 0)
 	{
-		RecentError = FILE_INIT_FAILED;
-		return 0;			// Out of memory, cannot proceed
+		BitMap_ClearBit(volume->FullGroups, GroupNum);
 	}
+}
+
+// Put the changed groups into the running journal transaction. The descriptor table blocks holding them go too, as they have their free counts.
+void _LogBlockGroups(VOLUME* volume)
+{
+	if (volume->Groups == 0) exit(-1);
+
+	uint32_t BlockSize 		= volume->Properties.BlockSize;
+	uint32_t PerTableBlock 	= BlockSize / sizeof(struct nRTOS_GroupDescriptor);
+	BYTE 	 Sector[BlockSize];
+	uint32_t TableIterator 	= 0;
+	bool 	 TotalsChanged 	= FALSE;
 
-	if (_GetInodeFromFileName(fileName) > 0)
+	for (TableIterator = 0; TableIterator < volume->Properties.GroupTableBlocks; TableIterator++)
 	{
-		RecentError = FILE_ALREADY_EXISTS;
-		return 0;	// We cannot create the same file name twice
-	}
+		uint32_t FirstGroup 	= TableIterator * PerTableBlock;
+		uint32_t EndGroup 		= (FirstGroup + PerTableBlock < volume->Properties.NumGroups) ? FirstGroup + PerTableBlock : volume->Properties.NumGroups;
+		uint32_t GroupIterator 	= 0;
+		bool 	 AnyChanged 	= FALSE;
 
-	// Initialize the new Inode with the proper items
-	memcpy(newFile->FILE_NAME, fileName, strlen(fileName) * sizeof(char));
-	newFile->FILE_BYTES = SECTOR_SIZE;	// Every file starts with 512 bytes of data
-	newFile->BYTES_USED  = 0;
-	newFile->LATEST_CURSOR = 0;
-	uint32_t BlockToAssign = _GetNextFreeBlock();
+		for (GroupIterator = FirstGroup; GroupIterator < EndGroup; GroupIterator++)
+		{
+			BLOCK_GROUP* Group = &volume->Groups[GroupIterator];
 
-	_MarkBlockAsOccupied(BlockToAssign);
-	newFile->BLOCKS_USED[(newFile->FILE_BYTES/SECTOR_SIZE) - 1] = BlockToAssign; // if 512, index 0 gets new block. If 1024, index 1 does.
+			if (Group->Dirty == FALSE) continue;
 
-	uint32_t InodeNumToAssign = _GetNextFreeInode();
-	_MarkInodeAsOccupied(InodeNumToAssign);
+			// A block bitmap never read in has not changed either
+			if (Group->BlockBitMap != 0)
+			{
+				_SerializeBitMap(Group->BlockBitMap, Sector, BlockSize);
 
-	newFile->INODE_NUM = InodeNumToAssign;
+				if (_LogMetadata(volume, Sector, Group->Descriptor.BlockBitMapBlock) == FALSE)
+				{
+						exit(-1);
+				}
+			}
 
-	_FlushBitMapToDisk();
+			// Store the inode bit map into the proper area
+			_SerializeBitMap(Group->InodeBitMap, Sector, BlockSize);
 
-	_UpdateNonVolatileInodeCopy(InodeNumToAssign, newFile);
+			if (_LogMetadata(volume, Sector, Group->Descriptor.InodeBitMapBlock) == FALSE)
+			{
+					exit(-1);
+			}
 
+			Group->Dirty = FALSE;
+			AnyChanged = TRUE;
+		}
 
-	MYFILE* fileToReturn = (MYFILE*) malloc(sizeof(MYFILE) * 1);
+		if (AnyChanged == FALSE) continue;
 
-	if (fileToReturn == 0)
-	{
-		RecentError = FILE_INIT_FAILED;
-		free(newFile);
-		return 0;
+		memset(Sector, 0, BlockSize);
+
+		for (GroupIterator = FirstGroup; GroupIterator < EndGroup; GroupIterator++)
+		{
+			memcpy(&Sector[(GroupIterator - FirstGroup) * sizeof(struct nRTOS_GroupDescriptor)], &volume->Groups[GroupIterator].Descriptor, sizeof(struct nRTOS_GroupDescriptor));
+		}
+
+		if (_LogMetadata(volume, Sector, volume->Properties.GroupTableBlock + TableIterator) == FALSE) exit(-1);
+
+		TotalsChanged = TRUE;
 	}
 
-	fileToReturn->FileInode = newFile;
+	if (TotalsChanged == FALSE) return;
 
-	RecentError = FILE_OK;
+	// The superblock's free counts go into the same transaction as the descriptors they add up
+	volume->Properties.Checksum = _SuperBlockChecksum(&volume->Properties);
 
-	return fileToReturn;
+	memset(Sector, 0, BlockSize);
+	memcpy(Sector, &volume->Properties, sizeof(struct nRTOS_SuperBlock));
+
+	if (_LogMetadata(volume, Sector, SUPER_BLOCK_SECTOR_NUM) == FALSE) exit(-1);
 }
 
-MYFILE* OSFS_Open(char* fileName)
+// Checksums
+
+// A block of table is its entries followed by the checksum of the entries
+uint32_t _ChecksumsPerBlock(uint32_t BlockSize)
 {
-	INODE* createdFile = (INODE*) malloc(sizeof(INODE) * 1);
+	return (BlockSize / sizeof(uint32_t)) - 1;
+}
 
-	if (createdFile == 0)
-	{
-		RecentError = FILE_INIT_FAILED;
-		return 0;	// Not enough memory to initialize anything, so we cannot do anything
-	}
+// Worked out from the superblock alone, as the tables are needed to read the group descriptors themselves
+uint32_t _ChecksumTableHome(VOLUME* volume, uint32_t GroupNum)
+{
+	if (GroupNum == 0) return volume->Properties.ChecksumStartBlock;
 
-	// Get the proper inode associated with this filename
-	int32_t associatedInode = _GetInodeFromFileName(fileName);
+	return (GroupNum * volume->Properties.BlocksPerGroup) + 2 + volume->Properties.InodeBlocksPerGroup;
+}
 
-	if (associatedInode == -1)
-	{
-		RecentError = FILE_DOES_NOT_EXIST;
-		return 0;
-	}
+bool _IsSelfChecked(VOLUME* volume, uint64_t BlockNum)
+{
+	if (BlockNum == SUPER_BLOCK_SECTOR_NUM) return TRUE;
+	if (BlockNum >= volume->Properties.JournalStartBlock && BlockNum < volume->Properties.JournalStartBlock + volume->Properties.JournalBlocks) return TRUE;
 
-	_ReadInodeFromNonVolatileMemory(associatedInode, createdFile);
+	uint32_t TableHome = _ChecksumTableHome(volume, (uint32_t) (BlockNum / volume->Properties.BlocksPerGroup));
 
-	MYFILE* returnFile = (MYFILE*) malloc(sizeof(INODE) * 1);
+	return (bool) (BlockNum >= TableHome && BlockNum < TableHome + volume->Properties.ChecksumBlocksPerGroup);
+}
 
-	returnFile->FileInode = createdFile;
+// The tables only become resident with the block groups, so nothing is checked while the store is formatted or
+// its journal replayed (the replay brings the tables up to date along with everything else)
+uint32_t* _ChecksumEntry(VOLUME* volume, uint64_t BlockNum)
+{
+	if (volume->Groups == 0 || BlockNum >= volume->Properties.NumDataBlocks) return 0;
+	if (_IsSelfChecked(volume, BlockNum) == TRUE) return 0;
 
-	RecentError = FILE_OK;
+	uint32_t* Checksums = volume->Groups[BlockNum / volume->Properties.BlocksPerGroup].Checksums;
 
-	// TODO: Read the data chunks into memory as well
+	if (Checksums == 0) return 0;
 
-	return returnFile;
+	return &Checksums[BlockNum % volume->Properties.BlocksPerGroup];
 }
 
-// 	Reads the specified amount of bytes from the file into the provided buffer. Offset allows specification of where in file to read from.
-// 	Parameters:
-//		fileDescriptor: 	FILE structure pointer provided by OSFS_Create
-//		Buffer:			Buffer to write the file data to
-//		numBytes:		Number of bytes to read from the file and into the buffer
-//		Offset:			Byte number in file to read from
-int32_t OSFS_Read(MYFILE* fileDescriptor, BYTE* Buffer, uint32_t numBytes, uint32_t Offset)
+// The table has not changed since the last mount, so its home is current once the journal has been replayed
+bool _LoadChecksums(VOLUME* volume, uint32_t GroupNum)
 {
-	if (fileDescriptor == 0 || Buffer==0 || numBytes==0) return FALSE;			// Invalid/useless parameters
+	BLOCK_GROUP* Group 		= &volume->Groups[GroupNum];
+	uint32_t BlockSize 		= volume->Properties.BlockSize;
+	uint32_t TableBlocks 	= volume->Properties.ChecksumBlocksPerGroup;
+	uint32_t PerBlock 		= _ChecksumsPerBlock(BlockSize);
+	BYTE* 	 Table 			= (BYTE*) malloc((size_t) TableBlocks * BlockSize);
+	uint32_t* Checksums 	= (uint32_t*) malloc((size_t) TableBlocks * PerBlock * sizeof(uint32_t));
+	uint32_t TableIterator 	= 0;
 
-	INODE* FileInode = fileDescriptor->FileInode;
+	Group->DirtyChecksums 	= BitMap_Init((TableBlocks / WORD_SIZE) + 1);
+	Group->OpenBlocks 		= BitMap_Init((volume->Properties.BlocksPerGroup / WORD_SIZE) + 1);
 
-	if (FileInode == 0) return FALSE;											// Invalid/corrupted Inode
+	if (Table == 0 || Checksums == 0 || Group->DirtyChecksums == 0 || Group->OpenBlocks == 0) exit(-1);
 
-	uint32_t BlockListIndex = Offset / SECTOR_SIZE;							// If offset < 512, we need block 0. If < 1024, we need block 1, etc.
-	uint32_t BlocksAllocated = FileInode->FILE_BYTES / SECTOR_SIZE;			// Number of blocks already allocated
+	bool Intact = _ReadRun(volume, Table, _ChecksumTableHome(volume, GroupNum), TableBlocks);
 
-	while (BlocksAllocated < (BlockListIndex + 1))								// Not enough blocks allocated yet
+	for (TableIterator = 0; TableIterator < TableBlocks && Intact; TableIterator++)
 	{
-		if (BlocksAllocated >= MAX_FILE_SECTORS) return FALSE;						// Cannot create new space to index into this address
-		// Give this file another block
-		uint32_t BlockToAssign = _GetNextFreeBlock();
+		BYTE* 	 TableBlock = &Table[(size_t) TableIterator * BlockSize];
+		uint32_t Stored 	= 0;
 
-		_MarkBlockAsOccupied(BlockToAssign);										// Assign the (BlockToAssign + 1)-th block to this space (assign 3rd block to space 2)
-		FileInode->BLOCKS_USED[BlocksAllocated] = BlockToAssign;					// New block has been assigned to this
-		FileInode->FILE_BYTES += SECTOR_SIZE;									// Another block has been added
-		BlocksAllocated = FileInode->FILE_BYTES/SECTOR_SIZE;
-	}
-
-	uint32_t BlockWanted = FileInode->BLOCKS_USED[BlockListIndex];
-	uint32_t IntraBlockIndex = Offset % SECTOR_SIZE;
+		memcpy(&Stored, &TableBlock[PerBlock * sizeof(uint32_t)], sizeof(Stored));
 
-	memset(&tempBlock, 0, SECTOR_SIZE);
+		Intact = (bool) (Checksum_CRC32C(TableBlock, PerBlock * sizeof(uint32_t)) == Stored);
 
-	// Load the needed block from memory
-	_ReadFromFile((BYTE*) &tempBlock, BlockWanted);
-
-	BYTE* byteToStartReadingFrom = &tempBlock[IntraBlockIndex];
+		memcpy(&Checksums[TableIterator * PerBlock], TableBlock, PerBlock * sizeof(uint32_t));
+	}
 
-	// The number of bytes that can be written within this block (in case of overlapping writes)
-	uint32_t ValidBytes = SECTOR_SIZE - IntraBlockIndex;
+	free(Table);
 
-	if (numBytes <= ValidBytes)
+	if (Intact == FALSE)
 	{
-		// TODO: No need to load another block from SD
-		memcpy(Buffer, byteToStartReadingFrom, numBytes);
+		free(Checksums);
+		return FALSE;
 	}
-	else
-	{
-		// TODO: Need to load another block from SD
-		// Do a recursive call by splitting the array
-		// BlockSize - IntraBlockIndex is the size of the first array within this block
-		// Remaining is put into offset+1
-		memcpy(Buffer, byteToStartReadingFrom, ValidBytes);
 
-		// Recursive call
-		// Buffer + validBytes: we're currently validBytes bytes into the buffer, so we ignore stuff already written
-		// numBytes - validBytes: we've already written validBytes bytes out of the total numBytes byte count, so we subtract it
-		// We're starting from square 0 at this new block due to contiguous overlap
+	Group->Checksums 			= Checksums;
+	Group->CommittedChecksums 	= (uint32_t*) malloc((size_t) TableBlocks * PerBlock * sizeof(uint32_t));
 
-		if (!OSFS_Read(fileDescriptor, Buffer + ValidBytes, numBytes - ValidBytes, Offset + (SECTOR_SIZE - Offset)))
-		{
-			return FALSE;
-		}
-	}
+	if (Group->CommittedChecksums == 0) exit(-1);
 
-	return TRUE;
-	// Say I want to write 1000 bytes in area 300 of the third sector (so offset is 512*3 + 300 = 1836).
-	// BlockListIndex would be 1836/512 = 3
-	// BlockWanted would be BLOCKS[3] = 913 (assume this).
-	// IntraBlockIndex would be 1836%512 = 300.
-	// I can write 512-300 = 212 bytes within this block before I need to reload another block
+	memcpy(Group->CommittedChecksums, Checksums, (size_t) TableBlocks * PerBlock * sizeof(uint32_t));
 
+	return TRUE;
 }
 
-// 	Writes the specified amount of bytes from buffer into the provided file. Offset allows specification of where in file to start write from.
-// 	Parameters:
-//		fileDescriptor: 	FILE structure pointer provided by OSFS_Create
-//		Buffer:			Buffer to write the file data to
-//		numBytes:		Number of bytes to read from the file and into the buffer
-//		Offset:			Byte number in file to read from
-bool OSFS_Write(MYFILE* fileDescriptor, BYTE* Buffer, uint32_t numBytes, uint32_t Offset)
+// Writes of different blocks run in parallel, so entries are swapped in atomically
+void _NoteChecksums(VOLUME* volume, BYTE* Buffer, uint64_t BlockNum, uint32_t NumBlocks)
 {
-	if (fileDescriptor == 0 || Buffer==0 || numBytes==0) return FALSE;			// Invalid/useless parameters
-
-	INODE* FileInode = fileDescriptor->FileInode;
-
-	if (FileInode == 0) return FALSE;											// Invalid/corrupted Inode
+	uint32_t BlockSize 		= volume->Properties.BlockSize;
+	uint32_t BlockIterator 	= 0;
 
-	uint32_t BlockListIndex = Offset / SECTOR_SIZE;							// If offset < 512, we need block 0. If < 1024, we need block 1, etc.
-	uint32_t BlocksAllocated = FileInode->FILE_BYTES / SECTOR_SIZE;			// Number of blocks already allocated
-
-	while (BlocksAllocated < (BlockListIndex + 1))								// Not enough blocks allocated yet
+	for (BlockIterator = 0; BlockIterator < NumBlocks; BlockIterator++)
 	{
-		if (BlocksAllocated >= MAX_FILE_SECTORS) return FALSE;						// Cannot create new space to index into this address
-		// Give this file another block
-		uint32_t BlockToAssign = _GetNextFreeBlock();
-
-		_MarkBlockAsOccupied(BlockToAssign);										// Assign the (BlockToAssign + 1)-th block to this space (assign 3rd block to space 2)
-		FileInode->BLOCKS_USED[BlocksAllocated] = BlockToAssign;					// New block has been assigned to this
-		FileInode->FILE_BYTES += SECTOR_SIZE;									// Another block has been added
-		BlocksAllocated = FileInode->FILE_BYTES/SECTOR_SIZE;
-	}
-
-	uint32_t BlockWanted = FileInode->BLOCKS_USED[BlockListIndex];
-	uint32_t IntraBlockIndex = Offset % SECTOR_SIZE;
+		uint64_t  Block = BlockNum + BlockIterator;
+		uint32_t* Entry = _ChecksumEntry(volume, Block);
 
-	memset(&tempBlock, 0, SECTOR_SIZE);
+		if (Entry == 0) continue;
 
-	// Load the needed block from memory
-	_ReadFromFile((BYTE*) &tempBlock, BlockWanted);
+		uint32_t Checksum = Checksum_CRC32C(&Buffer[(size_t) BlockIterator * BlockSize], BlockSize);
 
-	BYTE* byteToStartWritingFrom = &tempBlock[IntraBlockIndex];
-
-	// The number of bytes that can be written within this block (in case of overlapping writes)
-	uint32_t ValidBytes = SECTOR_SIZE - IntraBlockIndex;
-
-	if (numBytes <= ValidBytes)
-	{
-		memcpy(byteToStartWritingFrom, Buffer, numBytes);
-		if (_WriteToFile((BYTE*) &tempBlock, BlockWanted))
+		if (__atomic_exchange_n(Entry, Checksum, __ATOMIC_RELAXED) != Checksum)
 		{
-			uint32_t ByteWrittenTo = (((SECTOR_SIZE) * BlockListIndex) + IntraBlockIndex + numBytes);
-			if (ByteWrittenTo > FileInode->BYTES_USED)
-			{
-				FileInode->BYTES_USED = ByteWrittenTo;
-			}
+			uint32_t TableBlock = (uint32_t) (Block % volume->Properties.BlocksPerGroup) / _ChecksumsPerBlock(BlockSize);
 
-			fileDescriptor->FileInode->LATEST_CURSOR = ((SECTOR_SIZE) * BlockListIndex) + IntraBlockIndex + numBytes;
+			BitMap_SetBit(volume->Groups[Block / volume->Properties.BlocksPerGroup].DirtyChecksums, TableBlock);
 		}
 	}
-	else
-	{
-		// TODO: Need to load another block from SD
-		// Do a recursive call by splitting the array
-		// BlockSize - IntraBlockIndex is the size of the first array within this block
-		// Remaining is put into offset+1
-		memcpy(byteToStartWritingFrom, Buffer, ValidBytes);
+}
 
-		if (_WriteToFile((BYTE*) &tempBlock, BlockWanted))
-		{
-			uint32_t ByteWrittenTo = (((SECTOR_SIZE) * BlockListIndex) + IntraBlockIndex + numBytes);
-			if (ByteWrittenTo > FileInode->BYTES_USED)
-			{
-				FileInode->BYTES_USED = ByteWrittenTo;
-			}
-		}
+bool _VerifyChecksums(VOLUME* volume, BYTE* Buffer, uint64_t BlockNum, uint32_t NumBlocks)
+{
+	uint32_t BlockSize 		= volume->Properties.BlockSize;
+	uint32_t BlockIterator 	= 0;
+
+	for (BlockIterator = 0; BlockIterator < NumBlocks; BlockIterator++)
+	{
+		uint32_t* Entry = _ChecksumEntry(volume, BlockNum + BlockIterator);
 
-		// Recursive call
-		// Buffer + validBytes: we're currently validBytes bytes into the buffer, so we ignore stuff already written
-		// numBytes - validBytes: we've already written validBytes bytes out of the total numBytes byte count, so we subtract it
-		// We're starting from square 0 at this new block due to contiguous overlap
+		if (Entry == 0 || __atomic_load_n(Entry, __ATOMIC_RELAXED) == CHECKSUM_NONE) continue;
 
-		if (!OSFS_Write(fileDescriptor, Buffer + ValidBytes, numBytes - ValidBytes, Offset + (SECTOR_SIZE - Offset)))
+		if (Checksum_CRC32C(&Buffer[(size_t) BlockIterator * BlockSize], BlockSize) != __atomic_load_n(Entry, __ATOMIC_RELAXED))
 		{
+			_SetError(volume, FILE_CORRUPTED);
 			return FALSE;
 		}
 	}
 
 	return TRUE;
-	// Say I want to write 1000 bytes in area 300 of the third sector (so offset is 512*3 + 300 = 1836).
-	// BlockListIndex would be 1836/512 = 3
-	// BlockWanted would be BLOCKS[3] = 913 (assume this).
-	// IntraBlockIndex would be 1836%512 = 300.
-	// I can write 512-300 = 212 bytes within this block before I need to reload another block
 }
 
-bool OSFS_Close(MYFILE* fileToClose)
+// Released in the same commit as the blocks themselves, so a block allocated again later starts out unchecked
+void _ForgetChecksums(VOLUME* volume, uint64_t BlockNum, uint32_t NumBlocks)
 {
-	// Write the inode to non-volatile memory
-	_UpdateNonVolatileInodeCopy(fileToClose->FileInode->INODE_NUM, fileToClose->FileInode);
+	uint32_t BlockIterator = 0;
 
-	free(fileToClose->FileInode);
-	free(fileToClose);
+	for (BlockIterator = 0; BlockIterator < NumBlocks; BlockIterator++)
+	{
+		uint64_t  Block = BlockNum + BlockIterator;
+		uint32_t* Entry = _ChecksumEntry(volume, Block);
 
-	fileToClose = 0;
+		if (Entry == 0) continue;
 
-	// Write the associated data blocks to non-volatile memory
-	// TODO: Write the data blocks back to non-volatile memory
-	return TRUE;
-}
+		BitMap_ClearBit(volume->Groups[Block / volume->Properties.BlocksPerGroup].OpenBlocks, (uint32_t) (Block % volume->Properties.BlocksPerGroup));
 
-bool OSFS_Append(MYFILE* fileDescriptor, BYTE* buffer, uint32_t numBytes)
-{
-	return OSFS_Write(fileDescriptor, buffer, numBytes, fileDescriptor->FileInode->LATEST_CURSOR);
+		if (__atomic_exchange_n(Entry, CHECKSUM_NONE, __ATOMIC_RELAXED) != CHECKSUM_NONE)
+		{
+			uint32_t TableBlock = (uint32_t) (Block % volume->Properties.BlocksPerGroup) / _ChecksumsPerBlock(volume->Properties.BlockSize);
+
+			BitMap_SetBit(volume->Groups[Block / volume->Properties.BlocksPerGroup].DirtyChecksums, TableBlock);
+		}
+	}
 }
 
-bool OSFS_Delete(char* fileName)
+// File data is not journaled, so a crash between an in-place overwrite and the next commit leaves a block whose
+// contents (whole, torn or old) the committed table knows nothing about. The blocks of open files are committed
+// without a checksum to begin with (see _HoldFile), and so are released blocks, so this only gets to commit anything
+// for a file opened inside a batch, or written before the commit opening it: every table block with a checksum
+// committed for one of the blocks then gets committed with CHECKSUM_NONE throughout, in a transaction of its own. It
+// stays open until the next commit point logs it.
+bool _OpenChecksums(VOLUME* volume, uint64_t BlockNum, uint32_t NumBlocks)
 {
-	INODE* createdFile = (INODE*) malloc(sizeof(INODE) * 1);
-
-	if (createdFile == 0)
+	uint32_t BlockSize 		= volume->Properties.BlockSize;
+	uint32_t BlocksPerGroup = volume->Properties.BlocksPerGroup;
+	uint32_t PerBlock 		= _ChecksumsPerBlock(BlockSize);
+	bool 	 Locked 		= FALSE;
+	bool 	 Opened 		= TRUE;
+	uint32_t BlockIterator 	= 0;
+	BYTE 	 Sector[BlockSize];
+
+	for (BlockIterator = 0; BlockIterator < NumBlocks; BlockIterator++)
 	{
-		RecentError = FILE_INIT_FAILED;
-		return FALSE;	// Not enough memory to initialize anything, so we cannot do anything
-	}
+		uint64_t Block = BlockNum + BlockIterator;
 
-	// Get the proper inode associated with this filename
-	int32_t associatedInode = _GetInodeFromFileName(fileName);
+		if (_ChecksumEntry(volume, Block) == 0) continue;
 
-	if (associatedInode == -1)
-	{
-		RecentError = FILE_DOES_NOT_EXIST;
-		return FALSE;
-	}
+		uint32_t 	 GroupNum 	= (uint32_t) (Block / BlocksPerGroup);
+		uint32_t 	 TableBlock = (uint32_t) (Block % BlocksPerGroup) / PerBlock;
+		BLOCK_GROUP* Group 		= &volume->Groups[GroupNum];
+		uint32_t* 	 Committed 	= &Group->CommittedChecksums[TableBlock * PerBlock];
+		uint32_t* 	 Entry 		= &Committed[(Block % BlocksPerGroup) % PerBlock];
 
-	_ReadInodeFromNonVolatileMemory(associatedInode, createdFile);
+		if (__atomic_load_n(Entry, __ATOMIC_RELAXED) == CHECKSUM_NONE) continue;
 
-	RecentError = FILE_OK;
+		// The entries only change once the transaction is committed, so no other write goes ahead of it
+		if (Locked == FALSE)
+		{
+			pthread_mutex_lock(&volume->ChecksumLock);
+			Locked = TRUE;
 
-	uint32_t BlocksAllocated = createdFile->FILE_BYTES / SECTOR_SIZE;			// Number of blocks already allocated
-	uint32_t BlockIterator   = 0;
+			if (__atomic_load_n(Entry, __ATOMIC_RELAXED) == CHECKSUM_NONE) continue;
+		}
 
-	for (BlockIterator = 0; BlockIterator < BlocksAllocated; BlockIterator++)
-	{
-		_MarkBlockAsFree(createdFile->BLOCKS_USED[BlockIterator]);
-	}
+		uint32_t TableChecksum = 0;
+		uint32_t EntryIterator = 0;
 
-	_MarkInodeAsFree(associatedInode);
+		memset(Sector, 0, BlockSize);
+		TableChecksum = Checksum_CRC32C(Sector, PerBlock * sizeof(uint32_t));
+		memcpy(&Sector[PerBlock * sizeof(uint32_t)], &TableChecksum, sizeof(TableChecksum));
 
-	free(createdFile);
+		Opened = (bool) (Journal_Log(volume->MetadataJournal, Sector, _ChecksumTableHome(volume, GroupNum) + TableBlock) &&
+						 Journal_Commit(volume->MetadataJournal));
 
-	return TRUE;
+		if (Opened == FALSE) break;
 
-}
+		for (EntryIterator = 0; EntryIterator < PerBlock; EntryIterator++) __atomic_store_n(&Committed[EntryIterator], CHECKSUM_NONE, __ATOMIC_RELAXED);
 
-uint32_t GetFileSize(MYFILE* fileToEval)
-{
-	return fileToEval->FileInode->BYTES_USED; // Latest byte written to
-}
-//***************************************** Private Functions ************************************//
+		// Logged again at the next commit point, with every entry as it is by then
+		BitMap_SetBit(Group->DirtyChecksums, TableBlock);
+	}
 
-// Private functions for interacting with physical disk
+	if (Locked == TRUE) pthread_mutex_unlock(&volume->ChecksumLock);
 
-bool _WriteToFile(BYTE* InputBuffer, uint64_t BlockNum)
-{
-    FILE* fileptr = fopen(SDCARD_SPOOF, "rb");
-    if (!fileptr) {
-        fileptr = fopen(SDCARD_SPOOF, "w");
-    }
-    fseek(fileptr, 0, SEEK_END);
-    long filelen = ftell(fileptr);
-    rewind(fileptr);
-
-    char* buffer;
-    if (filelen <= (BlockNum * SECTOR_SIZE)) {
-        filelen = ((BlockNum + 1) * SECTOR_SIZE)  + sizeof(InputBuffer);
-    }
-    buffer = (char *)malloc((filelen+1)*sizeof(char)); // Enough memory for file + \0
-    fread(buffer, filelen, 1, fileptr); // Read in the entire file
-    fclose(fileptr); // Close the file
-    remove(SDCARD_SPOOF);
-    
-    char* index = &buffer[BlockNum * SECTOR_SIZE];
-    memcpy(index, InputBuffer, SECTOR_SIZE);
-    
-    fileptr = fopen(SDCARD_SPOOF, "w");
-    if (!fileptr) {
-        free(buffer);
-        return FALSE;
-    }
-    fwrite(buffer, sizeof(char), (filelen)*sizeof(char), fileptr);
-    fclose(fileptr);
-    free(buffer);
-    return TRUE;
-}
-
-
-bool _ReadFromFile(BYTE* OutputBuffer, uint64_t BlockNum)
-{
-    FILE* fileptr = fopen(SDCARD_SPOOF, "rb");
-    if (!fileptr) {
-    	OSFS_Format();
-    	fileptr = fopen(SDCARD_SPOOF, "rb");
-    	if (!fileptr) return FALSE;
-    }
-    fseek(fileptr, 0, SEEK_END);
-    long filelen = ftell(fileptr);
-    rewind(fileptr);
-    if (filelen <= (BlockNum * SECTOR_SIZE)) {
-        filelen = (BlockNum + 1) * SECTOR_SIZE;
-    }
-    char* buffer = (char *)malloc((filelen+1)*sizeof(char)); // Enough memory for file + \0
-    fread(buffer, filelen, 1, fileptr); // Read in the entire file
-    fclose(fileptr); // Close the file
-    char* index = &buffer[BlockNum * SECTOR_SIZE];
-    memcpy(OutputBuffer, index, SECTOR_SIZE);
-    free(buffer);
-    return TRUE;
+	return Opened;
 }
 
-// Block tools
-
-// Function used to update the bitmap in memory from the Disk
-bool _TranscribeBitMap(BYTE* blockToUse, BitMap* mapToUpdate, uint32_t NumBytes)
+// Only the table blocks whose committed image changes are logged again
+void _HoldChecksums(VOLUME* volume, uint64_t BlockNum, uint32_t NumBlocks, bool Hold)
 {
-	uint32_t* ArrayInput = (uint32_t*) blockToUse;
+	uint32_t BlocksPerGroup = volume->Properties.BlocksPerGroup;
+	uint32_t PerBlock 		= _ChecksumsPerBlock(volume->Properties.BlockSize);
+	uint32_t BlockIterator 	= 0;
 
-	mapToUpdate->bitsize = ArrayInput[0];
-	mapToUpdate->wordsize = ArrayInput[1];
+	for (BlockIterator = 0; BlockIterator < NumBlocks; BlockIterator++)
+	{
+		uint64_t Block = BlockNum + BlockIterator;
 
-	// The pointer itself is not saved, so do not count that in the offset calculations
-	memcpy(mapToUpdate->dataarray, &ArrayInput[2], mapToUpdate->wordsize * sizeof(uint32_t));
+		if (_ChecksumEntry(volume, Block) == 0) continue;
 
-	return TRUE;
-}
+		BLOCK_GROUP* Group 		= &volume->Groups[Block / BlocksPerGroup];
+		uint32_t 	 GroupBlock = (uint32_t) (Block % BlocksPerGroup);
 
+		if (BitMap_TestBit(Group->OpenBlocks, GroupBlock) == Hold) continue;
 
-// Private Inode Functions
+		if (Hold) BitMap_SetBit(Group->OpenBlocks, GroupBlock);
+		else BitMap_ClearBit(Group->OpenBlocks, GroupBlock);
 
-// Return condition:
-// TRUE if inode is occupied
-// FALSE if inode is free
-bool 	_CheckInodeOccupancy(uint32_t Inodenum)
-{
-	if (Inodenum >= MAX_INODE_COUNT) return FALSE;
+		BitMap_SetBit(Group->DirtyChecksums, GroupBlock / PerBlock);
+	}
+}
 
-	BitMap* localBitMapRef = InodeBitMap;
+// Any handle can overwrite the file in place, so commit points log the blocks of a file with handles open without
+// their checksums: after a crash, those read back unchecked until they are written again. The first handle holds the
+// blocks the file already has, which takes a commit before they are written (TRUE), blocks are held as the file grows,
+// and the last handle closed lets them all go. Blocks mapped past a tree node that cannot be read are not held, but
+// cannot be written either.
+bool _HoldFile(MYFILE* File, bool Hold)
+{
+	VOLUME* 		  volume 	= File->Volume;
+	INODE* 			  FileInode = File->FileInode;
+	pthread_rwlock_t* InodeLock = _InodeLock(File);
+	bool 			  Changed 	= FALSE;
 
-	return BitMap_TestBit(localBitMapRef, Inodenum);
+	pthread_rwlock_wrlock(InodeLock);
 
-}
+	uint32_t Handles = volume->OpenHandles[FileInode->INODE_NUM];
 
-// Returns the next free inode. Does NOT mark the inode as occupied.
-uint32_t _GetNextFreeInode()
-{
-	uint32_t InodeStart = 0;
+	volume->OpenHandles[FileInode->INODE_NUM] = (Hold) ? Handles + 1 : Handles - 1;
 
-	for (InodeStart = 0; InodeStart < MAX_INODE_COUNT; InodeStart++)
+	if (((Hold) ? Handles == 0 : Handles == 1) && _IsInline(FileInode) == FALSE && FileInode->FILE_BYTES > 0)
 	{
-		if (_CheckInodeOccupancy(InodeStart) == FALSE) return InodeStart;
+		ExtentTree_Walk(volume->FileExtents, &FileInode->EXTENTS, (Hold) ? _HoldExtent : _ReleaseExtent, volume);
+		Changed = TRUE;
 	}
 
-	exit(-1);
+	pthread_rwlock_unlock(InodeLock);
+
+	return Changed;
+}
+
+void _HoldExtent(void* Context, Extent* Entry)
+{
+	_HoldChecksums((VOLUME*) Context, Entry->StartBlock, EXTENT_STORED_BLOCKS(Entry), TRUE);
+}
 
-	return 0; // never executes since kernel panics
+void _ReleaseExtent(void* Context, Extent* Entry)
+{
+	_HoldChecksums((VOLUME*) Context, Entry->StartBlock, EXTENT_STORED_BLOCKS(Entry), FALSE);
 }
 
-// Gets the next inode number that is occupied starting from the provided index
-int32_t _GetNextOccupiedInode(uint32_t StartLocation)
+void _ReleaseOpenBlocks(VOLUME* volume)
 {
-	uint32_t InodeStart = StartLocation;
+	uint32_t BlocksPerGroup = volume->Properties.BlocksPerGroup;
+	uint32_t GroupIterator 	= 0;
 
-	for (InodeStart = StartLocation; InodeStart < MAX_INODE_COUNT; InodeStart++)
+	for (GroupIterator = 0; GroupIterator < volume->Properties.NumGroups; GroupIterator++)
 	{
-		if (_CheckInodeOccupancy(InodeStart) == TRUE) return InodeStart;
-	}
+		int32_t GroupBlock = BitMap_FindFirstSet(volume->Groups[GroupIterator].OpenBlocks, BlocksPerGroup);
 
-	return -1;
+		while (GroupBlock >= 0)
+		{
+			_HoldChecksums(volume, ((uint64_t) GroupIterator * BlocksPerGroup) + GroupBlock, 1, FALSE);
+
+			GroupBlock = BitMap_FindNextSet(volume->Groups[GroupIterator].OpenBlocks, GroupBlock + 1, BlocksPerGroup);
+		}
+	}
 }
 
-bool _MakeInodeResident(uint32_t InodeNum, INODE* volatileLocation)
+// The table block goes in before the sector with the sector's old checksum, and after it with the new one. Should
+// the sector not fit in the running transaction, the one committed without it still matches what is on the store,
+// and the sector's new checksum follows it into the next.
+bool _LogMetadata(VOLUME* volume, BYTE* Sector, uint32_t BlockNum)
 {
-	if (InodeNum > MAX_INODE_COUNT) return FALSE;
-	memset(&tempBlock, 0, SECTOR_SIZE);
+	uint32_t* Entry = _ChecksumEntry(volume, BlockNum);
 
-	uint32_t InodeResidentInBlock = INODE_BLOCK_START_NUM + (InodeNum / INODES_PER_SECTOR); // The block where the Inode we want lives in
+	if (Entry == 0) return Journal_Log(volume->MetadataJournal, Sector, BlockNum);	// The superblock
 
-	_ReadFromFile((BYTE*) &tempBlock, InodeResidentInBlock);
+	uint32_t 	 BlockSize 	= volume->Properties.BlockSize;
+	uint32_t 	 GroupNum 	= BlockNum / volume->Properties.BlocksPerGroup;
+	BLOCK_GROUP* Group 		= &volume->Groups[GroupNum];
+	uint32_t 	 TableBlock = (BlockNum % volume->Properties.BlocksPerGroup) / _ChecksumsPerBlock(BlockSize);
+	uint32_t 	 TableHome 	= _ChecksumTableHome(volume, GroupNum) + TableBlock;
+	BYTE 		 TableSector[BlockSize];
 
-	// Read the inode into the specified location
-	memcpy(volatileLocation, &tempBlock[InodeNum%INODES_PER_SECTOR * sizeof(INODE)], sizeof(INODE));
+	_SerializeTableBlock(volume, GroupNum, TableBlock, TableSector);
 
-	return TRUE;
-}
+	if (Journal_Log(volume->MetadataJournal, TableSector, TableHome) == FALSE) return FALSE;
 
-void _MarkInodeAsOccupied(uint32_t InodeNum)
-{
-	if (InodeBitMap == 0) exit(-1);
-	BitMap_SetBit(InodeBitMap, InodeNum);
-}
+	__atomic_store_n(Entry, Checksum_CRC32C(Sector, BlockSize), __ATOMIC_RELAXED);
+	_SerializeTableBlock(volume, GroupNum, TableBlock, TableSector);
 
-void _MarkInodeAsFree(uint32_t InodeNum)
-{
-	if (InodeBitMap == 0) exit(-1);
-	BitMap_ClearBit(InodeBitMap, InodeNum);
+	if (Journal_Log(volume->MetadataJournal, Sector, BlockNum) == FALSE) return FALSE;
+	if (Journal_Log(volume->MetadataJournal, TableSector, TableHome) == FALSE) return FALSE;
+
+	BitMap_ClearBit(Group->DirtyChecksums, TableBlock);
+	_ChecksumsLogged(volume, GroupNum, TableBlock, TableSector);
 
+	return TRUE;
 }
-// Accepts a null terminated file name string, gives back a uint32_t inode number
-// that is associated with this file.
-// if return val is greater than 0, the correct INODE has been identified
-// if return val is -1, the inode does not exist
-int32_t _GetInodeFromFileName(char* fileName)
-{
-	uint32_t NodeUntilNow = 0;
-	memset(&CurrentNode, 0, sizeof(INODE));
 
-	while(TRUE)
-	{
-		int32_t NextNodeOccupied = _GetNextOccupiedInode(NodeUntilNow);
+// Data goes out before the commit that logs its checksums (see _CommitMetadata)
+void _LogChecksums(VOLUME* volume)
+{
+	if (volume->Groups == 0) exit(-1);
 
-		if (NextNodeOccupied == -1) return -1;
+	uint32_t BlockSize 		= volume->Properties.BlockSize;
+	uint32_t TableBlocks 	= volume->Properties.ChecksumBlocksPerGroup;
+	BYTE 	 Sector[BlockSize];
+	uint32_t GroupIterator 	= 0;
 
-		// Make the INODE resident into StaticNode
-		_MakeInodeResident(NextNodeOccupied, &CurrentNode);
+	for (GroupIterator = 0; GroupIterator < volume->Properties.NumGroups; GroupIterator++)
+	{
+		BLOCK_GROUP* Group 	= &volume->Groups[GroupIterator];
+		int32_t TableBlock 	= BitMap_FindFirstSet(Group->DirtyChecksums, TableBlocks);
 
-		if (strcmp(CurrentNode.FILE_NAME, fileName) == 0)					// the file names match up
+		while (TableBlock >= 0)
 		{
-			return NextNodeOccupied;
-		}
+			BitMap_ClearBit(Group->DirtyChecksums, TableBlock);
 
-		NodeUntilNow = NextNodeOccupied + 1;
+			_SerializeTableBlock(volume, GroupIterator, (uint32_t) TableBlock, Sector);
 
-		memset(&CurrentNode, 0, sizeof(INODE));
+			if (Journal_Log(volume->MetadataJournal, Sector, _ChecksumTableHome(volume, GroupIterator) + TableBlock) == FALSE) exit(-1);
+			_ChecksumsLogged(volume, GroupIterator, (uint32_t) TableBlock, Sector);
 
+			TableBlock = BitMap_FindNextSet(Group->DirtyChecksums, TableBlock + 1, TableBlocks);
+		}
 	}
 }
 
-// Update non-volatile inode with copy of volatile inode
-void _UpdateNonVolatileInodeCopy(uint32_t InodeNum, INODE* volatileCopy)
-{
-	uint32_t InodeResidentInBlock = INODE_BLOCK_START_NUM + (InodeNum / INODES_PER_SECTOR); // The block where the Inode we want lives in
-	_ReadFromFile((BYTE*)&tempBlock, InodeResidentInBlock);
-	memcpy(&tempBlock[InodeNum%INODES_PER_SECTOR * sizeof(INODE)], volatileCopy, sizeof(INODE));
-	_WriteToFile((BYTE*)&tempBlock, InodeResidentInBlock);
-
-}
-
-void _ReadInodeFromNonVolatileMemory(uint32_t InodeNum, INODE* location)
+// Called at commit points only, so no write can be opening entries meanwhile
+void _ChecksumsLogged(VOLUME* volume, uint32_t GroupNum, uint32_t TableBlock, BYTE* Sector)
 {
-	uint32_t InodeResidentInBlock = INODE_BLOCK_START_NUM + (InodeNum / INODES_PER_SECTOR); // The block where the Inode we want lives in
-	_ReadFromFile((BYTE*)&tempBlock, InodeResidentInBlock);
-	memcpy(location, &tempBlock[InodeNum%INODES_PER_SECTOR * sizeof(INODE)], sizeof(INODE));
-	memset(tempBlock, 0, SECTOR_SIZE);
+	uint32_t PerBlock = _ChecksumsPerBlock(volume->Properties.BlockSize);
 
+	memcpy(&volume->Groups[GroupNum].CommittedChecksums[TableBlock * PerBlock], Sector, PerBlock * sizeof(uint32_t));
 }
-// Block operations
 
-bool _CheckBlockOccupancy(uint32_t BlockNum)
+void _SerializeTableBlock(VOLUME* volume, uint32_t GroupNum, uint32_t TableBlock, BYTE* Sector)
 {
-	if (BlockNum >= MAX_BLOCKS_TRACKED) return FALSE;
+	BLOCK_GROUP* Group 			= &volume->Groups[GroupNum];
+	uint32_t 	 PerBlock 		= _ChecksumsPerBlock(volume->Properties.BlockSize);
+	uint32_t 	 EntryIterator 	= 0;
+	uint32_t 	 Entries[PerBlock];
 
-	BitMap* localBitMapRef = DataBitMap;
+	for (EntryIterator = 0; EntryIterator < PerBlock; EntryIterator++)
+	{
+		uint32_t GroupBlock = (TableBlock * PerBlock) + EntryIterator;
+		bool 	 Open 		= (bool) (GroupBlock < volume->Properties.BlocksPerGroup && BitMap_TestBit(Group->OpenBlocks, GroupBlock));
 
-	return BitMap_TestBit(localBitMapRef, BlockNum);
+		Entries[EntryIterator] = (Open) ? CHECKSUM_NONE : __atomic_load_n(&Group->Checksums[GroupBlock], __ATOMIC_RELAXED);
+	}
 
+	_SerializeChecksums(Entries, Sector, volume->Properties.BlockSize);
 }
 
-// Returns the next free block. Does NOT mark the inode as occupied.
-uint32_t _GetNextFreeBlock()
+void _SerializeChecksums(uint32_t* Checksums, BYTE* Sector, uint32_t BlockSize)
 {
-	uint32_t BlockStart = 0;
+	uint32_t PerBlock 		= _ChecksumsPerBlock(BlockSize);
+	uint32_t EntryIterator 	= 0;
+	uint32_t TableChecksum 	= 0;
 
-	for (BlockStart = 0; BlockStart < MAX_BLOCKS_TRACKED; BlockStart++)
+	for (EntryIterator = 0; EntryIterator < PerBlock; EntryIterator++)
 	{
-		if (_CheckBlockOccupancy(BlockStart) == FALSE) return BlockStart;
-	}
+		uint32_t Checksum = __atomic_load_n(&Checksums[EntryIterator], __ATOMIC_RELAXED);
 
-	exit(-1);
-
-	return 0; // never executes since kernel panics
-}
+		memcpy(&Sector[EntryIterator * sizeof(uint32_t)], &Checksum, sizeof(Checksum));
+	}
 
-void _MarkBlockAsOccupied(uint32_t BlockNum)
-{
-	if (DataBitMap == 0) exit(-1);
-	BitMap_SetBit(DataBitMap, BlockNum);
+	TableChecksum = Checksum_CRC32C(Sector, PerBlock * sizeof(uint32_t));
+	memcpy(&Sector[PerBlock * sizeof(uint32_t)], &TableChecksum, sizeof(TableChecksum));
 }
 
-void _MarkBlockAsFree(uint32_t BlockNum)
+uint32_t _SuperBlockChecksum(struct nRTOS_SuperBlock* SuperBlock)
 {
-	if (DataBitMap == 0) exit(-1);
-	BitMap_ClearBit(DataBitMap, BlockNum);
+	return Checksum_CRC32C((BYTE*) SuperBlock, offsetof(struct nRTOS_SuperBlock, Checksum));
 }
 
-// Required: BYTE Array has to be exactly 512 bytes.
-void _UpdateNonVolatileDataBlockCopy(uint32_t BlockNum, BYTE* volatileCopy)
+// A serialized bitmap is two words of sizes followed by its words, and a bitmap of n bits takes n/WORD_SIZE + 1 words
+uint32_t _BitsPerBitMap(uint32_t BlockSize)
 {
-	_WriteToFile((BYTE*)&volatileCopy, BlockNum);
+	return (((BlockSize - (2 * sizeof(uint32_t))) / sizeof(uint32_t)) - 1) * WORD_SIZE;
 }
 
-// Bitmap operations
-
-// Put volatile bitmaps into non-volatile storage
-void _FlushBitMapToDisk()
+// Since the bitmap has a dynamic array, we need to transcribe it manually: the sizes first, then the words.
+// This is the layout _TranscribeBitMap reads back.
+void _SerializeBitMap(BitMap* mapToStore, BYTE* blockToUse, uint32_t NumBytes)
 {
-	// Since the bitmap has a dynamic array, we need to transcribe it manually
-	//CurrentBlock.SizeInBytes = sizeof(BitMap) + (DATA_BITMAP_SIZE_IN_WORDS * sizeof(uint32_t)) - sizeof(uint32_t*); // everything but the pointer
-	memset(&tempBlock, 0, SECTOR_SIZE);
-
-	memcpy(&tempBlock, DataBitMap, sizeof(BitMap) - sizeof(uint32_t*)); // Store everything but the pointer.
-
-	uint32_t SizeUsed = sizeof(BitMap) - sizeof(uint32_t*);	// The amount of sized used so far in the struct
-
-	memcpy(((&tempBlock[SizeUsed])), DataBitMap->dataarray, DATA_BITMAP_SIZE_IN_WORDS * sizeof(uint32_t)); // Copy over the dynamic data
+	uint32_t* ArrayOutput = (uint32_t*) blockToUse;
 
-	if (_WriteToFile((BYTE*) &tempBlock, DATA_BITMAP_SECTOR_NUM) == FALSE)
-	{
-			exit(-1);
-	}
-
-	memset(&tempBlock, 0, SECTOR_SIZE);
-
-	// Store the inode bit map into the proper area
+	memset(blockToUse, 0, NumBytes);
 
-	if (DataBitMap == 0 || InodeBitMap == 0) exit(-1);
+	ArrayOutput[0] = mapToStore->bitsize;
+	ArrayOutput[1] = mapToStore->wordsize;
 
-	// Since the bitmap has a dynamic array, we need to transcribe it manually
-	//CurrentBlock.SizeInBytes = sizeof(BitMap) + (INODE_BITMAP_SIZE_IN_WORDS * sizeof(uint32_t)) - sizeof(uint32_t*); // everything but the pointer
-
-	memcpy(&tempBlock[0], InodeBitMap, sizeof(BitMap) - sizeof(uint32_t*)); // Store everything but the pointer.
-
-	SizeUsed = sizeof(BitMap) - sizeof(uint32_t*);	// The amount of sized used so far in the struct
-
-	memcpy(((&tempBlock[SizeUsed])), InodeBitMap->dataarray, INODE_BITMAP_SIZE_IN_WORDS * sizeof(uint32_t)); // Copy over the dynamic data
+	BitMap_StoreWords(mapToStore, 0, &ArrayOutput[2], mapToStore->wordsize); // Copy over the dynamic data
+}
 
-	if (_WriteToFile((BYTE*) &tempBlock, INODE_BITMAP_SECTOR_NUM) == FALSE)
-	{
-			exit(-1);
-	}
+// Context is the stream to print to
+void _PrintItem(void* Context, DIRECTORY_ITEM* Item)
+{
+	FILE* Output = (FILE*) Context;
 
-	memset(&tempBlock, 0, SECTOR_SIZE);
+	if (Item->IsDirectory) fprintf(Output, "%s/\n", Item->Name);
+	else fprintf(Output, "%s :: %llu  bytes\n", Item->Name, (unsigned long long) Item->Bytes);
 }
 
-// Iterates through the root directory and prints out the files
-// that are contained within it.
-void SerialListFiles()
+// Prints out the entries of the directory at path
+void SerialListFiles(VOLUME* volume, char* path)
 {
-	uint32_t StartLoc = 0;
-	memset(tempBlock, 0, SECTOR_SIZE);
-
-	while(TRUE)
-	{
-		int32_t nextInode = _GetNextOccupiedInode(StartLoc);
-		if (nextInode < 0) return;
-		_ReadInodeFromNonVolatileMemory(nextInode, &CurrentNode);
-        printf("%s :: %d  bytes\n", CurrentNode.FILE_NAME, CurrentNode.BYTES_USED);
-		StartLoc = nextInode + 1;
-	}
+	OSFS_ListDirectory(volume, path, _PrintItem, stdout);
 }
 
+// Streams the file to stdout a chunk at a time
 void SerialPrintFile(MYFILE* fileToPrint)
 {
-	INODE* filenode = fileToPrint->FileInode;
-
-	uint32_t ByteIterator  = 0;
-
-	BYTE thisByte;
-	memset(&thisByte, 0, 1);
+	FILE_CURSOR* Cursor = OSFS_OpenCursor(fileToPrint);
 
-	BYTE* fileContents = malloc(filenode->BYTES_USED + 1);
-	memset(fileContents, 0, filenode->BYTES_USED + 1);
+	if (Cursor == 0) return;
 
-	if (fileContents)
-	{
-		for(ByteIterator = 0; ByteIterator < filenode->BYTES_USED; ByteIterator++)
-		{
-			OSFS_Read(fileToPrint, (BYTE*) &thisByte, 1, ByteIterator);
-			fileContents[ByteIterator] = (thisByte);
-			memset(&thisByte, 0, 1);
-		}
-		printf("%s", (char*) fileContents);
-		free(fileContents);
+	BYTE*	Chunk 		= 0;
+	int32_t ChunkBytes 	= 0;
 
-	}
-	else
+	while ((ChunkBytes = OSFS_CursorNext(Cursor, &Chunk)) > 0)
 	{
-		for(ByteIterator = 0; ByteIterator < filenode->BYTES_USED; ByteIterator++)
-		{
-			OSFS_Read(fileToPrint, (BYTE*) &thisByte, 1, ByteIterator);
-			printf("%c", thisByte);
-			memset(&thisByte, 0, 1);
-		}
+		fwrite(Chunk, 1, ChunkBytes, stdout);
 	}
+
+	OSFS_CloseCursor(Cursor);
 }
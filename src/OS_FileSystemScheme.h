@@ -9,68 +9,188 @@
 #define OS_FILESYS_OS_FILESYSTEM_H_
 
 #include "venkatlib.h"
-
-// Initialization Routine For the File System
-void OSFS_Init();
+#include "ExtentTree.h"
+#include "Directory.h"
 
 //***************************************** File System Definitions *****************************************//
 
 #define DRIVENUM 0
 #define SUPER_BLOCK_SECTOR_NUM 0										// The location on sector where the super block resides
-#define INODE_BITMAP_SECTOR_NUM 1
-#define DATA_BITMAP_SECTOR_NUM 2
-#define INODE_BLOCK_START_NUM 3										// Where the first inode resides
-
-#define MAX_INODE_COUNT	3950											// Maximum number of nnodes created, and thus max number of files
-#define MAX_BLOCKS_TRACKED 3950										// Maximum number of blocks begin tracked
+#define GROUP_TABLE_SECTOR_NUM 1										// Block group descriptors, one after the other
 
-#define DATA_BITMAP_SIZE_IN_WORDS ((MAX_BLOCKS_TRACKED/(sizeof(uint32_t)*8)) + 1)	// We're tracking N blocks.
-																	// We need 1 bit per block and there's 32 bits per int.
-#define INODE_BITMAP_SIZE_IN_WORDS ((MAX_INODE_COUNT/(sizeof(uint32_t)*8)) + 1)
+// Volume geometry. Every volume picks its block size, block count and inode count when it is formatted (see GEOMETRY
+// below) and keeps them in its superblock; these are what a store gets when nothing else is asked for. A block is also
+// the volume's unit of I/O, so "sector" and "block" mean the same thing from here on.
+#define DEFAULT_BLOCK_SIZE 512
+#define DEFAULT_BLOCK_COUNT 3950										// 2.0 MB with the default block size
+#define DEFAULT_INODE_COUNT 3950										// Maximum number of nnodes created, and thus max number of files
+#define MIN_BLOCK_SIZE 512												// The superblock is read with this many bytes, before the block size is known
+#define MAX_BLOCK_SIZE 65536
+#define SIZE_OF_FLASH_BLOCK DEFAULT_BLOCK_SIZE							// Make sure the block is the same size as the sector
 
-#define SECTOR_SIZE	512
-#define SIZE_OF_FLASH_BLOCK SECTOR_SIZE									// Make sure the block is the same size as the sector
+#define DEFAULT_CACHE_SECTORS 64											// Sectors held by the write-back sector cache unless the mount says otherwise
+#define DEFAULT_STORE_PATH "myfilesystem.store"							// Spoofed SD card used by the shell unless told otherwise
 
 // inode properties
-#define MAX_FILE_SECTORS	 	22											// Max number of sectors a file can use (25 * 512 = 12.8 kB)
-#define MAX_FILE_NAME_CHARS	10											// Max size of file names
-#define INODE_SIZE	114
-#define INODES_PER_SECTOR 4
-#define TOTAL_INODE_SECTORS (MAX_INODE_COUNT/INODES_PER_SECTOR) + 1		// The plus one compensates for the .5 that might occur
+#define MAX_FILE_BLOCKS	 	UINT32_MAX									// File block numbers are 32 bits (2 TB files with the default block size)
+#define MAX_FILE_NAME_CHARS	DIRECTORY_NAME_CHARS						// Max size of each name along a path
+#define INODE_SIZE	120													// Inodes are packed as many to a block as fit
+
+// Metadata journal (header block + log), right after the group descriptor table
+#define JOURNAL_BLOCKS 128
+
+// Block groups, as in EXT2. Group g covers blocks g * BlocksPerGroup onwards (the last group gets whatever is left) and
+// inodes g * InodesPerGroup onwards. Every group starts with its own block bitmap, inode bitmap, slice of the inode
+// table and checksum table; in group 0 these follow the superblock, the group descriptor table and the journal.
+// A volume gets at least MIN_BLOCK_GROUPS groups, and more when one block's worth of bitmap cannot cover a group.
+#define MIN_BLOCK_GROUPS 4
 
 // Justifications:
-// We want both the inode bitmap and the data bitmap to fit into individual blocks, so the max size they can be is 508 bytes.
-// This is due to the fact that we're using the FLASH_BLOCK struct below and that has an overhead of 4 bytes (space per physical block
-// is 512 bytes). Thus, we can index 508 * 8 = 4064. For posterity, we will index 3800 blocks. This will allow us to acquire space for
-// 2022400 bytes on disk (2.0 MB). This will give us enough space for the bitmap's overhead as well (8 bytes).
+// Each bitmap of a group fits into a single block: 8 bytes of sizes followed by the words, the last of which is never
+// completely used. A group can therefore index ((BlockSize - 8) / 4 - 1) * 32 blocks (4000 with 512 byte blocks,
+// 32512 with 4 KB ones), and block numbers are 32 bits, which caps a volume at 4G blocks.
+
+// Directories, as in EXT4: every directory is an inode whose entries (name -> inode) live in a tree of its own
+// (see Directory.h), and the root directory is inode ROOT_DIRECTORY_INODE. Files and directories are named by paths
+// from the root; "/" separates the names and "." and ".." work as usual.
+#define ROOT_DIRECTORY_INODE 0
+#define INODE_TYPE_FREE		 0
+#define INODE_TYPE_FILE		 1
+#define INODE_TYPE_DIRECTORY 2
+
+// Inline data, as in EXT4: a file whose data fits in the space of the extent tree root keeps it there instead, and
+// takes no data block at all (FILE_BYTES stays 0). The data moves out to blocks, and the root is put back, once the
+// file outgrows INLINE_DATA_BYTES. Inline data is part of the inode, so it is journaled along with it.
+#define INLINE_DATA_BYTES sizeof(ExtentRoot)
+
+// Compression, as in btrfs: files created while the volume is mounted with the Compress option keep their data in
+// clusters of COMPRESSION_CLUSTER_BLOCKS blocks, each squeezed with the LZ codec (see Compressor.h) and mapped by an
+// extent of its own (see ExtentTree_AppendCluster). A stored cluster is the compressed length (4 bytes) and the
+// compressed data, padded to whole blocks; a cluster that would not come out at least a block smaller is stored as is.
+// Writes rewrite every cluster they touch, and a cluster that grows moves to a new home.
+#define COMPRESSION_CLUSTER_BLOCKS 	8
+#define INODE_FLAG_COMPRESSED 		1
+
+// Checksums, as in btrfs: every block of a group has a CRC32C (see Checksum.h) in the group's checksum table, data and
+// metadata alike. Each block of the table holds BlockSize / 4 - 1 of them and ends with the checksum of the rest of
+// itself. A block is checked whenever it is read from the store, and a read that does not match fails with
+// FILE_CORRUPTED instead of handing out what it found. The superblock checks itself, and the journal's transactions
+// carry checksums of their own, so neither has an entry. Blocks the format does not write keep whatever the store held
+// before, so their entries are CHECKSUM_NONE and they go unchecked until they are first written, as do released blocks.
+// The tables only go into the journal along with the metadata, so while a file has handles open, its blocks are
+// committed with CHECKSUM_NONE: after a crash, those blocks read back unchecked instead of failing, until they are
+// written again. Opening a file that has blocks is a commit point for that reason.
+#define CHECKSUM_NONE 				0			// A block with this entry is not checked (a block whose CRC32C is 0 just loses its check)
 
 typedef struct nRTOS_FileNode
-{											 // Total: 114 bytes per inode
-	uint32_t INODE_NUM;						 // 4 bytes
-	uint32_t FILE_BYTES;						 // 4 bytes; Increments of SECTOR_SIZE. Directly indicates how many blocks are used by file.
-	uint32_t BYTES_USED;						 // 4 bytes; The amount of bytes used by data stored within the file. Once it hits n*SECTOR_SIZE, need to expand file
-	uint32_t LATEST_CURSOR;					 // 4 bytes; The last written area of file (so that append can start appending from there
-	char		 FILE_NAME[MAX_FILE_NAME_CHARS];	 // 10 bytes
-	uint32_t BLOCKS_USED[MAX_FILE_SECTORS];   // 88 bytes
+{											 // Total: 120 bytes per inode
+	uint32_t 	INODE_NUM;					 // 4 bytes
+	union
+	{
+		ExtentRoot 	EXTENTS;				 // 76 bytes; Root of the tree mapping the file's blocks (see ExtentTree.h)
+		BYTE 		INLINE_DATA[INLINE_DATA_BYTES];	// Or the file's data, while it has no blocks
+	};
+	uint64_t 	FILE_BYTES;					 // 8 bytes; Increments of the block size. Directly indicates how many blocks are used by file (0 while the data is inline).
+	uint64_t 	BYTES_USED;					 // 8 bytes; The amount of bytes used by data stored within the file. Once it hits n blocks, need to expand file
+	uint64_t 	LATEST_CURSOR;				 // 8 bytes; The last written area of file (so that append can start appending from there
+	uint16_t	FILE_TYPE;					 // 2 bytes; INODE_TYPE_*
+	uint16_t	FILE_FLAGS;					 // 2 bytes; INODE_FLAG_*
+	uint32_t	PARENT;						 // 4 bytes; Directory holding the entry for this inode (the root is its own parent)
+	uint32_t	DIRECTORY_ROOT;				 // 4 bytes; Directories: root block of the entry tree
+	uint32_t	DIRECTORY_ENTRIES;			 // 4 bytes; Directories: entries in the tree
 } INODE;
 
+// A mounted store. Any number of threads can use a volume: calls on different files run in parallel, as do reads of
+// the same file. Writes have their file to themselves, and commit points (see the batches below) the whole volume.
+typedef struct nRTOS_Volume VOLUME;
+
+// Readahead: once OSFS_Read calls on a file pick up where the previous one stopped, the blocks after the read are
+// fetched ahead of the reader. The window starts at READAHEAD_MIN_BLOCKS and doubles with every sequential read, up
+// to READAHEAD_MAX_BLOCKS; a read anywhere else closes it again.
+#define READAHEAD_MIN_BLOCKS 2
+#define READAHEAD_MAX_BLOCKS 16
+
 typedef struct nRTOS_FileInfo
 {
-	INODE*		FileInode;						// Inode associated with the file. Needs to be resident in memory.
+	INODE*		FileInode;						// Inode associated with the file. Points into the resident inode table.
+	VOLUME*		Volume;							// Volume the file was opened on
+
+	// Readahead state of this open file (updated atomically, reads of the same file can run in parallel)
+	uint64_t	NextSequential;					// Offset a sequential reader asks for next
+	uint32_t	ReadaheadBlocks;				// Current window (0 while reads look random)
+	uint32_t	ReadaheadEnd;					// File block just past the ones already fetched ahead
 } MYFILE;
 
-// Total inode space: 3950 * 114 = 450300 bytes (450 KB of inodes).
+// Streams a file front to back in chunks of up to CURSOR_CHUNK_SECTORS sectors, one read per chunk
+#define CURSOR_CHUNK_SECTORS 8
+typedef struct nRTOS_FileCursor
+{
+	MYFILE*		File;
+	uint64_t	Position;						// Next byte of the file to hand out
+	BYTE*		Chunk;							// CURSOR_CHUNK_SECTORS blocks
+} FILE_CURSOR;
+
+// Total inode space with the default geometry: 3952 * 120 = 474240 bytes (474 KB of inodes).
+
+// What OSFS_Format lays down. NumInodes is rounded up to fill the inode table blocks of every group.
+typedef struct nRTOS_Geometry
+{
+	uint32_t BlockSize;						// Bytes per block: a power of two from MIN_BLOCK_SIZE to MAX_BLOCK_SIZE
+	uint32_t NumBlocks;						// Blocks in the store, metadata included
+	uint32_t NumInodes;						// Most files the volume can hold
+} GEOMETRY;
 
 // Superblock definition. Contains properties about the file system.
 // NOTE: If this block is updated, be sure to update the read and write systems as well
 struct nRTOS_SuperBlock
 {
 	uint32_t NumInodes;
-	uint32_t NumDataBlocks;
+	uint32_t NumDataBlocks;					// Every block of the store, metadata included
+
+	uint32_t InodeStartBlock;				// Inode table slice of group 0
+
+	uint32_t Magic;							// SILK_MAGIC on every store laid down by OSFS_Format
+	uint32_t Version;						// On-disk layout revision (SILK_VERSION)
+
+	uint32_t JournalStartBlock;
+	uint32_t JournalBlocks;
+
+	uint32_t GroupTableBlock;
+	uint32_t NumGroups;
+	uint32_t BlocksPerGroup;
+	uint32_t InodesPerGroup;
+
+	uint32_t BlockSize;
+	uint32_t GroupTableBlocks;				// The descriptor table spills over as many blocks as it needs
+	uint32_t InodeBlocksPerGroup;			// Length of each group's inode table slice
+
+	// Sums of the groups' free counts. Kept current while mounted and logged in the same transactions as the groups.
+	uint32_t FreeBlocks;
+	uint32_t FreeInodes;
+
+	uint32_t ChecksumStartBlock;			// Checksum table of group 0
+	uint32_t ChecksumBlocksPerGroup;		// Length of each group's checksum table
+
+	uint32_t Checksum;						// CRC32C of everything above. Has to stay last.
+};
+
+#define SILK_MAGIC		0x4B4C4953			// "SILK"
+#define SILK_VERSION	11					// 2: inodes map their blocks with extents, 3: metadata journal, 4: block groups, 5: geometry in the superblock, 6: extent trees, 7: free counts in the superblock, 8: directories, 9: inline data, 10: compressed files, 11: block checksums
 
-	uint32_t InodeStartBlock;
+// Where a block group keeps its metadata, and how much of it is free. The table of these lives at GroupTableBlock.
+struct nRTOS_GroupDescriptor
+{
+	uint32_t FirstBlock;					// Block bit n of the group stands for block FirstBlock + n
+	uint32_t NumBlocks;
+	uint32_t FirstInode;					// Inode bit n of the group stands for inode FirstInode + n
+	uint32_t NumInodes;
 
+	uint32_t BlockBitMapBlock;
+	uint32_t InodeBitMapBlock;
+	uint32_t InodeTableBlock;				// InodeBlocksPerGroup blocks, followed by the ChecksumBlocksPerGroup of the checksum table
 
+	uint32_t FreeBlocks;
+	uint32_t FreeInodes;
 };
 
 // Allows us to read and write individual structures into nonvolatile storage
@@ -83,32 +203,139 @@ typedef struct nRTOS_Block
 
 } FLASH_BLOCK;
 
+// How the spoofed SD card is accessed while mounted
+typedef enum nRTOS_Mount_Modes
+{
+	MOUNT_POSITIONAL_IO = 0,					// Each sector access is a pread/pwrite on the store
+	MOUNT_MAPPED								// The store is mapped into memory; sector accesses are memcpy's, msync'd at commit points
+} MountMode;
+
+typedef struct nRTOS_MountOptions
+{
+	MountMode	Mode;
+	uint32_t	CacheSectors;					// Size of the write-back sector cache (0 disables it; unused when MOUNT_MAPPED)
+	bool		Compress;						// Files created while mounted keep their data compressed
+	bool		Format;							// Lay a new filesystem over whatever the store holds before mounting it
+} MOUNT_OPTIONS;
+
+// Asynchronous reads and writes. A submitted request is carried out by one of the volume's IO_WORKER_COUNT I/O
+// threads, exactly as the blocking call would, so requests can complete in any order. The request (and its file and
+// buffer) belongs to the volume until it completes.
+#define IO_WORKER_COUNT 4
+typedef enum nRTOS_IO_Operations
+{
+	IO_READ = 0,									// OSFS_Read
+	IO_WRITE										// OSFS_Write
+} IoOperation;
+
+typedef struct nRTOS_IoRequest IO_REQUEST;
+typedef void (*IO_CALLBACK)(IO_REQUEST* Request);
+
+struct nRTOS_IoRequest
+{
+	IoOperation	Operation;
+	MYFILE*		File;
+	BYTE*		Buffer;
+	uint32_t	NumBytes;
+	uint64_t	Offset;
+
+	IO_CALLBACK	Callback;						// Run on the I/O thread once the request is done (0 to collect it with OSFS_PollIO/OSFS_WaitIO instead)
+	void*		Context;						// Left alone, for the submitter's use
+
+	int32_t		Result;							// What the blocking call returned (TRUE once the bytes were read or written)
+};
+
+// Sector cache counters, as reported by OSFS_GetCacheStats
+typedef struct nRTOS_CacheStats
+{
+	uint32_t	CacheSectors;
+	uint64_t	Hits;
+	uint64_t	Misses;
+	uint64_t	Evictions;
+	uint64_t	WriteBacks;						// Dirty sectors written to the store (on eviction or flush)
+	uint64_t	Prefetched;						// Sectors brought in by readahead
+} CACHE_STATS;
+
+// One entry of a directory, as handed to a DIRECTORY_VISITOR by OSFS_ListDirectory
+typedef struct nRTOS_DirectoryItem
+{
+	char		Name[MAX_FILE_NAME_CHARS + 1];
+	bool		IsDirectory;
+	uint64_t	Bytes;							// Bytes stored in the file (0 for directories)
+} DIRECTORY_ITEM;
+
+typedef void (*DIRECTORY_VISITOR)(void* Context, DIRECTORY_ITEM* Item);
+
+// How full the volume is, as reported by OSFS_StatFS
+typedef struct nRTOS_StatFS
+{
+	uint32_t	BlockSize;
+	uint32_t	NumBlocks;						// Every block of the store, metadata included
+	uint32_t	FreeBlocks;
+	uint32_t	NumInodes;
+	uint32_t	FreeInodes;
+} STATFS;
+
 typedef enum nRTOS_File_Errors
 {
 	FILE_ALREADY_EXISTS = 1,
 	FILE_DOES_NOT_EXIST,
 	FILE_INIT_FAILED,
 	FILE_NAME_TOO_LONG,
+	FILE_NO_SPACE,								// Out of free blocks or inodes
+	FILE_TOO_LARGE,								// Past MAX_FILE_BLOCKS
+	FILE_NOT_A_DIRECTORY,						// A name along the path (or given to OSFS_RemoveDirectory) is a file
+	FILE_IS_A_DIRECTORY,						// Files only: the path names a directory
+	FILE_DIRECTORY_NOT_EMPTY,
+	FILE_CORRUPTED,								// A block read back does not match its checksum
 	FILE_OK
 } FileError;
 
 //***************************************** File System Function Calls ****************************************//
 
-bool 		OSFS_Format();				// Call this whenever you want to erase the entire disk
-MYFILE* 		OSFS_Create(char* fileName);	// Call this whenever a new file needs to be created
-MYFILE* 		OSFS_Open(char* fileName);	// Call this wehnever a file already created needs to be opened
-int32_t    	OSFS_Read(MYFILE* fileDescriptor, BYTE* Buffer, uint32_t numBytes, uint32_t Offset);
-bool 		OSFS_Write(MYFILE* fileDescriptor, BYTE* Buffer, uint32_t numBytes, uint32_t Offset);
+// Mounting. Any number of stores can be mounted at the same time, each through its own volume.
+VOLUME* 		OSFS_Mount(const char* StorePath, MOUNT_OPTIONS* Options);	// Formats the store if it is empty (0 if it cannot be opened, or holds anything but this layout)
+void 		OSFS_Unmount(VOLUME* volume);			// Commits everything and releases the volume, including the open store
+bool 		OSFS_Flush(VOLUME* volume);			// Writes every buffered sector back to the store
+// Batches: while one is open, Create, Delete and Close leave their metadata changes for OSFS_CommitBatch to commit
+// in one go. Batches nest; only the outermost commit counts.
+void 		OSFS_BeginBatch(VOLUME* volume);
+bool 		OSFS_CommitBatch(VOLUME* volume);
+void 		OSFS_GetCacheStats(VOLUME* volume, CACHE_STATS* Stats);
+
+bool 		OSFS_Format(VOLUME* volume, GEOMETRY* Geometry);	// Call this whenever you want to erase the entire disk (Geometry 0 keeps the current one)
+void 		OSFS_GetGeometry(VOLUME* volume, GEOMETRY* Geometry);
+void 		OSFS_StatFS(VOLUME* volume, STATFS* Stats);	// Free blocks and inodes, straight from the counts in the superblock
+MYFILE* 		OSFS_Create(VOLUME* volume, char* path);		// Call this whenever a new file needs to be created
+MYFILE* 		OSFS_Open(VOLUME* volume, char* path);		// Call this wehnever a file already created needs to be opened
+int32_t    	OSFS_Read(MYFILE* fileDescriptor, BYTE* Buffer, uint32_t numBytes, uint64_t Offset);
+bool 		OSFS_Write(MYFILE* fileDescriptor, BYTE* Buffer, uint32_t numBytes, uint64_t Offset);
 bool 		OSFS_Append(MYFILE* fileDescriptor, BYTE* buffer, uint32_t numBytes);
 bool 		OSFS_Close(MYFILE* fileToClose);
-bool 		OSFS_Delete(char* fileName);
+bool 		OSFS_Delete(VOLUME* volume, char* path);
+
+// Directories. Paths are taken from the root directory, whether or not they start with "/".
+bool 		OSFS_MakeDirectory(VOLUME* volume, char* path);
+bool 		OSFS_RemoveDirectory(VOLUME* volume, char* path);	// Only empty directories can be removed
+bool 		OSFS_IsDirectory(VOLUME* volume, char* path);
+bool 		OSFS_ListDirectory(VOLUME* volume, char* path, DIRECTORY_VISITOR Visit, void* Context);	// Visit every entry, in no particular order
+
+// Asynchronous I/O. Requests without a callback are handed back, in the order they complete, by these.
+bool 		OSFS_SubmitIO(IO_REQUEST* Request);	// Queue the request (FALSE if it could not be)
+IO_REQUEST* 	OSFS_PollIO(VOLUME* volume);			// A completed request, or 0 if none has completed yet
+IO_REQUEST* 	OSFS_WaitIO(VOLUME* volume);			// Waits for a request to complete (0 straight away if none is outstanding)
+
+// Streaming reads
+FILE_CURSOR* OSFS_OpenCursor(MYFILE* fileToStream);
+int32_t 		OSFS_CursorNext(FILE_CURSOR* cursor, BYTE** Chunk);	// Bytes in *Chunk, 0 once the whole file was handed out, -1 on error
+void 		OSFS_CloseCursor(FILE_CURSOR* cursor);
 
 // File Information functions
-uint32_t 	GetFileSize(MYFILE* fileToEval); // Returns the size of the file currently held
+uint64_t 	GetFileSize(MYFILE* fileToEval); // Returns the size of the file currently held
 
 
 
-void 		SerialListFiles();			// Call this whenever you want to output the directory list to the serial output
+void 		SerialListFiles(VOLUME* volume, char* path);	// Call this whenever you want to output the directory list to the serial output
 void 		SerialPrintFile(MYFILE* fileToPrint);
-FileError 	OSFS_GetError();				// Returns the reason why the file was not created/opened/closed/etc.
+FileError 	OSFS_GetError(VOLUME* volume);		// Returns the reason why the last file call on the volume failed
 #endif /* OS_FILESYS_OS_FILESYSTEM_H_ */
@@ -0,0 +1,404 @@
+/*
+ * SectorCache.c
+ *
+ *  Created on: Oct 18, 2026
+ */
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include "SectorCache.h"
+#include "venkatlib.h"
+
+// Used by SectorCache_Flush to order write backs
+typedef struct NNODE_DirtySector
+{
+	uint64_t SectorNum;
+	int32_t	 Entry;
+} DirtySector;
+
+// Private helpers
+int32_t _SectorCache_Find(SectorCache* cache, uint64_t SectorNum);
+void 	_SectorCache_Unlink(SectorCache* cache, int32_t Entry);			// Remove from the LRU list
+void 	_SectorCache_MakeMostRecent(SectorCache* cache, int32_t Entry);
+void 	_SectorCache_Unhash(SectorCache* cache, int32_t Entry);
+int32_t _SectorCache_Claim(SectorCache* cache, uint64_t SectorNum);		// Free up an entry (evicting if needed) and hash it to SectorNum
+int 	_SectorCache_CompareSectors(const void* first, const void* second);
+
+SectorCache* SectorCache_Init(uint32_t NumSectors, uint32_t SectorSize, SectorIO ReadSector, SectorIO WriteSector, void* Context)
+{
+	if (NumSectors == 0) return 0;
+
+	SectorCache* NewCache = (SectorCache*) calloc(1, sizeof(SectorCache));
+
+	// if memory allocation failed, return immediately
+	if (NewCache == 0)
+	{
+		return 0;
+	}
+
+	if (pthread_mutex_init(&NewCache->Lock, 0) != 0)
+	{
+		free(NewCache);
+		return 0;
+	}
+
+	NewCache->NumBuckets = 1;
+	while (NewCache->NumBuckets < NumSectors * 2) NewCache->NumBuckets <<= 1;	// Keep the chains short
+
+	NewCache->Entries 	= (CacheEntry*) calloc(NumSectors, sizeof(CacheEntry));
+	NewCache->Buckets 	= (int32_t*) malloc(sizeof(int32_t) * NewCache->NumBuckets);
+	NewCache->Data 		= (BYTE*) malloc((size_t) NumSectors * SectorSize);
+
+	// if memory allocation failed, clean up the created allocations and return
+	if (NewCache->Entries == 0 || NewCache->Buckets == 0 || NewCache->Data == 0)
+	{
+		SectorCache_DeInit(NewCache);
+		return 0;
+	}
+
+	NewCache->NumEntries 	= NumSectors;
+	NewCache->SectorSize 	= SectorSize;
+	NewCache->ReadSector 	= ReadSector;
+	NewCache->WriteSector 	= WriteSector;
+	NewCache->Context 		= Context;
+
+	SectorCache_Invalidate(NewCache);
+
+	return NewCache;
+}
+
+bool SectorCache_Read(SectorCache* cache, BYTE* Buffer, uint64_t SectorNum)
+{
+	pthread_mutex_lock(&cache->Lock);
+
+	int32_t Entry = _SectorCache_Find(cache, SectorNum);
+
+	if (Entry >= 0)
+	{
+		cache->Hits++;
+	}
+	else
+	{
+		cache->Misses++;
+
+		Entry = _SectorCache_Claim(cache, SectorNum);
+
+		if (Entry >= 0 && cache->ReadSector(cache->Context, &cache->Data[(size_t) Entry * cache->SectorSize], SectorNum) == FALSE)
+		{
+			_SectorCache_Unhash(cache, Entry);
+			Entry = -1;
+		}
+	}
+
+	if (Entry >= 0)
+	{
+		_SectorCache_MakeMostRecent(cache, Entry);
+		memcpy(Buffer, &cache->Data[(size_t) Entry * cache->SectorSize], cache->SectorSize);
+	}
+
+	pthread_mutex_unlock(&cache->Lock);
+
+	return (bool) (Entry >= 0);
+}
+
+// Whole sector writes never need the old contents, so a miss does not read from the backing store
+bool SectorCache_Write(SectorCache* cache, BYTE* Buffer, uint64_t SectorNum)
+{
+	pthread_mutex_lock(&cache->Lock);
+
+	int32_t Entry = _SectorCache_Find(cache, SectorNum);
+
+	if (Entry >= 0)
+	{
+		cache->Hits++;
+	}
+	else
+	{
+		cache->Misses++;
+
+		Entry = _SectorCache_Claim(cache, SectorNum);
+	}
+
+	if (Entry >= 0)
+	{
+		memcpy(&cache->Data[(size_t) Entry * cache->SectorSize], Buffer, cache->SectorSize);
+		cache->Entries[Entry].Dirty = TRUE;
+		_SectorCache_MakeMostRecent(cache, Entry);
+	}
+
+	pthread_mutex_unlock(&cache->Lock);
+
+	return (bool) (Entry >= 0);
+}
+
+// Lets run-sized reads go straight to the backing store: once it is clean, the store has the newest copy of every sector in the run
+bool SectorCache_Clean(SectorCache* cache, uint64_t SectorNum, uint32_t NumSectors)
+{
+	uint32_t SectorIterator = 0;
+	bool	 AllWritten 	= TRUE;
+
+	pthread_mutex_lock(&cache->Lock);
+
+	for (SectorIterator = 0; SectorIterator < NumSectors; SectorIterator++)
+	{
+		int32_t Entry = _SectorCache_Find(cache, SectorNum + SectorIterator);
+
+		if (Entry < 0 || cache->Entries[Entry].Dirty == FALSE) continue;
+
+		if (cache->WriteSector(cache->Context, &cache->Data[(size_t) Entry * cache->SectorSize], SectorNum + SectorIterator))
+		{
+			cache->Entries[Entry].Dirty = FALSE;
+			cache->WriteBacks++;
+		}
+		else
+		{
+			AllWritten = FALSE;
+		}
+	}
+
+	pthread_mutex_unlock(&cache->Lock);
+
+	return AllWritten;
+}
+
+// Stops at the first miss, so the caller reads the rest of the run from the store in one go
+uint32_t SectorCache_ReadCached(SectorCache* cache, BYTE* Buffer, uint64_t SectorNum, uint32_t NumSectors)
+{
+	uint32_t SectorIterator = 0;
+
+	pthread_mutex_lock(&cache->Lock);
+
+	for (SectorIterator = 0; SectorIterator < NumSectors; SectorIterator++)
+	{
+		int32_t Entry = _SectorCache_Find(cache, SectorNum + SectorIterator);
+
+		if (Entry < 0) break;
+
+		cache->Hits++;
+		_SectorCache_MakeMostRecent(cache, Entry);
+		memcpy(&Buffer[(size_t) SectorIterator * cache->SectorSize], &cache->Data[(size_t) Entry * cache->SectorSize], cache->SectorSize);
+	}
+
+	pthread_mutex_unlock(&cache->Lock);
+
+	return SectorIterator;
+}
+
+// Sectors already cached are left alone: whatever the cache holds is at least as new as the store.
+void SectorCache_Fill(SectorCache* cache, BYTE* Buffer, uint64_t SectorNum, uint32_t NumSectors)
+{
+	uint32_t SectorIterator = 0;
+
+	pthread_mutex_lock(&cache->Lock);
+
+	for (SectorIterator = 0; SectorIterator < NumSectors; SectorIterator++)
+	{
+		if (_SectorCache_Find(cache, SectorNum + SectorIterator) >= 0) continue;
+
+		int32_t Entry = _SectorCache_Claim(cache, SectorNum + SectorIterator);
+
+		if (Entry < 0) break;															// Could not write back the victim
+
+		memcpy(&cache->Data[(size_t) Entry * cache->SectorSize], &Buffer[(size_t) SectorIterator * cache->SectorSize], cache->SectorSize);
+		_SectorCache_MakeMostRecent(cache, Entry);
+		cache->Prefetched++;
+	}
+
+	pthread_mutex_unlock(&cache->Lock);
+}
+
+// The backing store is about to get the newest copy, so a cached copy is refreshed and no longer dirty.
+// Called before the store is written, so an eviction racing with the write can only ever write back the new contents.
+void SectorCache_Update(SectorCache* cache, BYTE* Buffer, uint64_t SectorNum)
+{
+	pthread_mutex_lock(&cache->Lock);
+
+	int32_t Entry = _SectorCache_Find(cache, SectorNum);
+
+	if (Entry >= 0)
+	{
+		memcpy(&cache->Data[(size_t) Entry * cache->SectorSize], Buffer, cache->SectorSize);
+		cache->Entries[Entry].Dirty = FALSE;
+	}
+
+	pthread_mutex_unlock(&cache->Lock);
+}
+
+bool SectorCache_Flush(SectorCache* cache)
+{
+	DirtySector* DirtySectors = (DirtySector*) malloc(sizeof(DirtySector) * cache->NumEntries);
+	uint32_t NumDirty = 0;
+	uint32_t EntryIterator = 0;
+	bool	 AllWritten = TRUE;
+
+	if (DirtySectors == 0) return FALSE;
+
+	pthread_mutex_lock(&cache->Lock);
+
+	for (EntryIterator = 0; EntryIterator < cache->NumEntries; EntryIterator++)
+	{
+		if (cache->Entries[EntryIterator].Valid && cache->Entries[EntryIterator].Dirty)
+		{
+			DirtySectors[NumDirty].SectorNum 	= cache->Entries[EntryIterator].SectorNum;
+			DirtySectors[NumDirty].Entry 		= EntryIterator;
+			NumDirty++;
+		}
+	}
+
+	// Writing back in sector order keeps the store accesses as sequential as possible
+	qsort(DirtySectors, NumDirty, sizeof(DirtySector), _SectorCache_CompareSectors);
+
+	for (EntryIterator = 0; EntryIterator < NumDirty; EntryIterator++)
+	{
+		int32_t Entry = DirtySectors[EntryIterator].Entry;
+
+		if (cache->WriteSector(cache->Context, &cache->Data[(size_t) Entry * cache->SectorSize], cache->Entries[Entry].SectorNum))
+		{
+			cache->Entries[Entry].Dirty = FALSE;
+			cache->WriteBacks++;
+		}
+		else
+		{
+			AllWritten = FALSE;
+		}
+	}
+
+	pthread_mutex_unlock(&cache->Lock);
+
+	free(DirtySectors);
+
+	return AllWritten;
+}
+
+void SectorCache_Invalidate(SectorCache* cache)
+{
+	uint32_t Iterator = 0;
+
+	pthread_mutex_lock(&cache->Lock);
+
+	for (Iterator = 0; Iterator < cache->NumBuckets; Iterator++)
+	{
+		cache->Buckets[Iterator] = -1;
+	}
+
+	// Every entry starts out invalid and chained oldest-first, entry 0 being the first victim
+	for (Iterator = 0; Iterator < cache->NumEntries; Iterator++)
+	{
+		cache->Entries[Iterator].Valid 			= FALSE;
+		cache->Entries[Iterator].Dirty 			= FALSE;
+		cache->Entries[Iterator].NextInBucket 	= -1;
+		cache->Entries[Iterator].Older 			= (int32_t) Iterator - 1;
+		cache->Entries[Iterator].Newer 			= (Iterator + 1 < cache->NumEntries) ? (int32_t) Iterator + 1 : -1;
+	}
+
+	cache->LeastRecent 	= 0;
+	cache->MostRecent 	= (int32_t) cache->NumEntries - 1;
+
+	pthread_mutex_unlock(&cache->Lock);
+}
+
+void SectorCache_DeInit(SectorCache* cache)
+{
+	pthread_mutex_destroy(&cache->Lock);
+	free(cache->Entries);
+	free(cache->Buckets);
+	free(cache->Data);
+	free(cache);
+
+	cache = 0;
+}
+
+//***************************************** Private Functions ************************************//
+
+int32_t _SectorCache_Find(SectorCache* cache, uint64_t SectorNum)
+{
+	int32_t Entry = cache->Buckets[SectorNum & (cache->NumBuckets - 1)];
+
+	while (Entry >= 0 && cache->Entries[Entry].SectorNum != SectorNum)
+	{
+		Entry = cache->Entries[Entry].NextInBucket;
+	}
+
+	return Entry;
+}
+
+void _SectorCache_Unlink(SectorCache* cache, int32_t Entry)
+{
+	CacheEntry* Unlinked = &cache->Entries[Entry];
+
+	if (Unlinked->Newer >= 0) cache->Entries[Unlinked->Newer].Older = Unlinked->Older;
+	else cache->MostRecent = Unlinked->Older;
+
+	if (Unlinked->Older >= 0) cache->Entries[Unlinked->Older].Newer = Unlinked->Newer;
+	else cache->LeastRecent = Unlinked->Newer;
+
+	Unlinked->Newer = -1;
+	Unlinked->Older = -1;
+}
+
+void _SectorCache_MakeMostRecent(SectorCache* cache, int32_t Entry)
+{
+	if (cache->MostRecent == Entry) return;
+
+	_SectorCache_Unlink(cache, Entry);
+
+	cache->Entries[Entry].Older = cache->MostRecent;
+	if (cache->MostRecent >= 0) cache->Entries[cache->MostRecent].Newer = Entry;
+	cache->MostRecent = Entry;
+
+	if (cache->LeastRecent < 0) cache->LeastRecent = Entry;
+}
+
+// Removes the entry from its hash chain and marks it as invalid. Its slot stays in the LRU list.
+void _SectorCache_Unhash(SectorCache* cache, int32_t Entry)
+{
+	CacheEntry* Unhashed = &cache->Entries[Entry];
+	int32_t* Link = &cache->Buckets[Unhashed->SectorNum & (cache->NumBuckets - 1)];
+
+	if (Unhashed->Valid == FALSE) return;
+
+	while (*Link != Entry) Link = &cache->Entries[*Link].NextInBucket;
+
+	*Link = Unhashed->NextInBucket;
+
+	Unhashed->NextInBucket 	= -1;
+	Unhashed->Valid 		= FALSE;
+	Unhashed->Dirty 		= FALSE;
+}
+
+int32_t _SectorCache_Claim(SectorCache* cache, uint64_t SectorNum)
+{
+	int32_t Victim = cache->LeastRecent;
+	CacheEntry* Claimed = &cache->Entries[Victim];
+
+	if (Claimed->Valid)
+	{
+		// A dirty victim has to make it to the store before its slot can be reused
+		if (Claimed->Dirty)
+		{
+			if (cache->WriteSector(cache->Context, &cache->Data[(size_t) Victim * cache->SectorSize], Claimed->SectorNum) == FALSE) return -1;
+			cache->WriteBacks++;
+		}
+
+		_SectorCache_Unhash(cache, Victim);
+		cache->Evictions++;
+	}
+
+	int32_t* Bucket = &cache->Buckets[SectorNum & (cache->NumBuckets - 1)];
+
+	Claimed->SectorNum 		= SectorNum;
+	Claimed->Valid 			= TRUE;
+	Claimed->Dirty 			= FALSE;
+	Claimed->NextInBucket 	= *Bucket;
+	*Bucket = Victim;
+
+	return Victim;
+}
+
+int _SectorCache_CompareSectors(const void* first, const void* second)
+{
+	uint64_t FirstSector 	= ((const DirtySector*) first)->SectorNum;
+	uint64_t SecondSector 	= ((const DirtySector*) second)->SectorNum;
+
+	return (FirstSector > SecondSector) - (FirstSector < SecondSector);
+}
@@ -0,0 +1,65 @@
+/*
+ * SectorCache.h
+ *
+ *  Created on: Oct 18, 2026
+ */
+
+#ifndef OS_FILESYS_SECTORCACHE_SECTORCACHE_H_
+#define OS_FILESYS_SECTORCACHE_SECTORCACHE_H_
+#include <pthread.h>
+#ifndef LAB3_VRTOS_EXTERNAL_LIBRARIES_VENKATWARE_VENKATLIB_H_
+#include "venkatlib.h"
+#endif
+
+// Backing store accessors the cache reads misses from and writes dirty sectors back to. Context is handed through as is.
+typedef bool (*SectorIO)(void* Context, BYTE* Buffer, uint64_t SectorNum);
+
+typedef struct NNODE_CacheEntry
+{
+	uint64_t SectorNum;
+	bool	 Valid;
+	bool	 Dirty;
+
+	int32_t	 NextInBucket;		// Next entry hashed to the same bucket (-1 ends the chain)
+	int32_t	 Newer;				// LRU neighbours (-1 at either end)
+	int32_t	 Older;
+} CacheEntry;
+
+// Every call holds the cache's lock for its whole duration, backing store accesses included
+typedef struct NNODE_SectorCache
+{
+	pthread_mutex_t	Lock;
+
+	uint32_t	NumEntries;
+	uint32_t	SectorSize;
+	uint32_t	NumBuckets;		// Power of two
+
+	CacheEntry*	Entries;
+	int32_t*	Buckets;
+	BYTE*		Data;			// NumEntries * SectorSize bytes, entry i owns the i-th sector sized slice
+
+	int32_t		MostRecent;
+	int32_t		LeastRecent;	// Eviction victim
+
+	SectorIO	ReadSector;
+	SectorIO	WriteSector;
+	void*		Context;
+
+	uint64_t	Hits;
+	uint64_t	Misses;
+	uint64_t	Evictions;
+	uint64_t	WriteBacks;
+	uint64_t	Prefetched;		// Sectors brought in by SectorCache_Fill
+} SectorCache;
+
+SectorCache* SectorCache_Init(uint32_t NumSectors, uint32_t SectorSize, SectorIO ReadSector, SectorIO WriteSector, void* Context);
+bool	SectorCache_Read(SectorCache* cache, BYTE* Buffer, uint64_t SectorNum);
+bool	SectorCache_Write(SectorCache* cache, BYTE* Buffer, uint64_t SectorNum);
+uint32_t SectorCache_ReadCached(SectorCache* cache, BYTE* Buffer, uint64_t SectorNum, uint32_t NumSectors);	// Copy out the cached sectors at the front of the run; returns how many
+void	SectorCache_Fill(SectorCache* cache, BYTE* Buffer, uint64_t SectorNum, uint32_t NumSectors);	// Cache sectors just read from the backing store (readahead)
+bool	SectorCache_Clean(SectorCache* cache, uint64_t SectorNum, uint32_t NumSectors);	// Write back whichever of these sectors are dirty (no LRU or counter updates)
+void	SectorCache_Update(SectorCache* cache, BYTE* Buffer, uint64_t SectorNum);	// The sector was written around the cache; refresh any cached copy
+bool	SectorCache_Flush(SectorCache* cache);			// Write every dirty sector back, in sector order
+void	SectorCache_Invalidate(SectorCache* cache);		// Drop every sector without writing anything back
+void	SectorCache_DeInit(SectorCache* cache);
+#endif /* OS_FILESYS_SECTORCACHE_SECTORCACHE_H_ */
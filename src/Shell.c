@@ -12,7 +12,7 @@
 #include "Shell.h"
 #include "OS_FileSystemScheme.h"
 
-#define COMMAND_COUNT 7
+#define COMMAND_COUNT 14
 
 typedef void (*fp)(int); //Declares a type of a void function that accepts an int
 extern void OutCRLF(void);
@@ -26,6 +26,13 @@ void Shell_AppendToFile(int one);
 void Shell_PrintFile(int one);
 void Shell_FormatFS(int one);
 void Shell_LS(int one);
+void Shell_Stats(int one);
+void Shell_MakeFS(int one);
+void Shell_DF(int one);
+void Shell_MakeDirectory(int one);
+void Shell_RemoveDirectory(int one);
+void Shell_ChangeDirectory(int one);
+void Shell_PrintDirectory(int one);
 
 char*			commandDef[]			=		{
 												"help:\n Output command information.\n\n",
@@ -33,8 +40,15 @@ char*			commandDef[]			=		{
 												"del:\n Deletes a file\n\n",
 												"app:\n Appends attached string to the end of the file\n\n",
 												"printfile:\n Prints content of file\n\n",
-												"ls:\n List all the files on the SD card.\n\n",
-												"format:\n Formats the entire filesystem.\n\n"
+												"ls:\n List the files and directories in the working directory.\n\n",
+												"format:\n Formats the entire filesystem.\n\n",
+												"stats:\n Prints the sector cache counters.\n\n",
+												"mkfs:\n Formats the filesystem with a new block size, block count and inode count.\n\n",
+												"df:\n Prints how many blocks and inodes are used and free.\n\n",
+												"mkdir:\n Creates an empty directory.\n\n",
+												"rmdir:\n Removes an empty directory.\n\n",
+												"cd:\n Changes the working directory.\n\n",
+												"pwd:\n Prints the working directory.\n\n"
 												};
 
 char* 			commandFormat[]		= 		{
@@ -44,7 +58,14 @@ char* 			commandFormat[]		= 		{
 												"app <filename> <string>\n",
 												"printfile <filename>\n",
 												"format\n",
-												"ls\n"
+												"ls\n",
+												"stats\n",
+												"mkfs <blocksize> <blocks> <inodes>\n",
+												"df\n",
+												"mkdir <path>\n",
+												"rmdir <path>\n",
+												"cd <path>\n",
+												"pwd\n"
 											};
 
 char* 			commands[] 			= 		{
@@ -54,8 +75,14 @@ char* 			commands[] 			= 		{
 												"app",
 												"printfile",
 												"format",
-												"ls"
-
+												"ls",
+												"stats",
+												"mkfs",
+												"df",
+												"mkdir",
+												"rmdir",
+												"cd",
+												"pwd"
 											};
 
 fp 				function_array[] 	= 		{
@@ -65,7 +92,14 @@ fp 				function_array[] 	= 		{
 												Shell_AppendToFile,
 												Shell_PrintFile,
 												Shell_FormatFS,
-												Shell_LS
+												Shell_LS,
+												Shell_Stats,
+												Shell_MakeFS,
+												Shell_DF,
+												Shell_MakeDirectory,
+												Shell_RemoveDirectory,
+												Shell_ChangeDirectory,
+												Shell_PrintDirectory
 											};
 
 unsigned int		CommandCount[]	    =       {
@@ -75,6 +109,13 @@ unsigned int		CommandCount[]	    =       {
 												2,
 												1,
 												0,
+												0,
+												0,
+												3,
+												0,
+												1,
+												1,
+												1,
 												0
 											};
 
@@ -86,6 +127,10 @@ unsigned int CurrentCommandParamCount;
 char* Command;
 char ExecuteName[PARAMS_MAX_SIZE];
 
+VOLUME* ShellVolume;		// Volume every command works on
+char WorkingDirectory[PARAMS_MAX_SIZE] = "/";	// Always absolute and normalized
+char CommandPath[PARAMS_MAX_SIZE];				// The path the running command works on
+
 
 void OutCRLF(void)
 {
@@ -93,12 +138,14 @@ void OutCRLF(void)
     putchar(LF);
 }
 
-void Interpreter()
+void Interpreter(VOLUME* volume)
 {
     char *line = NULL;  /* forces getline to allocate with malloc */
     size_t len = 0;     /* ignored when line = NULL */
     ssize_t read;
 
+    ShellVolume = volume;
+
     printf("Please enter command:");
     //ADC_Open(0, 1000);
     OutCRLF();
@@ -143,17 +190,17 @@ void Shell_CommandTokenize(char* pCommand)
 
 	char* Token = strtok(pCommand, " ");
 
-	while (Token)
+	while (Token && TokenIterator < PARAMS_MAX_NUM)
 	{
 
-		strcpy(CommandTokens[TokenIterator], Token);
+		strncpy(CommandTokens[TokenIterator], Token, PARAMS_MAX_SIZE - 1);
 
 		Token = strtok(NULL, " ");
 
 	    TokenIterator++;
 	}
 
-	CurrentCommandParamCount = TokenIterator - 1; // Do not count the command name itself
+	CurrentCommandParamCount = (TokenIterator > 0) ? TokenIterator - 1 : 0; // Do not count the command name itself
 
 }
 
@@ -202,9 +249,76 @@ void Shell_StringRegex(char* src, char* dst) // Null terminated strings
 
 void Shell_RunCommand(unsigned int Index)
 {
+	if (CommandCount[Index] > 0 && Shell_FullPath(CommandTokens[1], CommandPath) == FALSE)
+	{
+		printf("\nPath too long. Please limit paths to %u characters.\n", PARAMS_MAX_SIZE - 1);
+		return;
+	}
+
+	if (CommandCount[Index] == 0) strcpy(CommandPath, WorkingDirectory);
+
 	function_array[Index](0);
 }
 
+// A path cut short could name some other file, so one that does not fit is turned down instead
+bool Shell_FullPath(char* path, char* fullPath)
+{
+	int Length = (path[0] == '/') ? snprintf(fullPath, PARAMS_MAX_SIZE, "%s", path) :
+									snprintf(fullPath, PARAMS_MAX_SIZE, "%s/%s", WorkingDirectory, path);
+
+	if (Length < 0 || Length >= PARAMS_MAX_SIZE) return FALSE;
+
+	Shell_NormalizePath(fullPath);
+
+	return TRUE;
+}
+
+// The volume has no links, so a directory's ".." is always the one the path came through
+void Shell_NormalizePath(char* path)
+{
+	char* Source 		= path;
+	char* Destination 	= path;
+
+	while (*Source)
+	{
+		size_t Length = strcspn(Source, "/");
+
+		if (Length == 0 || (Length == 1 && Source[0] == '.'))
+		{
+			// Nothing to keep
+		}
+		else if (Length == 2 && Source[0] == '.' && Source[1] == '.')
+		{
+			while (Destination > path && *(--Destination) != '/');
+		}
+		else
+		{
+			*Destination++ = '/';
+			memmove(Destination, Source, Length);
+			Destination += Length;
+		}
+
+		Source += Length;
+		if (*Source == '/') Source++;
+	}
+
+	if (Destination == path) *Destination++ = '/';
+	*Destination = 0;
+}
+
+void Shell_PrintError(FileError Error)
+{
+	if (Error == FILE_ALREADY_EXISTS) printf("\nFile already exists.\n");
+	else if (Error == FILE_DOES_NOT_EXIST) printf("\nFile not found.\n");
+	else if (Error == FILE_NAME_TOO_LONG) printf("\nName too long. Please limit every name along the path to %u characters.\n", MAX_FILE_NAME_CHARS);
+	else if (Error == FILE_NO_SPACE) printf("\nNo space left on the volume.\n");
+	else if (Error == FILE_NOT_A_DIRECTORY) printf("\nNot a directory.\n");
+	else if (Error == FILE_IS_A_DIRECTORY) printf("\nIs a directory.\n");
+	else if (Error == FILE_DIRECTORY_NOT_EMPTY) printf("\nDirectory not empty.\n");
+	else if (Error == FILE_CORRUPTED) printf("\nThe data failed its checksum, the store is damaged.\n");
+	else printf("\nAn Error Occurred.\n");
+}
+
 void Help_Output(int one)
 {
 	int i = 0;
@@ -227,39 +341,39 @@ void Help_Output(int one)
 
 void Shell_NewFile(int one)
 {
-	if (OSFS_Create(CommandTokens[1]))
+	MYFILE* CreatedFile = OSFS_Create(ShellVolume, CommandPath);
+
+	if (CreatedFile)
 	{
+		OSFS_Close(CreatedFile);
 		printf("\nCreated.\n");
 	}
 	else
 	{
-		if (OSFS_GetError() == FILE_ALREADY_EXISTS) printf("\nFile already exists.\n");
-		else if(OSFS_GetError() == FILE_NAME_TOO_LONG) printf("\nFile name too long. Please limit it to 9 characters.\n");
+		Shell_PrintError(OSFS_GetError(ShellVolume));
 	}
 }
 
 void Shell_DeleteFile(int one)
 {
-	if (OSFS_Delete(CommandTokens[1]))
+	if (OSFS_Delete(ShellVolume, CommandPath))
 	{
 		printf("\nDeleted.\n");
 	}
 	else
 	{
-		if (OSFS_GetError() == FILE_DOES_NOT_EXIST) printf("\nFile not found.\n");
-		else printf("\nAn Error Occurred.\n");
+		Shell_PrintError(OSFS_GetError(ShellVolume));
 	}
 }
 
 void Shell_AppendToFile(int one)
 {
-	MYFILE* OpenedFile = OSFS_Open(CommandTokens[1]);
+	MYFILE* OpenedFile = OSFS_Open(ShellVolume, CommandPath);
 
 
 	if (OpenedFile == 0)
 	{
-		if (OSFS_GetError() == FILE_DOES_NOT_EXIST) printf("\nFile not found.\n");
-		else printf("\nAn Error Occurred.\n");
+		Shell_PrintError(OSFS_GetError(ShellVolume));
 		return;
 	}
 
@@ -267,6 +381,10 @@ void Shell_AppendToFile(int one)
 	{
 		printf("\nAppended.\n");
 	}
+	else if (OSFS_GetError(ShellVolume) == FILE_NO_SPACE)
+	{
+		printf("\nNo space left on the volume.\n");
+	}
 
 	OSFS_Close(OpenedFile);
 
@@ -276,13 +394,12 @@ void Shell_AppendToFile(int one)
 void Shell_PrintFile(int one)
 {
 	printf("\n");
-	MYFILE* OpenedFile = OSFS_Open(CommandTokens[1]);
+	MYFILE* OpenedFile = OSFS_Open(ShellVolume, CommandPath);
 
 	if (OpenedFile == 0)
 	{
         printf("Opening file: %s", CommandTokens[1]);
-		if (OSFS_GetError() == FILE_DOES_NOT_EXIST) printf("\nFile not found.\n");
-		else printf("\nAn Error Occurred.\n");
+		Shell_PrintError(OSFS_GetError(ShellVolume));
 		return;
 	}
 
@@ -291,20 +408,96 @@ void Shell_PrintFile(int one)
 	printf("\n");
 }
 
-extern bool DiskInitialized;
 extern int main();
 void Shell_FormatFS(int one)
 {
 	printf("\nFormatting the filesystem.\n");
-	DiskInitialized = FALSE;
-	OSFS_Format();
+	OSFS_Format(ShellVolume, 0);
+	strcpy(WorkingDirectory, "/");
 	printf("\nPlease restart device.\n");
-    OSFS_Init();
 }
 
 void Shell_LS(int one)
 {
 	printf("\n");
-	SerialListFiles();
+	SerialListFiles(ShellVolume, CommandPath);
+}
+
+void Shell_Stats(int one)
+{
+	CACHE_STATS Stats;
+	OSFS_GetCacheStats(ShellVolume, &Stats);
+
+	printf("\nCache sectors: %u\n", Stats.CacheSectors);
+	printf("Hits: %llu\n", (unsigned long long) Stats.Hits);
+	printf("Misses: %llu\n", (unsigned long long) Stats.Misses);
+	printf("Evictions: %llu\n", (unsigned long long) Stats.Evictions);
+	printf("Write backs: %llu\n", (unsigned long long) Stats.WriteBacks);
+	printf("Prefetched: %llu\n", (unsigned long long) Stats.Prefetched);
+}
+
+void Shell_MakeFS(int one)
+{
+	GEOMETRY Geometry;
+
+	Geometry.BlockSize = (uint32_t) strtoul(CommandTokens[1], 0, 10);
+	Geometry.NumBlocks = (uint32_t) strtoul(CommandTokens[2], 0, 10);
+	Geometry.NumInodes = (uint32_t) strtoul(CommandTokens[3], 0, 10);
+
+	printf("\nFormatting the filesystem.\n");
+
+	if (OSFS_Format(ShellVolume, &Geometry) == FALSE)
+	{
+		printf("\nThat geometry cannot be laid out. Block sizes are powers of two from %u to %u bytes.\n", MIN_BLOCK_SIZE, MAX_BLOCK_SIZE);
+		return;
+	}
+
+	strcpy(WorkingDirectory, "/");
+
+	OSFS_GetGeometry(ShellVolume, &Geometry);
+	printf("\n%u blocks of %u bytes, %u inodes.\n", Geometry.NumBlocks, Geometry.BlockSize, Geometry.NumInodes);
+}
+
+void Shell_DF(int one)
+{
+	STATFS Stats;
+	OSFS_StatFS(ShellVolume, &Stats);
+
+	uint32_t UsedBlocks = Stats.NumBlocks - Stats.FreeBlocks;
+	uint32_t UsedInodes = Stats.NumInodes - Stats.FreeInodes;
+
+	printf("\n%u byte blocks: %u total, %u used, %u free (%llu%% used)\n", Stats.BlockSize, Stats.NumBlocks, UsedBlocks, Stats.FreeBlocks,
+			(unsigned long long) UsedBlocks * 100 / Stats.NumBlocks);
+	printf("Inodes: %u total, %u used, %u free (%llu%% used)\n", Stats.NumInodes, UsedInodes, Stats.FreeInodes,
+			(unsigned long long) UsedInodes * 100 / Stats.NumInodes);
+}
+
+void Shell_MakeDirectory(int one)
+{
+	if (OSFS_MakeDirectory(ShellVolume, CommandPath)) printf("\nCreated.\n");
+	else Shell_PrintError(OSFS_GetError(ShellVolume));
 }
 
+void Shell_RemoveDirectory(int one)
+{
+	if (OSFS_RemoveDirectory(ShellVolume, CommandPath)) printf("\nRemoved.\n");
+	else Shell_PrintError(OSFS_GetError(ShellVolume));
+}
+
+void Shell_ChangeDirectory(int one)
+{
+	if (OSFS_IsDirectory(ShellVolume, CommandPath))
+	{
+		strcpy(WorkingDirectory, CommandPath);
+		printf("\n%s\n", WorkingDirectory);
+	}
+	else
+	{
+		printf("\nNo such directory.\n");
+	}
+}
+
+void Shell_PrintDirectory(int one)
+{
+	printf("\n%s\n", WorkingDirectory);
+}
@@ -8,9 +8,11 @@
 #ifndef OPERATING_SYSTEM_SHELL_H_
 #define OPERATING_SYSTEM_SHELL_H_
 
+#include "OS_FileSystemScheme.h"
+
 #define COMMAND_MAX_SIZE 200
 #define PARAMS_MAX_NUM   10
-#define PARAMS_MAX_SIZE  20
+#define PARAMS_MAX_SIZE  256				// Room for a whole path
 
 // Serial Tokens
 #define CR   0x0D
@@ -31,12 +33,15 @@ struct CommandLine
 	char*				Tokens;
 };
 
-void 	Interpreter(void);
+void 	Interpreter(VOLUME* volume);		// Runs commands against the volume until stdin closes
 int 		Shell_CommandNumber(char* commandString);
 void 	Shell_StringRegex(char* src, char* dst); // Null terminated strings
 void 	Shell_FreeTokens(char** tokens);
 void 	Shell_CommandTokenize(char* pCommand);
 void 	Shell_RunCommand(unsigned int Index);
+bool 	Shell_FullPath(char* path, char* fullPath);	// Path taken from the working directory, made absolute (FALSE if it needs more than PARAMS_MAX_SIZE bytes)
+void 	Shell_NormalizePath(char* path);			// Drop the "." and ".." components of an absolute path
+void 	Shell_PrintError(FileError Error);
 
 
 
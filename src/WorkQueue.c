@@ -0,0 +1,206 @@
+/*
+ * WorkQueue.c
+ *
+ *  Created on: Oct 18, 2026
+ */
+#include <stdlib.h>
+#include <stdint.h>
+#include <pthread.h>
+#include "WorkQueue.h"
+#include "venkatlib.h"
+
+// Private helpers
+void* 	_WorkQueue_Worker(void* Argument);
+void* 	_WorkQueue_Take(WorkQueue* queue);											// Unlink the oldest item (0 if none). Needs the lock.
+
+WorkQueue* WorkQueue_Init(uint32_t NumWorkers, WorkHandler Handler, void* Context)
+{
+	if (NumWorkers > 0 && Handler == 0) return 0;
+
+	WorkQueue* NewQueue = (WorkQueue*) calloc(1, sizeof(WorkQueue));
+
+	// if memory allocation failed, return immediately
+	if (NewQueue == 0)
+	{
+		return 0;
+	}
+
+	if (pthread_mutex_init(&NewQueue->Lock, 0) != 0)
+	{
+		free(NewQueue);
+		return 0;
+	}
+
+	if (pthread_cond_init(&NewQueue->NotEmpty, 0) != 0)
+	{
+		pthread_mutex_destroy(&NewQueue->Lock);
+		free(NewQueue);
+		return 0;
+	}
+
+	NewQueue->Handler = Handler;
+	NewQueue->Context = Context;
+
+	if (NumWorkers == 0) return NewQueue;
+
+	NewQueue->Workers = (pthread_t*) calloc(NumWorkers, sizeof(pthread_t));
+
+	if (NewQueue->Workers == 0)
+	{
+		WorkQueue_DeInit(NewQueue);
+		return 0;
+	}
+
+	// Whichever workers did start are stopped again by the DeInit
+	for (NewQueue->NumWorkers = 0; NewQueue->NumWorkers < NumWorkers; NewQueue->NumWorkers++)
+	{
+		if (pthread_create(&NewQueue->Workers[NewQueue->NumWorkers], 0, _WorkQueue_Worker, NewQueue) != 0)
+		{
+			WorkQueue_DeInit(NewQueue);
+			return 0;
+		}
+	}
+
+	return NewQueue;
+}
+
+bool WorkQueue_Push(WorkQueue* queue, void* Item)
+{
+	if (Item == 0) return FALSE;													// 0 is what an empty pop returns
+
+	WorkItem* NewItem = (WorkItem*) malloc(sizeof(WorkItem));
+
+	if (NewItem == 0) return FALSE;
+
+	NewItem->Item = Item;
+	NewItem->Next = 0;
+
+	pthread_mutex_lock(&queue->Lock);
+
+	if (queue->Tail != 0) queue->Tail->Next = NewItem;
+	else queue->Head = NewItem;
+
+	queue->Tail = NewItem;
+	queue->NumQueued++;
+
+	pthread_cond_signal(&queue->NotEmpty);
+	pthread_mutex_unlock(&queue->Lock);
+
+	return TRUE;
+}
+
+// A waiting pop only gives up (returning 0) once the queue is being torn down
+void* WorkQueue_Pop(WorkQueue* queue, bool Wait)
+{
+	pthread_mutex_lock(&queue->Lock);
+
+	while (Wait == TRUE && queue->Head == 0 && queue->Stopping == FALSE)
+	{
+		pthread_cond_wait(&queue->NotEmpty, &queue->Lock);
+	}
+
+	void* Item = _WorkQueue_Take(queue);
+
+	pthread_mutex_unlock(&queue->Lock);
+
+	return Item;
+}
+
+void WorkQueue_Expect(WorkQueue* queue)
+{
+	pthread_mutex_lock(&queue->Lock);
+	queue->NumExpected++;
+	pthread_mutex_unlock(&queue->Lock);
+}
+
+// Whoever is waiting may have been waiting for this very item, so they all look again
+void WorkQueue_GiveUp(WorkQueue* queue)
+{
+	pthread_mutex_lock(&queue->Lock);
+	queue->NumExpected--;
+	pthread_cond_broadcast(&queue->NotEmpty);
+	pthread_mutex_unlock(&queue->Lock);
+}
+
+// Deciding to wait and taking the item happen under the same lock, so two callers can never count on the same item
+void* WorkQueue_PopExpected(WorkQueue* queue)
+{
+	pthread_mutex_lock(&queue->Lock);
+
+	while (queue->Head == 0 && queue->NumExpected > 0 && queue->Stopping == FALSE)
+	{
+		pthread_cond_wait(&queue->NotEmpty, &queue->Lock);
+	}
+
+	void* Item = _WorkQueue_Take(queue);
+
+	pthread_mutex_unlock(&queue->Lock);
+
+	return Item;
+}
+
+void WorkQueue_DeInit(WorkQueue* queue)
+{
+	if (queue == 0) return;
+
+	pthread_mutex_lock(&queue->Lock);
+	queue->Stopping = TRUE;
+	pthread_cond_broadcast(&queue->NotEmpty);
+	pthread_mutex_unlock(&queue->Lock);
+
+	uint32_t WorkerIterator = 0;
+
+	for (WorkerIterator = 0; WorkerIterator < queue->NumWorkers; WorkerIterator++)
+	{
+		pthread_join(queue->Workers[WorkerIterator], 0);
+	}
+
+	// Items nobody popped (only possible without workers) are the owner's to account for
+	while (queue->Head != 0)
+	{
+		WorkItem* Oldest = queue->Head;
+		queue->Head = Oldest->Next;
+		free(Oldest);
+	}
+
+	pthread_cond_destroy(&queue->NotEmpty);
+	pthread_mutex_destroy(&queue->Lock);
+	free(queue->Workers);
+	free(queue);
+}
+
+//***************************************** Private Functions ************************************//
+
+void* _WorkQueue_Worker(void* Argument)
+{
+	WorkQueue* queue = (WorkQueue*) Argument;
+	void* Item = 0;
+
+	// Keep going until the queue is torn down and empty
+	while ((Item = WorkQueue_Pop(queue, TRUE)) != 0)
+	{
+		queue->Handler(queue->Context, Item);
+	}
+
+	return 0;
+}
+
+// Once nothing more is expected, the callers still waiting in WorkQueue_PopExpected are let go
+void* _WorkQueue_Take(WorkQueue* queue)
+{
+	WorkItem* Oldest = queue->Head;
+
+	if (Oldest == 0) return 0;
+
+	void* Item = Oldest->Item;
+
+	queue->Head = Oldest->Next;
+	if (queue->Head == 0) queue->Tail = 0;
+	queue->NumQueued--;
+
+	if (queue->NumExpected > 0 && --queue->NumExpected == 0) pthread_cond_broadcast(&queue->NotEmpty);
+
+	free(Oldest);
+
+	return Item;
+}
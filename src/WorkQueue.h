@@ -0,0 +1,55 @@
+/*
+ * WorkQueue.h
+ *
+ *  Created on: Oct 18, 2026
+ */
+
+#ifndef OS_FILESYS_WORKQUEUE_WORKQUEUE_H_
+#define OS_FILESYS_WORKQUEUE_WORKQUEUE_H_
+#include <pthread.h>
+#ifndef LAB3_VRTOS_EXTERNAL_LIBRARIES_VENKATWARE_VENKATLIB_H_
+#include "venkatlib.h"
+#endif
+
+// First-in first-out queue of items, optionally drained by a pool of worker threads that hand every item to Handler.
+// A queue without workers is just a blocking queue: items come back out through WorkQueue_Pop.
+//
+// Items can be announced before they are pushed (WorkQueue_Expect), so WorkQueue_PopExpected knows whether waiting
+// is worth it. Every item pushed to such a queue has to have been expected, and one that never will be pushed is
+// taken back with WorkQueue_GiveUp.
+
+// Called on a worker thread for every item pushed. Context is handed through as is.
+typedef void (*WorkHandler)(void* Context, void* Item);
+
+typedef struct NNODE_WorkItem
+{
+	void*					Item;
+	struct NNODE_WorkItem*	Next;
+} WorkItem;
+
+typedef struct NNODE_WorkQueue
+{
+	pthread_mutex_t	Lock;
+	pthread_cond_t	NotEmpty;
+
+	WorkItem*		Head;				// Next item out
+	WorkItem*		Tail;
+	uint32_t		NumQueued;
+	uint32_t		NumExpected;		// Expected items not popped or given up on yet (queued ones included)
+	bool			Stopping;			// Set by WorkQueue_DeInit; workers leave once the queue is empty
+
+	uint32_t		NumWorkers;
+	pthread_t*		Workers;
+
+	WorkHandler		Handler;
+	void*			Context;
+} WorkQueue;
+
+WorkQueue*	WorkQueue_Init(uint32_t NumWorkers, WorkHandler Handler, void* Context);
+bool		WorkQueue_Push(WorkQueue* queue, void* Item);	// Item cannot be 0
+void*		WorkQueue_Pop(WorkQueue* queue, bool Wait);		// Oldest item (0 if there is none and Wait is FALSE)
+void		WorkQueue_Expect(WorkQueue* queue);				// One more item is on its way
+void		WorkQueue_GiveUp(WorkQueue* queue);				// An expected item will not be pushed after all
+void*		WorkQueue_PopExpected(WorkQueue* queue);		// Oldest item, waiting for one as long as any is expected (0 once none is)
+void		WorkQueue_DeInit(WorkQueue* queue);				// Lets the workers finish every item still queued, then stops them
+#endif /* OS_FILESYS_WORKQUEUE_WORKQUEUE_H_ */
@@ -0,0 +1,503 @@
+/*
+ * silkbench.c
+ *
+ *  Created on: Oct 18, 2026
+ */
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+#include <pthread.h>
+#include "OS_FileSystemScheme.h"
+#include "Compressor.h"
+#include "Checksum.h"
+
+// Multi-threaded throughput benchmark. Every workload runs the same number of operations per thread at
+// 1, 2, 4, ... threads, so perfect scaling shows up as a speedup equal to the thread count. Before them, the
+// compressor is timed on a corpus of log lines, which is then written to a file to see what it takes on the volume.
+
+#define BENCH_STORE_PATH 		"silkbench.store"
+#define BENCH_SHARED_FILES 		64
+#define BENCH_FILE_SECTORS 		16
+#define BENCH_FILE_BYTES 		(BENCH_FILE_SECTORS * BenchBlockSize)
+#define BENCH_WRITE_BYTES 		(4 * BenchBlockSize)
+#define BENCH_APPEND_BYTES 		(2 * BenchBlockSize)
+#define BENCH_COMMIT_OPS 		16									// Overwrites between commit points
+#define BENCH_DEFAULT_OPS 		20000
+#define BENCH_DEFAULT_THREADS 	8
+#define BENCH_CORPUS_SECTORS 	256
+#define BENCH_CORPUS_BYTES 		(BENCH_CORPUS_SECTORS * BenchBlockSize)
+#define BENCH_CODEC_PASSES 		32
+#define BENCH_CHECKSUM_PASSES 	256
+
+typedef enum Bench_Workloads
+{
+	BENCH_READ = 0,											// Whole shared files, read by every thread
+	BENCH_READ_WRITE,										// The same files, one operation in four a write
+	BENCH_CREATE_APPEND_DELETE,								// Private files, all threads allocating at once
+	BENCH_OVERWRITE,										// Blocks of the shared files rewritten in place, committing every BENCH_COMMIT_OPS
+	BENCH_NUM_WORKLOADS
+} BenchWorkload;
+
+typedef struct Bench_Worker
+{
+	pthread_t		Thread;
+	uint32_t		ThreadNum;
+	BenchWorkload	Workload;
+	uint32_t		NumOps;
+	uint64_t		BytesMoved;
+	bool			Failed;
+} BenchWorker;
+
+const char* WorkloadNames[BENCH_NUM_WORKLOADS] = {"read", "read/write", "create/append/delete", "overwrite/commit"};
+
+VOLUME* BenchVolume = 0;
+MYFILE* SharedFiles[BENCH_SHARED_FILES];
+uint32_t BenchBlockSize = DEFAULT_BLOCK_SIZE;				// Block size of the mounted volume
+
+double 	_Bench_Now(void);
+void* 	_Bench_Worker(void* Argument);
+bool 	_Bench_SetUp(VOLUME* volume);
+double 	_Bench_Run(BenchWorkload Workload, uint32_t NumThreads, uint32_t NumOps, uint64_t* BytesMoved);
+void 	_Bench_FillCorpus(BYTE* Corpus, uint32_t NumBytes);
+bool 	_Bench_Compression(VOLUME* volume);
+bool 	_Bench_Checksums(void);
+
+int main(int argc, char* argv[])
+{
+	MOUNT_OPTIONS Options 		= {MOUNT_POSITIONAL_IO, DEFAULT_CACHE_SECTORS, FALSE, FALSE};
+	const char* StorePath 		= BENCH_STORE_PATH;
+	uint32_t 	MaxThreads 		= BENCH_DEFAULT_THREADS;
+	uint32_t 	NumOps 			= BENCH_DEFAULT_OPS;
+	GEOMETRY 	Geometry 		= {0, DEFAULT_BLOCK_COUNT, DEFAULT_INODE_COUNT};
+	int 		ArgIterator 	= 0;
+
+	for (ArgIterator = 1; ArgIterator < argc; ArgIterator++)
+	{
+		if (strcmp(argv[ArgIterator], "-m") == 0)
+		{
+			Options.Mode = MOUNT_MAPPED;
+		}
+		else if (strcmp(argv[ArgIterator], "-c") == 0 && ArgIterator + 1 < argc)
+		{
+			Options.CacheSectors = (uint32_t) atoi(argv[++ArgIterator]);
+		}
+		else if (strcmp(argv[ArgIterator], "-z") == 0)
+		{
+			Options.Compress = TRUE;
+		}
+		else if (strcmp(argv[ArgIterator], "-f") == 0 && ArgIterator + 1 < argc)
+		{
+			StorePath = argv[++ArgIterator];
+		}
+		// -t <threads> is the most threads to run with
+		else if (strcmp(argv[ArgIterator], "-t") == 0 && ArgIterator + 1 < argc)
+		{
+			MaxThreads = (uint32_t) atoi(argv[++ArgIterator]);
+		}
+		// -n <ops> is how many operations each thread does per workload
+		else if (strcmp(argv[ArgIterator], "-n") == 0 && ArgIterator + 1 < argc)
+		{
+			NumOps = (uint32_t) atoi(argv[++ArgIterator]);
+		}
+		// -b <bytes> formats the store with that block size before the run
+		else if (strcmp(argv[ArgIterator], "-b") == 0 && ArgIterator + 1 < argc)
+		{
+			Geometry.BlockSize = (uint32_t) atoi(argv[++ArgIterator]);
+		}
+		else
+		{
+			printf("usage: %s [-m] [-c <sectors>] [-z] [-f <store>] [-t <threads>] [-n <ops per thread>] [-b <block size>]\n", argv[0]);
+			return -1;
+		}
+	}
+
+	if (MaxThreads == 0 || NumOps == 0) return -1;
+
+	// Always start from an empty store
+	remove(StorePath);
+
+	BenchVolume = OSFS_Mount(StorePath, &Options);
+
+	if (BenchVolume == 0) return -1;
+
+	if (Geometry.BlockSize != 0 && OSFS_Format(BenchVolume, &Geometry) == FALSE)
+	{
+		printf("Could not format the store with %u byte blocks\n", Geometry.BlockSize);
+		return -1;
+	}
+
+	OSFS_GetGeometry(BenchVolume, &Geometry);
+	BenchBlockSize = Geometry.BlockSize;
+
+	if (_Bench_SetUp(BenchVolume) == FALSE)
+	{
+		printf("Could not set up the benchmark files\n");
+		return -1;
+	}
+
+	printf("%u files of %u bytes in %u byte blocks, %u operations per thread, ", BENCH_SHARED_FILES, BENCH_FILE_BYTES, BenchBlockSize, NumOps);
+	if (Options.Mode == MOUNT_MAPPED) printf("mapped store");
+	else printf("positional I/O, %u cache sectors", Options.CacheSectors);
+	printf((Options.Compress) ? ", compressed files\n" : "\n");
+
+	if (_Bench_Compression(BenchVolume) == FALSE)
+	{
+		printf("Could not measure compression\n");
+		return -1;
+	}
+
+	if (_Bench_Checksums() == FALSE)
+	{
+		printf("Could not measure checksums\n");
+		return -1;
+	}
+
+	printf("\n%-22s %8s %12s %10s %8s\n", "workload", "threads", "ops/s", "MB/s", "speedup");
+
+	BenchWorkload Workload = BENCH_READ;
+
+	for (Workload = BENCH_READ; Workload < BENCH_NUM_WORKLOADS; Workload++)
+	{
+		double 	 BaseRate 	= 0;
+		uint32_t NumThreads = 1;
+
+		while (NumThreads <= MaxThreads)
+		{
+			uint64_t BytesMoved = 0;
+			double 	 Seconds 	= _Bench_Run(Workload, NumThreads, NumOps, &BytesMoved);
+
+			if (Seconds < 0)
+			{
+				printf("%s failed with %u threads\n", WorkloadNames[Workload], NumThreads);
+				return -1;
+			}
+
+			double Rate = ((double) NumThreads * NumOps) / Seconds;
+			if (NumThreads == 1) BaseRate = Rate;
+
+			printf("%-22s %8u %12.0f %10.1f %8.2f\n", WorkloadNames[Workload], NumThreads, Rate, ((double) BytesMoved / (1024 * 1024)) / Seconds, Rate / BaseRate);
+
+			// Powers of two, and always the maximum asked for
+			NumThreads = (NumThreads < MaxThreads && NumThreads * 2 > MaxThreads) ? MaxThreads : NumThreads * 2;
+		}
+	}
+
+	uint32_t FileIterator = 0;
+
+	for (FileIterator = 0; FileIterator < BENCH_SHARED_FILES; FileIterator++)
+	{
+		OSFS_Close(SharedFiles[FileIterator]);
+	}
+
+	OSFS_Unmount(BenchVolume);
+	remove(StorePath);
+
+	return 0;
+}
+
+//***************************************** Private Functions ************************************//
+
+double _Bench_Now(void)
+{
+	struct timespec Now;
+
+	clock_gettime(CLOCK_MONOTONIC, &Now);
+
+	return (double) Now.tv_sec + ((double) Now.tv_nsec / 1e9);
+}
+
+// Lines of a made up server log: the same few shapes over and over, with the numbers in them changing
+void _Bench_FillCorpus(BYTE* Corpus, uint32_t NumBytes)
+{
+	const char*  Levels[4] 	= {"INFO ", "INFO ", "DEBUG", "WARN "};
+	const char*  Paths[4] 	= {"/api/files", "/api/files/upload", "/api/dirs", "/health"};
+	unsigned int Seed 		= 1;
+	uint32_t 	 Filled 	= 0;
+	char 		 Line[160];
+
+	while (Filled < NumBytes)
+	{
+		int Length = snprintf(Line, sizeof(Line), "2026-10-18 %02d:%02d:%02d.%03d %s [worker-%d] GET %s served in %d us (status %d)\n",
+								rand_r(&Seed) % 24, rand_r(&Seed) % 60, rand_r(&Seed) % 60, rand_r(&Seed) % 1000, Levels[rand_r(&Seed) % 4],
+								rand_r(&Seed) % 8, Paths[rand_r(&Seed) % 4], rand_r(&Seed) % 5000, (rand_r(&Seed) % 16 == 0) ? 404 : 200);
+		uint32_t Copied = ((uint32_t) Length < NumBytes - Filled) ? (uint32_t) Length : NumBytes - Filled;
+
+		memcpy(&Corpus[Filled], Line, Copied);
+		Filled += Copied;
+	}
+}
+
+// The codec's throughput and ratio, a cluster at a time as the filesystem uses it, then the corpus written to a file:
+// its size against the blocks the volume had to give up for it
+bool _Bench_Compression(VOLUME* volume)
+{
+	uint32_t ClusterBytes 	 = COMPRESSION_CLUSTER_BLOCKS * BenchBlockSize;
+	uint32_t NumClusters 	 = BENCH_CORPUS_BYTES / ClusterBytes;
+	BYTE* 	 Corpus 		 = (BYTE*) malloc(BENCH_CORPUS_BYTES);
+	BYTE* 	 Packed 		 = (BYTE*) malloc(BENCH_CORPUS_BYTES + ClusterBytes);	// Every cluster compressed, back to back
+	BYTE* 	 Unpacked 		 = (BYTE*) malloc(BENCH_CORPUS_BYTES);
+	uint32_t PackedLengths[BENCH_CORPUS_SECTORS / COMPRESSION_CLUSTER_BLOCKS];
+	uint64_t PackedBytes 	 = 0;
+	uint32_t PassIterator 	 = 0;
+	uint32_t ClusterIterator = 0;
+	bool 	 Measured 		 = (bool) (Corpus != 0 && Packed != 0 && Unpacked != 0);
+
+	if (Measured) _Bench_FillCorpus(Corpus, BENCH_CORPUS_BYTES);
+
+	double Start = _Bench_Now();
+
+	for (PassIterator = 0; Measured && PassIterator < BENCH_CODEC_PASSES; PassIterator++)
+	{
+		PackedBytes = 0;
+
+		for (ClusterIterator = 0; Measured && ClusterIterator < NumClusters; ClusterIterator++)
+		{
+			PackedLengths[ClusterIterator] = Compressor_Compress(&Corpus[ClusterIterator * ClusterBytes], ClusterBytes, &Packed[PackedBytes], ClusterBytes);
+			PackedBytes += PackedLengths[ClusterIterator];
+			Measured = (bool) (PackedLengths[ClusterIterator] > 0);
+		}
+	}
+
+	double CompressSeconds = _Bench_Now() - Start;
+
+	Start = _Bench_Now();
+
+	for (PassIterator = 0; Measured && PassIterator < BENCH_CODEC_PASSES; PassIterator++)
+	{
+		uint64_t PackedAt = 0;
+
+		for (ClusterIterator = 0; Measured && ClusterIterator < NumClusters; ClusterIterator++)
+		{
+			Measured = Compressor_Decompress(&Packed[PackedAt], PackedLengths[ClusterIterator], &Unpacked[ClusterIterator * ClusterBytes], ClusterBytes);
+			PackedAt += PackedLengths[ClusterIterator];
+		}
+	}
+
+	double DecompressSeconds = _Bench_Now() - Start;
+	double CodecMegabytes 	 = ((double) BENCH_CORPUS_BYTES * BENCH_CODEC_PASSES) / (1024 * 1024);
+
+	Measured = (bool) (Measured && memcmp(Corpus, Unpacked, BENCH_CORPUS_BYTES) == 0);
+
+	if (Measured)
+	{
+		printf("\n%u byte corpus of log lines in %u byte clusters\n", BENCH_CORPUS_BYTES, ClusterBytes);
+		printf("%-22s %10.1f MB/s compress %10.1f MB/s decompress   ratio %.2f\n", "codec", CodecMegabytes / CompressSeconds,
+				CodecMegabytes / DecompressSeconds, (double) BENCH_CORPUS_BYTES / PackedBytes);
+	}
+
+	// The same corpus as a file on the volume, read back to make sure it survived
+	STATFS 	Before;
+	STATFS 	After;
+	MYFILE* CorpusFile = 0;
+
+	OSFS_StatFS(volume, &Before);
+
+	if (Measured) CorpusFile = OSFS_Create(volume, "corpus");
+
+	Measured = (bool) (CorpusFile != 0 && OSFS_Write(CorpusFile, Corpus, BENCH_CORPUS_BYTES, 0) == TRUE);
+
+	OSFS_StatFS(volume, &After);
+
+	Measured = (bool) (Measured && OSFS_Read(CorpusFile, Unpacked, BENCH_CORPUS_BYTES, 0) == TRUE && memcmp(Corpus, Unpacked, BENCH_CORPUS_BYTES) == 0);
+
+	if (Measured)
+	{
+		uint32_t BlocksTaken = Before.FreeBlocks - After.FreeBlocks;
+
+		printf("%-22s %10u blocks for %u bytes           ratio %.2f\n", "on volume", BlocksTaken, BENCH_CORPUS_BYTES,
+				(double) BENCH_CORPUS_BYTES / ((double) BlocksTaken * BenchBlockSize));
+	}
+
+	if (CorpusFile != 0)
+	{
+		OSFS_Close(CorpusFile);
+		Measured = (bool) (OSFS_Delete(volume, "corpus") == TRUE && Measured);
+	}
+
+	free(Corpus);
+	free(Packed);
+	free(Unpacked);
+
+	return Measured;
+}
+
+// CRC32C a block at a time, the way every read and write of the volume checks its blocks
+bool _Bench_Checksums(void)
+{
+	BYTE* 	 Corpus 		= (BYTE*) malloc(BENCH_CORPUS_BYTES);
+	uint32_t PassIterator 	= 0;
+	uint32_t BlockIterator 	= 0;
+	volatile uint32_t Folded = 0;												// Keeps the checksums from being optimized away
+
+	if (Corpus == 0) return FALSE;
+
+	_Bench_FillCorpus(Corpus, BENCH_CORPUS_BYTES);
+
+	double Start = _Bench_Now();
+
+	for (PassIterator = 0; PassIterator < BENCH_CHECKSUM_PASSES; PassIterator++)
+	{
+		for (BlockIterator = 0; BlockIterator < BENCH_CORPUS_SECTORS; BlockIterator++)
+		{
+			Folded ^= Checksum_CRC32C(&Corpus[BlockIterator * BenchBlockSize], BenchBlockSize);
+		}
+	}
+
+	double Seconds 	 = _Bench_Now() - Start;
+	double Megabytes = ((double) BENCH_CORPUS_BYTES * BENCH_CHECKSUM_PASSES) / (1024 * 1024);
+
+	printf("%-22s %10.1f MB/s in %u byte blocks (%s)\n", "crc32c", Megabytes / Seconds, BenchBlockSize, (Checksum_IsAccelerated()) ? "sse4.2" : "table");
+
+	free(Corpus);
+
+	return TRUE;
+}
+
+// Creates the shared files, full to BENCH_FILE_BYTES, and leaves them open
+bool _Bench_SetUp(VOLUME* volume)
+{
+	BYTE* 	 Contents 		= (BYTE*) malloc(BENCH_FILE_BYTES);
+	uint32_t FileIterator 	= 0;
+	char 	 FileName[MAX_FILE_NAME_CHARS + 1];
+
+	if (Contents == 0) return FALSE;
+
+	OSFS_BeginBatch(volume);
+
+	for (FileIterator = 0; FileIterator < BENCH_SHARED_FILES; FileIterator++)
+	{
+		snprintf(FileName, sizeof(FileName), "shared%u", FileIterator);
+		memset(Contents, (int) FileIterator, BENCH_FILE_BYTES);
+
+		SharedFiles[FileIterator] = OSFS_Create(volume, FileName);
+
+		if (SharedFiles[FileIterator] == 0 || OSFS_Write(SharedFiles[FileIterator], Contents, BENCH_FILE_BYTES, 0) == FALSE)
+		{
+			free(Contents);
+			return FALSE;
+		}
+	}
+
+	free(Contents);
+
+	return OSFS_CommitBatch(volume);
+}
+
+// Runs the workload on NumThreads threads at once. Returns the seconds it took, or -1 if any operation failed.
+double _Bench_Run(BenchWorkload Workload, uint32_t NumThreads, uint32_t NumOps, uint64_t* BytesMoved)
+{
+	BenchWorker* Workers 		= (BenchWorker*) calloc(NumThreads, sizeof(BenchWorker));
+	uint32_t 	 WorkerIterator = 0;
+	bool 		 Failed 		= FALSE;
+
+	if (Workers == 0) return -1;
+
+	// Allocations only get committed once all of them are done, so the commits do not swamp what is being measured
+	if (Workload == BENCH_CREATE_APPEND_DELETE) OSFS_BeginBatch(BenchVolume);
+
+	double Start = _Bench_Now();
+
+	for (WorkerIterator = 0; WorkerIterator < NumThreads; WorkerIterator++)
+	{
+		Workers[WorkerIterator].ThreadNum 	= WorkerIterator;
+		Workers[WorkerIterator].Workload 	= Workload;
+		Workers[WorkerIterator].NumOps 		= NumOps;
+
+		if (pthread_create(&Workers[WorkerIterator].Thread, 0, _Bench_Worker, &Workers[WorkerIterator]) != 0) exit(-1);
+	}
+
+	for (WorkerIterator = 0; WorkerIterator < NumThreads; WorkerIterator++)
+	{
+		pthread_join(Workers[WorkerIterator].Thread, 0);
+
+		*BytesMoved += Workers[WorkerIterator].BytesMoved;
+		Failed = Failed || Workers[WorkerIterator].Failed;
+	}
+
+	double Elapsed = _Bench_Now() - Start;
+
+	if (Workload == BENCH_CREATE_APPEND_DELETE) OSFS_CommitBatch(BenchVolume);
+
+	free(Workers);
+
+	return (Failed) ? -1 : Elapsed;
+}
+
+void* _Bench_Worker(void* Argument)
+{
+	BenchWorker* Worker 	= (BenchWorker*) Argument;
+	BYTE* 		 Buffer 	= (BYTE*) malloc(BENCH_FILE_BYTES);
+	unsigned int Seed 		= Worker->ThreadNum + 1;
+	uint32_t 	 OpIterator = 0;
+	char 		 FileName[MAX_FILE_NAME_CHARS + 1];
+
+	if (Buffer == 0)
+	{
+		Worker->Failed = TRUE;
+		return 0;
+	}
+
+	memset(Buffer, (int) Worker->ThreadNum, BENCH_FILE_BYTES);
+
+	for (OpIterator = 0; OpIterator < Worker->NumOps && Worker->Failed == FALSE; OpIterator++)
+	{
+		MYFILE* File = SharedFiles[rand_r(&Seed) % BENCH_SHARED_FILES];
+
+		switch (Worker->Workload)
+		{
+			case BENCH_READ_WRITE:
+				if ((rand_r(&Seed) % 4) == 0)
+				{
+					uint32_t Offset = (rand_r(&Seed) % (BENCH_FILE_SECTORS - (BENCH_WRITE_BYTES / BenchBlockSize) + 1)) * BenchBlockSize;
+
+					Worker->Failed = (bool) (OSFS_Write(File, Buffer, BENCH_WRITE_BYTES, Offset) == FALSE);
+					Worker->BytesMoved += BENCH_WRITE_BYTES;
+				}
+				else
+				{
+					// A read, same as BENCH_READ
+					Worker->Failed = (bool) (OSFS_Read(File, Buffer, BENCH_FILE_BYTES, 0) == FALSE);
+					Worker->BytesMoved += BENCH_FILE_BYTES;
+				}
+				break;
+
+			case BENCH_READ:
+				Worker->Failed = (bool) (OSFS_Read(File, Buffer, BENCH_FILE_BYTES, 0) == FALSE);
+				Worker->BytesMoved += BENCH_FILE_BYTES;
+				break;
+
+			case BENCH_CREATE_APPEND_DELETE:
+				snprintf(FileName, sizeof(FileName), "t%u_%u", Worker->ThreadNum, OpIterator % 1000);
+
+				File = OSFS_Create(BenchVolume, FileName);
+
+				if (File == 0 || OSFS_Append(File, Buffer, BENCH_APPEND_BYTES) == FALSE)
+				{
+					Worker->Failed = TRUE;
+					break;
+				}
+
+				OSFS_Close(File);
+				Worker->Failed = (bool) (OSFS_Delete(BenchVolume, FileName) == FALSE);
+				Worker->BytesMoved += BENCH_APPEND_BYTES;
+				break;
+
+			// Every commit point logs the checksums of the blocks written since the last one
+			case BENCH_OVERWRITE:
+				Worker->Failed = (bool) (OSFS_Write(File, Buffer, BenchBlockSize, (rand_r(&Seed) % BENCH_FILE_SECTORS) * BenchBlockSize) == FALSE);
+				Worker->BytesMoved += BenchBlockSize;
+
+				if ((OpIterator + 1) % BENCH_COMMIT_OPS == 0) Worker->Failed = (bool) (Worker->Failed || OSFS_Flush(BenchVolume) == FALSE);
+				break;
+
+			default:
+				break;
+		}
+	}
+
+	free(Buffer);
+
+	return 0;
+}
@@ -7,12 +7,50 @@
 //
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
 #include "OS_FileSystemScheme.h"
 #include "Shell.h"
 
-int main()
+int main(int argc, char* argv[])
 {
-    OSFS_Init();
-    Interpreter();
+    MOUNT_OPTIONS Options = {MOUNT_POSITIONAL_IO, DEFAULT_CACHE_SECTORS, FALSE, FALSE};
+    const char* StorePath = DEFAULT_STORE_PATH;
+    int ArgIterator = 0;
+
+    for (ArgIterator = 1; ArgIterator < argc; ArgIterator++)
+    {
+        // -m maps the store into memory instead of using positional reads/writes
+        if (strcmp(argv[ArgIterator], "-m") == 0)
+        {
+            Options.Mode = MOUNT_MAPPED;
+        }
+        // -c <sectors> sizes the sector cache (0 turns it off)
+        else if (strcmp(argv[ArgIterator], "-c") == 0 && ArgIterator + 1 < argc)
+        {
+            Options.CacheSectors = (uint32_t) atoi(argv[++ArgIterator]);
+        }
+        // -z keeps the data of files created from now on compressed
+        else if (strcmp(argv[ArgIterator], "-z") == 0)
+        {
+            Options.Compress = TRUE;
+        }
+        // -F formats the store before mounting it, whatever it holds
+        else if (strcmp(argv[ArgIterator], "-F") == 0)
+        {
+            Options.Format = TRUE;
+        }
+        // -f <path> uses another store than myfilesystem.store
+        else if (strcmp(argv[ArgIterator], "-f") == 0 && ArgIterator + 1 < argc)
+        {
+            StorePath = argv[++ArgIterator];
+        }
+    }
+
+    VOLUME* Volume = OSFS_Mount(StorePath, &Options);
+
+    if (Volume == 0) return -1;
+
+    Interpreter(Volume);
+    OSFS_Unmount(Volume);
     return 0;
 }
@@ -0,0 +1,405 @@
+/*
+ * silktest.c
+ *
+ *  Created on: Oct 18, 2026
+ */
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/wait.h>
+#include "OS_FileSystemScheme.h"
+
+// Regression tests. Every test starts from an empty store of its own and says whether the volume behaved. Crashes
+// are a child process leaving without unmounting, after which the parent mounts the store again.
+
+#define TEST_STORE_PATH 		"silktest.store"
+#define TEST_FILL_FILES 		4
+#define TEST_FILL_BYTES 		(100 * 1024)
+#define TEST_HOLE_BYTES 		2000
+#define TEST_OVERWRITE_BLOCKS 	8
+#define TEST_FRAGMENTS 			(EXTENT_ROOT_ENTRIES * 2)	// Extents given to a file, so its tree needs a node
+
+typedef struct Test_Case TestCase;
+typedef bool (*TestFunction)(const TestCase* Test);
+
+struct Test_Case
+{
+	const char* 	Name;
+	TestFunction	Run;
+	GEOMETRY		Geometry;								// Formatted with before the test (a block size of 0 keeps the default)
+	MOUNT_OPTIONS	Options;
+};
+
+VOLUME* _Test_Mount(const TestCase* Test, bool Fresh);
+bool 	_Test_FormatDirtyStore(const TestCase* Test);
+bool 	_Test_CrashAfterOverwrite(const TestCase* Test);
+bool 	_Test_CorruptTreeNode(const TestCase* Test);
+bool 	_Test_CorruptBitMaps(const TestCase* Test);
+bool 	_Test_ForeignStore(const TestCase* Test);
+bool 	_Test_CorruptGroupTable(const TestCase* Test);
+bool 	_Test_CorruptBlock(uint32_t BlockNum, uint32_t BlockSize);			// Flip a byte of the block on the unmounted store
+bool 	_Test_ReadStore(void* Buffer, size_t NumBytes, off_t Offset);		// Read straight from the unmounted store
+
+const TestCase Tests[] =
+{
+	{"format a used store", 					_Test_FormatDirtyStore, 	{0, 0, 0}, 											{MOUNT_POSITIONAL_IO, DEFAULT_CACHE_SECTORS, FALSE, FALSE}},
+	{"format a used store, fewer inodes", 		_Test_FormatDirtyStore, 	{DEFAULT_BLOCK_SIZE, DEFAULT_BLOCK_COUNT, 2000}, 	{MOUNT_POSITIONAL_IO, DEFAULT_CACHE_SECTORS, FALSE, FALSE}},
+	{"crash after an overwrite", 				_Test_CrashAfterOverwrite, 	{0, 0, 0}, 											{MOUNT_POSITIONAL_IO, DEFAULT_CACHE_SECTORS, FALSE, FALSE}},
+	{"crash after an overwrite, mapped", 		_Test_CrashAfterOverwrite, 	{0, 0, 0}, 											{MOUNT_MAPPED, 0, FALSE, FALSE}},
+	{"corrupted extent tree node", 				_Test_CorruptTreeNode, 		{0, 0, 0}, 											{MOUNT_POSITIONAL_IO, DEFAULT_CACHE_SECTORS, FALSE, FALSE}},
+	{"corrupted extent tree node, compressed", 	_Test_CorruptTreeNode, 		{0, 0, 0}, 											{MOUNT_POSITIONAL_IO, DEFAULT_CACHE_SECTORS, TRUE, FALSE}},
+	{"corrupted block bitmaps", 				_Test_CorruptBitMaps, 		{0, 0, 0}, 											{MOUNT_POSITIONAL_IO, DEFAULT_CACHE_SECTORS, FALSE, FALSE}},
+	{"corrupted group table", 					_Test_CorruptGroupTable, 	{0, 0, 0}, 											{MOUNT_POSITIONAL_IO, DEFAULT_CACHE_SECTORS, FALSE, FALSE}},
+	{"store of another layout", 				_Test_ForeignStore, 		{0, 0, 0}, 											{MOUNT_POSITIONAL_IO, DEFAULT_CACHE_SECTORS, FALSE, FALSE}},
+};
+
+int main(void)
+{
+	uint32_t NumTests 		= sizeof(Tests) / sizeof(Tests[0]);
+	uint32_t Failures 		= 0;
+	uint32_t TestIterator 	= 0;
+
+	for (TestIterator = 0; TestIterator < NumTests; TestIterator++)
+	{
+		bool Passed = Tests[TestIterator].Run(&Tests[TestIterator]);
+
+		printf("%-40s %s\n", Tests[TestIterator].Name, (Passed) ? "ok" : "FAILED");
+
+		if (Passed == FALSE) Failures++;
+	}
+
+	remove(TEST_STORE_PATH);
+
+	return (Failures == 0) ? 0 : -1;
+}
+
+//***************************************** Private Functions ************************************//
+
+// A fresh mount starts from an empty store, formatted with the test's geometry
+VOLUME* _Test_Mount(const TestCase* Test, bool Fresh)
+{
+	MOUNT_OPTIONS Options 	= Test->Options;
+	GEOMETRY 	  Geometry 	= Test->Geometry;
+
+	if (Fresh) remove(TEST_STORE_PATH);
+
+	VOLUME* volume = OSFS_Mount(TEST_STORE_PATH, &Options);
+
+	if (volume != 0 && Fresh && Geometry.BlockSize != 0 && OSFS_Format(volume, &Geometry) == FALSE)
+	{
+		OSFS_Unmount(volume);
+		return 0;
+	}
+
+	return volume;
+}
+
+// The format leaves the old file data where it was. A file written after it has a hole and a partial block over that
+// data, none of which the format checksummed, and all of it has to be readable.
+bool _Test_FormatDirtyStore(const TestCase* Test)
+{
+	VOLUME*  volume 		= _Test_Mount(Test, TRUE);
+	BYTE* 	 Contents 		= (BYTE*) malloc(TEST_FILL_BYTES);
+	uint32_t FileIterator 	= 0;
+	bool 	 Passed 		= (bool) (volume != 0 && Contents != 0);
+	char 	 FileName[MAX_FILE_NAME_CHARS + 1];
+
+	for (FileIterator = 0; FileIterator < TEST_FILL_FILES && Passed; FileIterator++)
+	{
+		snprintf(FileName, sizeof(FileName), "fill%u", FileIterator);
+		memset(Contents, 0xA5 + FileIterator, TEST_FILL_BYTES);
+
+		MYFILE* File = OSFS_Create(volume, FileName);
+
+		Passed = (bool) (File != 0 && OSFS_Write(File, Contents, TEST_FILL_BYTES, 0) == TRUE);
+
+		if (File != 0) Passed = OSFS_Close(File) && Passed;
+	}
+
+	if (Passed) Passed = OSFS_Format(volume, 0);
+
+	MYFILE* File = (Passed) ? OSFS_Create(volume, "after") : 0;
+
+	Passed = (bool) (File != 0 && OSFS_Write(File, (BYTE*) "hi", 2, TEST_HOLE_BYTES) == TRUE);
+	Passed = (bool) (Passed && OSFS_Read(File, Contents, TEST_HOLE_BYTES + 2, 0) == TRUE);
+	Passed = (bool) (Passed && memcmp(&Contents[TEST_HOLE_BYTES], "hi", 2) == 0);
+
+	if (File != 0) Passed = OSFS_Close(File) && Passed;
+	if (volume != 0) OSFS_Unmount(volume);
+
+	free(Contents);
+
+	return Passed;
+}
+
+// The child commits a file, overwrites it in place and crashes before the overwrite is committed. Every block has to
+// read back afterwards, each one holding either its old or its new contents.
+bool _Test_CrashAfterOverwrite(const TestCase* Test)
+{
+	uint32_t BlockSize 		= (Test->Geometry.BlockSize != 0) ? Test->Geometry.BlockSize : DEFAULT_BLOCK_SIZE;
+	uint32_t NumBytes 		= TEST_OVERWRITE_BLOCKS * BlockSize;
+	BYTE* 	 Old 			= (BYTE*) malloc(NumBytes);
+	BYTE* 	 New 			= (BYTE*) malloc(NumBytes);
+	BYTE* 	 Contents 		= (BYTE*) malloc(NumBytes);
+	int 	 ChildStatus 	= -1;
+
+	if (Old == 0 || New == 0 || Contents == 0) return FALSE;
+
+	memset(Old, 'o', NumBytes);
+	memset(New, 'n', NumBytes);
+
+	pid_t Child = fork();
+
+	if (Child == 0)
+	{
+		VOLUME* volume 	= _Test_Mount(Test, TRUE);
+		MYFILE* File 	= (volume != 0) ? OSFS_Create(volume, "overwritten") : 0;
+
+		if (File == 0 || OSFS_Write(File, Old, NumBytes, 0) == FALSE || OSFS_Close(File) == FALSE) _exit(-1);
+
+		File = OSFS_Open(volume, "overwritten");
+
+		if (File == 0 || OSFS_Write(File, New, NumBytes, 0) == FALSE) _exit(-1);
+
+		_exit(0);
+	}
+
+	if (Child < 0 || waitpid(Child, &ChildStatus, 0) != Child || WIFEXITED(ChildStatus) == 0 || WEXITSTATUS(ChildStatus) != 0)
+	{
+		free(Old);
+		free(New);
+		free(Contents);
+		return FALSE;
+	}
+
+	VOLUME* volume 	= _Test_Mount(Test, FALSE);
+	MYFILE* File 	= (volume != 0) ? OSFS_Open(volume, "overwritten") : 0;
+	bool 	Passed 	= (bool) (File != 0 && OSFS_Read(File, Contents, NumBytes, 0) == TRUE);
+
+	uint32_t BlockIterator = 0;
+	for (BlockIterator = 0; BlockIterator < TEST_OVERWRITE_BLOCKS && Passed; BlockIterator++)
+	{
+		size_t At = (size_t) BlockIterator * BlockSize;
+
+		Passed = (bool) (memcmp(&Contents[At], &Old[At], BlockSize) == 0 || memcmp(&Contents[At], &New[At], BlockSize) == 0);
+	}
+
+	if (File != 0) Passed = OSFS_Close(File) && Passed;
+	if (volume != 0) OSFS_Unmount(volume);
+
+	free(Old);
+	free(New);
+	free(Contents);
+
+	return Passed;
+}
+
+// A file mapped by more extents than its inode holds has its tree node damaged while the store is unmounted. Reads,
+// writes and the cursor then have to fail with FILE_CORRUPTED, and the volume carry on.
+bool _Test_CorruptTreeNode(const TestCase* Test)
+{
+	uint32_t BlockSize 	= DEFAULT_BLOCK_SIZE;
+	uint32_t PieceBytes = (Test->Options.Compress) ? COMPRESSION_CLUSTER_BLOCKS * BlockSize : BlockSize;
+	BYTE* 	 Piece 		= (BYTE*) malloc(PieceBytes);
+	VOLUME*  volume 	= _Test_Mount(Test, TRUE);
+	MYFILE*  File 		= (volume != 0) ? OSFS_Create(volume, "fragmented") : 0;
+	MYFILE*  Other 		= 0;
+	bool 	 Passed 	= (bool) (Piece != 0 && File != 0);
+	uint32_t PieceIterator = 0;
+	char 	 FileName[MAX_FILE_NAME_CHARS + 1];
+
+	// Creates take the groups in turn, so the file created MIN_BLOCK_GROUPS after it shares its group
+	for (PieceIterator = 1; PieceIterator < MIN_BLOCK_GROUPS && Passed; PieceIterator++)
+	{
+		snprintf(FileName, sizeof(FileName), "spacer%u", PieceIterator);
+
+		MYFILE* Spacer = OSFS_Create(volume, FileName);
+
+		Passed = (bool) (Spacer != 0 && OSFS_Close(Spacer) == TRUE);
+	}
+
+	Other 	= (Passed) ? OSFS_Create(volume, "between") : 0;
+	Passed 	= (bool) (Other != 0);
+
+	// Every piece of the file is kept apart from the next by a block of the other one
+	for (PieceIterator = 0; PieceIterator < TEST_FRAGMENTS && Passed; PieceIterator++)
+	{
+		memset(Piece, 'a' + PieceIterator, PieceBytes);
+
+		Passed = (bool) (OSFS_Append(File, Piece, PieceBytes) == TRUE && OSFS_Append(Other, Piece, BlockSize) == TRUE);
+	}
+
+	Passed = (bool) (Passed && File->FileInode->EXTENTS.Depth > 0);
+
+	uint32_t NodeBlock = (Passed) ? File->FileInode->EXTENTS.Entries[0].StartBlock : 0;
+
+	if (File != 0) Passed = OSFS_Close(File) && Passed;
+	if (Other != 0) Passed = OSFS_Close(Other) && Passed;
+	if (volume != 0) OSFS_Unmount(volume);
+
+	Passed = (bool) (Passed && _Test_CorruptBlock(NodeBlock, BlockSize));
+
+	volume 	= (Passed) ? _Test_Mount(Test, FALSE) : 0;
+	File 	= (volume != 0) ? OSFS_Open(volume, "fragmented") : 0;
+	Passed 	= (bool) (File != 0);
+
+	if (Passed)
+	{
+		FILE_CURSOR* Cursor = OSFS_OpenCursor(File);
+		BYTE* 		 Chunk 	= 0;
+
+		Passed = (bool) (OSFS_Read(File, Piece, PieceBytes, 0) == FALSE && OSFS_GetError(volume) == FILE_CORRUPTED);
+		Passed = (bool) (Passed && OSFS_Write(File, Piece, PieceBytes, 0) == FALSE && OSFS_GetError(volume) == FILE_CORRUPTED);
+		Passed = (bool) (Passed && Cursor != 0 && OSFS_CursorNext(Cursor, &Chunk) == -1 && OSFS_GetError(volume) == FILE_CORRUPTED);
+
+		if (Cursor != 0) OSFS_CloseCursor(Cursor);
+	}
+
+	// The rest of the volume is still there
+	Other 	= (volume != 0) ? OSFS_Open(volume, "between") : 0;
+	Passed 	= (bool) (Passed && Other != 0 && OSFS_Read(Other, Piece, BlockSize, 0) == TRUE && Piece[0] == 'a');
+
+	if (File != 0) Passed = OSFS_Close(File) && Passed;
+	if (Other != 0) Passed = OSFS_Close(Other) && Passed;
+	if (volume != 0) OSFS_Unmount(volume);
+
+	free(Piece);
+
+	return Passed;
+}
+
+// Block bitmaps are read in the first time a group hands out blocks. With every one of them damaged the volume still
+// mounts and reads, but nothing can be allocated.
+bool _Test_CorruptBitMaps(const TestCase* Test)
+{
+	uint32_t BlockSize 		= DEFAULT_BLOCK_SIZE;
+	BYTE* 	 Contents 		= (BYTE*) malloc(BlockSize);
+	VOLUME*  volume 		= _Test_Mount(Test, TRUE);
+	MYFILE*  File 			= (volume != 0) ? OSFS_Create(volume, "kept") : 0;
+	bool 	 Passed 		= (bool) (Contents != 0 && File != 0);
+	uint32_t GroupIterator 	= 0;
+
+	struct nRTOS_SuperBlock 	 Properties;
+	struct nRTOS_GroupDescriptor Groups[MIN_BLOCK_GROUPS];
+
+	memset(Contents, 'k', BlockSize);
+
+	Passed = (bool) (Passed && OSFS_Write(File, Contents, BlockSize, 0) == TRUE);
+
+	if (File != 0) Passed = OSFS_Close(File) && Passed;
+	if (volume != 0) OSFS_Unmount(volume);
+
+	Passed = (bool) (Passed && _Test_ReadStore(&Properties, sizeof(Properties), SUPER_BLOCK_SECTOR_NUM * BlockSize));
+	Passed = (bool) (Passed && Properties.NumGroups == MIN_BLOCK_GROUPS);
+	Passed = (bool) (Passed && _Test_ReadStore(Groups, sizeof(Groups), (off_t) Properties.GroupTableBlock * BlockSize));
+
+	for (GroupIterator = 0; GroupIterator < MIN_BLOCK_GROUPS && Passed; GroupIterator++)
+	{
+		Passed = _Test_CorruptBlock(Groups[GroupIterator].BlockBitMapBlock, BlockSize);
+	}
+
+	volume 	= (Passed) ? _Test_Mount(Test, FALSE) : 0;
+	File 	= (volume != 0) ? OSFS_Open(volume, "kept") : 0;
+	Passed 	= (bool) (File != 0 && OSFS_Read(File, Contents, BlockSize, 0) == TRUE && Contents[0] == 'k');
+	Passed 	= (bool) (Passed && OSFS_Append(File, Contents, BlockSize) == FALSE && OSFS_GetError(volume) == FILE_CORRUPTED);
+
+	if (File != 0) Passed = OSFS_Close(File) && Passed;
+	if (volume != 0) OSFS_Unmount(volume);
+
+	free(Contents);
+
+	return Passed;
+}
+
+// A group table that does not check out keeps the volume from mounting at all
+bool _Test_CorruptGroupTable(const TestCase* Test)
+{
+	VOLUME* volume = _Test_Mount(Test, TRUE);
+	bool 	Passed = (bool) (volume != 0);
+
+	struct nRTOS_SuperBlock Properties;
+
+	if (volume != 0) OSFS_Unmount(volume);
+
+	Passed = (bool) (Passed && _Test_ReadStore(&Properties, sizeof(Properties), SUPER_BLOCK_SECTOR_NUM * DEFAULT_BLOCK_SIZE));
+	Passed = (bool) (Passed && _Test_CorruptBlock(Properties.GroupTableBlock, DEFAULT_BLOCK_SIZE));
+	volume = (Passed) ? _Test_Mount(Test, FALSE) : 0;
+	Passed = (bool) (Passed && volume == 0);
+
+	if (volume != 0) OSFS_Unmount(volume);
+
+	return Passed;
+}
+
+// A store of an older layout revision is refused and left as it was, until a mount is asked to format it
+bool _Test_ForeignStore(const TestCase* Test)
+{
+	VOLUME* volume = _Test_Mount(Test, TRUE);
+	bool 	Passed = (bool) (volume != 0);
+
+	struct nRTOS_SuperBlock Properties;
+	struct nRTOS_SuperBlock Left;
+
+	if (volume != 0) OSFS_Unmount(volume);
+
+	Passed = (bool) (Passed && _Test_ReadStore(&Properties, sizeof(Properties), SUPER_BLOCK_SECTOR_NUM * DEFAULT_BLOCK_SIZE));
+
+	Properties.Version = SILK_VERSION - 1;
+
+	int Store = (Passed) ? open(TEST_STORE_PATH, O_RDWR) : -1;
+
+	Passed = (bool) (Store >= 0 && pwrite(Store, &Properties, sizeof(Properties), SUPER_BLOCK_SECTOR_NUM * DEFAULT_BLOCK_SIZE) == sizeof(Properties));
+
+	if (Store >= 0) close(Store);
+
+	volume = (Passed) ? _Test_Mount(Test, FALSE) : 0;
+	Passed = (bool) (Passed && volume == 0);
+	Passed = (bool) (Passed && _Test_ReadStore(&Left, sizeof(Left), SUPER_BLOCK_SECTOR_NUM * DEFAULT_BLOCK_SIZE));
+	Passed = (bool) (Passed && memcmp(&Left, &Properties, sizeof(Left)) == 0);
+
+	if (volume != 0) OSFS_Unmount(volume);
+
+	MOUNT_OPTIONS Options = Test->Options;
+
+	Options.Format = TRUE;
+
+	volume = (Passed) ? OSFS_Mount(TEST_STORE_PATH, &Options) : 0;
+	Passed = (bool) (volume != 0);
+
+	MYFILE* File = (Passed) ? OSFS_Create(volume, "fresh") : 0;
+
+	Passed = (bool) (File != 0);
+
+	if (File != 0) Passed = OSFS_Close(File) && Passed;
+	if (volume != 0) OSFS_Unmount(volume);
+
+	return Passed;
+}
+
+bool _Test_CorruptBlock(uint32_t BlockNum, uint32_t BlockSize)
+{
+	int  Store 	= open(TEST_STORE_PATH, O_RDWR);
+	BYTE Byte 	= 0;
+	bool Done 	= (bool) (Store >= 0 && pread(Store, &Byte, 1, (off_t) BlockNum * BlockSize) == 1);
+
+	Byte ^= 0xFF;
+
+	Done = (bool) (Done && pwrite(Store, &Byte, 1, (off_t) BlockNum * BlockSize) == 1);
+
+	if (Store >= 0) close(Store);
+
+	return Done;
+}
+
+bool _Test_ReadStore(void* Buffer, size_t NumBytes, off_t Offset)
+{
+	int  Store 	= open(TEST_STORE_PATH, O_RDONLY);
+	bool Done 	= (bool) (Store >= 0 && pread(Store, Buffer, NumBytes, Offset) == (ssize_t) NumBytes);
+
+	if (Store >= 0) close(Store);
+
+	return Done;
+}